@@ -0,0 +1,41 @@
+#include "benchmark_repo.h"
+
+#include <map>
+#include <mutex>
+
+#include <boost/algorithm/hex.hpp>
+
+#include "crypto/crypto.h"
+#include "image_repo.h"
+#include "uptane_repo.h"
+
+const BenchmarkRepo &BenchmarkRepo::get(int num_targets) {
+  static std::mutex m;
+  static std::map<int, std::unique_ptr<BenchmarkRepo>> repos;
+
+  std::lock_guard<std::mutex> guard(m);
+  auto &repo = repos[num_targets];
+  if (!repo) {
+    repo.reset(new BenchmarkRepo(num_targets));
+  }
+  return *repo;
+}
+
+BenchmarkRepo::BenchmarkRepo(int num_targets) : temp_dir_("benchmark-repo") {
+  UptaneRepo repo(temp_dir_.Path(), "", "");
+  repo.generateRepo(KeyType::kRSA2048);
+  for (int k = 0; k < num_targets; ++k) {
+    const std::string name = "target-" + std::to_string(k) + ".img";
+    Json::Value custom;
+    custom["targetFormat"] = "BINARY";
+    custom["version"] = std::to_string(k);
+    const Hash hash(Hash::Type::kSha256, boost::algorithm::hex(Crypto::sha256digest(name)));
+    repo.addCustomImage(name, hash, 1024 * 1024 + static_cast<uint64_t>(k), "benchmark-hw-" + std::to_string(k % 8),
+                        "", Delegation(), custom);
+  }
+
+  const boost::filesystem::path image_dir = temp_dir_.Path() / ImageRepo::dir;
+  image_root_ = Utils::parseJSONFile(image_dir / "root.json");
+  image_targets_raw_ = Utils::readFile(image_dir / "targets.json");
+  image_targets_ = Utils::parseJSON(image_targets_raw_);
+}
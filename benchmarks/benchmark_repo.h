@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_REPO_H_
+#define BENCHMARK_REPO_H_
+
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "json/json.h"
+#include "utilities/utils.h"
+
+/* An uptane-generator repository with a given number of Targets in the Image
+ * repository, generated once per process and reused by all benchmarks. */
+class BenchmarkRepo {
+ public:
+  static const BenchmarkRepo &get(int num_targets);
+
+  const Json::Value &imageRoot() const { return image_root_; }
+  const Json::Value &imageTargets() const { return image_targets_; }
+  const std::string &imageTargetsRaw() const { return image_targets_raw_; }
+
+ private:
+  explicit BenchmarkRepo(int num_targets);
+
+  TemporaryDirectory temp_dir_;
+  Json::Value image_root_;
+  Json::Value image_targets_;
+  std::string image_targets_raw_;
+};
+
+#endif  // BENCHMARK_REPO_H_
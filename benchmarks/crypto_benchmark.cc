@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/hex.hpp>
+
+#include "crypto/crypto.h"
+
+namespace {
+
+// Roughly the size of a canonicalized Targets metadata with a few entries.
+const std::string kMessage(4096, 'x');
+
+void BM_RSAPSSVerify(benchmark::State &state) {
+  const auto key_type = static_cast<KeyType>(state.range(0));
+  std::string public_key;
+  std::string private_key;
+  Crypto::generateRSAKeyPair(key_type, &public_key, &private_key);
+  const std::string signature = Crypto::RSAPSSSign(nullptr, private_key, kMessage);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Crypto::RSAPSSVerify(public_key, signature, kMessage));
+  }
+  std::stringstream label;
+  label << key_type;
+  state.SetLabel(label.str());
+}
+BENCHMARK(BM_RSAPSSVerify)
+    ->Arg(static_cast<int>(KeyType::kRSA2048))
+    ->Arg(static_cast<int>(KeyType::kRSA3072))
+    ->Arg(static_cast<int>(KeyType::kRSA4096));
+
+void BM_ED25519Verify(benchmark::State &state) {
+  std::string public_key;
+  std::string private_key;
+  Crypto::generateEDKeyPair(&public_key, &private_key);
+  const std::string signature = Crypto::ED25519Sign(boost::algorithm::unhex(private_key), kMessage);
+  const std::string raw_public_key = boost::algorithm::unhex(public_key);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Crypto::ED25519Verify(raw_public_key, signature, kMessage));
+  }
+}
+BENCHMARK(BM_ED25519Verify);
+
+// Hash 16 MiB per iteration, fed to the hasher in buffers of the given size.
+void BM_MultiPartSHA256Hasher(benchmark::State &state) {
+  const auto buffer_size = static_cast<size_t>(state.range(0));
+  const size_t total = 16 * 1024 * 1024;
+  std::vector<unsigned char> buffer(buffer_size, 0x5a);
+
+  for (auto _ : state) {
+    MultiPartSHA256Hasher hasher;
+    for (size_t done = 0; done < total; done += buffer_size) {
+      hasher.update(buffer.data(), buffer_size);
+    }
+    benchmark::DoNotOptimize(hasher.getHexDigest());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(total));
+}
+BENCHMARK(BM_MultiPartSHA256Hasher)->RangeMultiplier(4)->Range(512, 1024 * 1024);
+
+}  // namespace
@@ -0,0 +1,29 @@
+#include <benchmark/benchmark.h>
+
+#include "benchmark_repo.h"
+#include "utilities/utils.h"
+
+namespace {
+
+// Parse signed Image repository Targets metadata with the given number of Targets.
+void BM_ParseJSON(benchmark::State &state) {
+  const std::string &raw = BenchmarkRepo::get(static_cast<int>(state.range(0))).imageTargetsRaw();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Utils::parseJSON(raw));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(raw.size()));
+}
+BENCHMARK(BM_ParseJSON)->RangeMultiplier(10)->Range(1, 1000);
+
+// Canonicalize the signed part of the same metadata, as done before checking signatures.
+void BM_JsonToCanonicalStr(benchmark::State &state) {
+  const Json::Value &targets = BenchmarkRepo::get(static_cast<int>(state.range(0))).imageTargets();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Utils::jsonToCanonicalStr(targets["signed"]));
+  }
+}
+BENCHMARK(BM_JsonToCanonicalStr)->RangeMultiplier(10)->Range(1, 1000);
+
+}  // namespace
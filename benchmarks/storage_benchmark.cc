@@ -0,0 +1,274 @@
+#include <benchmark/benchmark.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include "libaktualizr/types.h"
+#include "storage/invstorage.h"
+#include "uptane/tuf.h"
+
+namespace {
+
+/* A SQLite VFS that forwards everything to the default one and counts the
+ * calls to xSync, i.e. the fsync()s SQLite issues. It is registered as the
+ * default VFS, so SQLStorage picks it up without any change. */
+std::atomic<uint64_t> sync_count{0};
+sqlite3_vfs *real_vfs = nullptr;
+sqlite3_vfs counting_vfs;
+
+struct CountingFile {
+  sqlite3_file base;
+  sqlite3_file *real;
+};
+
+sqlite3_file *real(sqlite3_file *file) { return reinterpret_cast<CountingFile *>(file)->real; }
+
+int countingClose(sqlite3_file *f) { return real(f)->pMethods->xClose(real(f)); }
+int countingRead(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst) {
+  return real(f)->pMethods->xRead(real(f), buf, amt, ofst);
+}
+int countingWrite(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst) {
+  return real(f)->pMethods->xWrite(real(f), buf, amt, ofst);
+}
+int countingTruncate(sqlite3_file *f, sqlite3_int64 size) { return real(f)->pMethods->xTruncate(real(f), size); }
+int countingSync(sqlite3_file *f, int flags) {
+  ++sync_count;
+  return real(f)->pMethods->xSync(real(f), flags);
+}
+int countingFileSize(sqlite3_file *f, sqlite3_int64 *size) { return real(f)->pMethods->xFileSize(real(f), size); }
+int countingLock(sqlite3_file *f, int lock) { return real(f)->pMethods->xLock(real(f), lock); }
+int countingUnlock(sqlite3_file *f, int lock) { return real(f)->pMethods->xUnlock(real(f), lock); }
+int countingCheckReservedLock(sqlite3_file *f, int *out) {
+  return real(f)->pMethods->xCheckReservedLock(real(f), out);
+}
+int countingFileControl(sqlite3_file *f, int op, void *arg) {
+  return real(f)->pMethods->xFileControl(real(f), op, arg);
+}
+int countingSectorSize(sqlite3_file *f) { return real(f)->pMethods->xSectorSize(real(f)); }
+int countingDeviceCharacteristics(sqlite3_file *f) { return real(f)->pMethods->xDeviceCharacteristics(real(f)); }
+int countingShmMap(sqlite3_file *f, int pg, int pgsz, int extend, void volatile **pp) {
+  return real(f)->pMethods->xShmMap(real(f), pg, pgsz, extend, pp);
+}
+int countingShmLock(sqlite3_file *f, int offset, int n, int flags) {
+  return real(f)->pMethods->xShmLock(real(f), offset, n, flags);
+}
+void countingShmBarrier(sqlite3_file *f) { real(f)->pMethods->xShmBarrier(real(f)); }
+int countingShmUnmap(sqlite3_file *f, int delete_flag) { return real(f)->pMethods->xShmUnmap(real(f), delete_flag); }
+int countingFetch(sqlite3_file *f, sqlite3_int64 ofst, int amt, void **pp) {
+  return real(f)->pMethods->xFetch(real(f), ofst, amt, pp);
+}
+int countingUnfetch(sqlite3_file *f, sqlite3_int64 ofst, void *p) {
+  return real(f)->pMethods->xUnfetch(real(f), ofst, p);
+}
+
+const sqlite3_io_methods counting_methods{3,
+                                          countingClose,
+                                          countingRead,
+                                          countingWrite,
+                                          countingTruncate,
+                                          countingSync,
+                                          countingFileSize,
+                                          countingLock,
+                                          countingUnlock,
+                                          countingCheckReservedLock,
+                                          countingFileControl,
+                                          countingSectorSize,
+                                          countingDeviceCharacteristics,
+                                          countingShmMap,
+                                          countingShmLock,
+                                          countingShmBarrier,
+                                          countingShmUnmap,
+                                          countingFetch,
+                                          countingUnfetch};
+
+int countingOpen(sqlite3_vfs * /* vfs */, const char *name, sqlite3_file *file, int flags, int *out_flags) {
+  auto *counting_file = reinterpret_cast<CountingFile *>(file);
+  counting_file->real = reinterpret_cast<sqlite3_file *>(counting_file + 1);
+  const int rc = real_vfs->xOpen(real_vfs, name, counting_file->real, flags, out_flags);
+  counting_file->base.pMethods = (counting_file->real->pMethods != nullptr) ? &counting_methods : nullptr;
+  return rc;
+}
+
+void registerCountingVfs() {
+  if (real_vfs != nullptr) {
+    return;
+  }
+  real_vfs = sqlite3_vfs_find(nullptr);
+  // The other methods only use the fields copied from the default VFS.
+  counting_vfs = *real_vfs;
+  counting_vfs.szOsFile = static_cast<int>(sizeof(CountingFile)) + real_vfs->szOsFile;
+  counting_vfs.pNext = nullptr;
+  counting_vfs.zName = "aktualizr-benchmark-counting";
+  counting_vfs.xOpen = countingOpen;
+  sqlite3_vfs_register(&counting_vfs, 1);
+}
+
+struct Backend {
+  std::string name;
+  StorageType type;
+};
+
+// New storage backends only have to be added here.
+const std::vector<Backend> kBackends{{"sqlite", StorageType::kSqlite}};
+
+// Colon-separated list of directories in which to create the storage, e.g. a
+// tmpfs and a directory on the device's flash.
+std::vector<std::string> storageDirs() {
+  const char *env = std::getenv("AKTUALIZR_BENCHMARK_STORAGE_DIRS");
+  std::vector<std::string> dirs;
+  boost::split(dirs, (env != nullptr) ? env : "/dev/shm:/var/tmp", boost::is_any_of(":"));
+  dirs.erase(std::remove_if(dirs.begin(), dirs.end(),
+                            [](const std::string &dir) { return dir.empty() || !boost::filesystem::is_directory(dir); }),
+             dirs.end());
+  return dirs;
+}
+
+using StorageBenchmark = std::function<void(benchmark::State &, INvStorage &)>;
+
+void runWithStorage(benchmark::State &state, const Backend &backend, const boost::filesystem::path &dir,
+                    const StorageBenchmark &bench) {
+  StorageConfig config;
+  config.type = backend.type;
+  config.path = dir / boost::filesystem::unique_path("aktualizr-storage-benchmark-%%%%-%%%%");
+  {
+    auto storage = INvStorage::newStorage(config);
+    bench(state, *storage);
+  }
+  boost::filesystem::remove_all(config.path);
+}
+
+// Runs the body once per benchmark iteration and reports the rate of
+// operations and the number of fsync()s per operation.
+template <typename Body>
+void measure(benchmark::State &state, Body body) {
+  const uint64_t syncs_before = sync_count;
+  for (auto _ : state) {
+    body();
+  }
+  state.counters["ops"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["fsyncs"] =
+      benchmark::Counter(static_cast<double>(sync_count - syncs_before), benchmark::Counter::kAvgIterations);
+}
+
+Uptane::Target makeTarget(int64_t k) {
+  Uptane::EcuMap ecus{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")}};
+  const std::string name = "update-" + std::to_string(k) + ".bin";
+  return Uptane::Target{name, ecus, {Hash{Hash::Type::kSha256, std::string(64, 'a')}}, 1024, "correlation"};
+}
+
+Json::Value makeReportEvent(int64_t k) {
+  Json::Value event;
+  event["id"] = "event-" + std::to_string(k);
+  event["deviceTime"] = "2020-10-27T12:00:00Z";
+  event["eventType"]["id"] = "EcuInstallationCompleted";
+  event["eventType"]["version"] = 1;
+  event["event"]["correlationId"] = "correlation";
+  event["event"]["ecu"] = "primary";
+  event["event"]["success"] = true;
+  return event;
+}
+
+// Metadata of the given size, stored and loaded as Image repository Targets.
+void storeNonRoot(benchmark::State &state, INvStorage &storage) {
+  const std::string data(static_cast<size_t>(state.range(0)), 'm');
+  measure(state, [&]() { storage.storeNonRoot(data, Uptane::RepositoryType::Image(), Uptane::Role::Targets()); });
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void loadNonRoot(benchmark::State &state, INvStorage &storage) {
+  storage.storeNonRoot(std::string(static_cast<size_t>(state.range(0)), 'm'), Uptane::RepositoryType::Image(),
+                       Uptane::Role::Targets());
+  std::string data;
+  measure(state, [&]() { storage.loadNonRoot(&data, Uptane::RepositoryType::Image(), Uptane::Role::Targets()); });
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void fillInstallationLog(INvStorage &storage, int64_t rows) {
+  storage.runInTransaction([&]() {
+    for (int64_t k = 0; k < rows; ++k) {
+      storage.saveInstalledVersion("primary", makeTarget(k), InstalledVersionUpdateMode::kCurrent);
+    }
+  });
+}
+
+// A new current version on top of an installation history of the given length.
+void saveInstalledVersion(benchmark::State &state, INvStorage &storage) {
+  fillInstallationLog(storage, state.range(0));
+  int64_t k = state.range(0);
+  measure(state,
+          [&]() { storage.saveInstalledVersion("primary", makeTarget(k++), InstalledVersionUpdateMode::kCurrent); });
+}
+
+void loadInstallationLog(benchmark::State &state, INvStorage &storage) {
+  fillInstallationLog(storage, state.range(0));
+  std::vector<Uptane::Target> log;
+  measure(state, [&]() { storage.loadInstallationLog("primary", &log, false); });
+}
+
+// A new report event on top of a queue of the given length.
+void saveReportEvent(benchmark::State &state, INvStorage &storage) {
+  storage.runInTransaction([&]() {
+    for (int64_t k = 0; k < state.range(0); ++k) {
+      storage.saveReportEvent(makeReportEvent(k));
+    }
+  });
+  int64_t k = state.range(0);
+  measure(state, [&]() { storage.saveReportEvent(makeReportEvent(k++)); });
+}
+
+void loadReportEvents(benchmark::State &state, INvStorage &storage) {
+  storage.runInTransaction([&]() {
+    for (int64_t k = 0; k < state.range(0); ++k) {
+      storage.saveReportEvent(makeReportEvent(k));
+    }
+  });
+  measure(state, [&]() {
+    Json::Value events;
+    int64_t id_max = 0;
+    storage.loadReportEvents(&events, &id_max);
+  });
+}
+
+// Registers every benchmark for every backend and storage directory, e.g.
+// BM_StoreNonRoot/sqlite:/dev/shm/1024.
+const bool registered BENCHMARK_UNUSED = []() {
+  registerCountingVfs();
+
+  const std::vector<std::pair<std::string, StorageBenchmark>> benchmarks{
+      {"BM_StoreNonRoot", storeNonRoot},
+      {"BM_LoadNonRoot", loadNonRoot},
+      {"BM_SaveInstalledVersion", saveInstalledVersion},
+      {"BM_LoadInstallationLog", loadInstallationLog},
+      {"BM_SaveReportEvent", saveReportEvent},
+      {"BM_LoadReportEvents", loadReportEvents},
+  };
+  for (const auto &backend : kBackends) {
+    for (const auto &dir : storageDirs()) {
+      for (const auto &b : benchmarks) {
+        const StorageBenchmark &bench = b.second;
+        auto *registration = benchmark::RegisterBenchmark(
+            (b.first + "/" + backend.name + ":" + dir).c_str(),
+            [backend, dir, bench](benchmark::State &state) { runWithStorage(state, backend, dir, bench); });
+        if (b.first == "BM_StoreNonRoot" || b.first == "BM_LoadNonRoot") {
+          // 1 KiB to 4 MiB of metadata
+          registration->RangeMultiplier(8)->Range(1024, 4 * 1024 * 1024);
+        } else {
+          // history or queue length
+          registration->Arg(0)->Arg(1000)->Arg(10000);
+        }
+      }
+    }
+  }
+  return true;
+}();
+
+}  // namespace
@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+#include "benchmark_repo.h"
+#include "uptane/tuf.h"
+
+namespace {
+
+// Check the signatures of Image repository Targets metadata against its Root.
+void BM_UnpackSignedObject(benchmark::State &state) {
+  const BenchmarkRepo &repo = BenchmarkRepo::get(static_cast<int>(state.range(0)));
+  Uptane::Root root(Uptane::RepositoryType::Image(), repo.imageRoot());
+
+  for (auto _ : state) {
+    root.UnpackSignedObject(Uptane::RepositoryType::Image(), Uptane::Role::Targets(), repo.imageTargets());
+  }
+}
+BENCHMARK(BM_UnpackSignedObject)->RangeMultiplier(10)->Range(1, 1000);
+
+// Verify and parse Targets metadata the way the Primary does after downloading it.
+void BM_Targets(benchmark::State &state) {
+  const BenchmarkRepo &repo = BenchmarkRepo::get(static_cast<int>(state.range(0)));
+  auto root = std::make_shared<Uptane::Root>(Uptane::RepositoryType::Image(), repo.imageRoot());
+
+  for (auto _ : state) {
+    Uptane::Targets targets(Uptane::RepositoryType::Image(), Uptane::Role::Targets(), repo.imageTargets(), root);
+    benchmark::DoNotOptimize(targets.targets.size());
+  }
+}
+BENCHMARK(BM_Targets)->RangeMultiplier(10)->Range(1, 1000);
+
+}  // namespace
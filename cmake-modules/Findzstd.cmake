@@ -0,0 +1,30 @@
+# - Find zstd
+# Find the native zstd headers and library.
+#
+# ZSTD_INCLUDE_DIRS - where to find zstd.h
+# ZSTD_LIBRARIES    - the libraries to link against
+# ZSTD_VERSION      - the version of zstd found
+# ZSTD_FOUND        - true if zstd was found
+
+find_path(ZSTD_INCLUDE_DIR NAMES zstd.h)
+find_library(ZSTD_LIBRARY NAMES zstd)
+
+if(ZSTD_INCLUDE_DIR AND EXISTS "${ZSTD_INCLUDE_DIR}/zstd.h")
+    file(STRINGS "${ZSTD_INCLUDE_DIR}/zstd.h" _ZSTD_VERSION_LINES REGEX "#define ZSTD_VERSION_(MAJOR|MINOR|RELEASE) ")
+    foreach(_part MAJOR MINOR RELEASE)
+        string(REGEX REPLACE ".*#define ZSTD_VERSION_${_part} +([0-9]+).*" "\\1" _ZSTD_VERSION_${_part} "${_ZSTD_VERSION_LINES}")
+    endforeach()
+    set(ZSTD_VERSION "${_ZSTD_VERSION_MAJOR}.${_ZSTD_VERSION_MINOR}.${_ZSTD_VERSION_RELEASE}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(zstd
+    REQUIRED_VARS ZSTD_LIBRARY ZSTD_INCLUDE_DIR
+    VERSION_VAR ZSTD_VERSION)
+
+if(ZSTD_FOUND)
+    set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+    set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+endif(ZSTD_FOUND)
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
@@ -27,6 +27,10 @@ int Aktualizr_uptane_cycle(Aktualizr *a);
 void Aktualizr_destroy(Aktualizr *a);
 
 int Aktualizr_set_signal_handler(Aktualizr *a, void (*handler)(const char* event_name));
+/* The handler is called at the end of each update check, download and
+ * installation with the phase ("check", "download" or "install") and its
+ * timing and transfer metrics as a JSON object. */
+int Aktualizr_set_metrics_handler(Aktualizr *a, void (*handler)(const char* phase, const char* metrics_json));
 
 Campaign *Aktualizr_campaigns_check(Aktualizr *a);
 int Aktualizr_campaign_accept(Aktualizr *a, Campaign *c);
@@ -17,6 +17,10 @@ namespace api {
 class CommandQueue;
 }
 
+namespace metrics {
+class MetricsServer;
+}
+
 /**
  * This class provides the main APIs necessary for launching and controlling
  * libaktualizr.
@@ -350,6 +354,7 @@ class Aktualizr {
   std::shared_ptr<INvStorage> storage_;
   std::shared_ptr<event::Channel> sig_;
   std::unique_ptr<api::CommandQueue> api_queue_;
+  std::unique_ptr<metrics::MetricsServer> metrics_server_;
 };
 
 #endif  // AKTUALIZR_H_
@@ -17,6 +17,10 @@
 
 struct LoggerConfig {
   int loglevel{2};
+  // write the messages from a background thread, dropping them if it falls behind
+  bool async{false};
+  // log to this file instead of the console
+  boost::filesystem::path file;
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
 };
@@ -72,6 +76,9 @@ struct UptaneConfig {
   bool force_install_completion{false};
   boost::filesystem::path secondary_config_file;
   uint64_t secondary_preinstall_wait_sec{600U};
+  uint64_t secondary_metadata_concurrency{1U};
+  uint64_t secondary_install_concurrency{0U};
+  uint64_t secondary_segment_concurrency{0U};
 
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
@@ -121,6 +128,8 @@ struct StorageConfig {
 
   // SQLite storage
   utils::BasedPath sqldb_path{"sql.db"};  // based on `/var/sota`
+  // Maximum number of installation log entries kept per ECU, 0 for no limit
+  uint64_t installation_log_limit{0U};
 
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
@@ -141,10 +150,15 @@ struct ImportConfig {
 /**
  * @brief The TelemetryConfig struct
  * Report device network information: IP address, hostname, MAC address.
+ * Optionally export runtime metrics in Prometheus text format.
  */
 struct TelemetryConfig {
   bool report_network{true};
   bool report_config{true};
+  // Unix socket serving the metrics, empty to disable
+  boost::filesystem::path metrics_socket;
+  // port on 127.0.0.1 serving the metrics over HTTP, 0 to disable
+  int metrics_port{0};
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
 };
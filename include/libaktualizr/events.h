@@ -94,13 +94,14 @@ class DownloadTargetComplete : public BaseEvent {
  public:
   static constexpr const char* TypeName{"DownloadTargetComplete"};
 
-  DownloadTargetComplete(Uptane::Target update_in, bool success_in)
-      : update(std::move(update_in)), success(success_in) {
+  DownloadTargetComplete(Uptane::Target update_in, bool success_in, result::DownloadMetrics metrics_in = {})
+      : update(std::move(update_in)), success(success_in), metrics(metrics_in) {
     variant = TypeName;
   }
 
   Uptane::Target update;
   bool success;
+  result::DownloadMetrics metrics;
 };
 
 /**
@@ -5,6 +5,7 @@
 #include <string>
 
 #include "libaktualizr/config.h"
+#include "libaktualizr/results.h"
 
 class Bootloader;
 class HttpInterface;
@@ -65,6 +66,12 @@ class PackageManagerInterface {
   virtual void removeTargetFile(const Uptane::Target& target);
   virtual std::vector<Uptane::Target> getTargetFiles();
 
+  // Bytes received, time to first byte and hashing time, accumulated by the
+  // default fetchTarget() on the calling thread since the last reset. Each
+  // thread downloads one Target at a time, so these are per download.
+  static result::DownloadMetrics downloadMetrics();
+  static void resetDownloadMetrics();
+
  protected:
   PackageConfig config;
   std::shared_ptr<INvStorage> storage_;
@@ -2,6 +2,8 @@
 #define RESULTS_H_
 /** \file */
 
+#include <chrono>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -31,6 +33,20 @@ enum class UpdateStatus {
   kError,
 };
 
+/**
+ * Where the time went while updating the Uptane metadata.
+ */
+class MetadataMetrics {
+ public:
+  /* Time spent waiting for and receiving metadata from the servers. */
+  std::chrono::milliseconds fetch_time{0};
+  /* Time spent checking and storing the received metadata. */
+  std::chrono::milliseconds verify_time{0};
+  /* Number of metadata files received and their total size. */
+  unsigned int files{0};
+  uint64_t bytes{0};
+};
+
 /**
  * Container for information about available updates.
  */
@@ -49,6 +65,7 @@ class UpdateCheck {
   UpdateStatus status{UpdateStatus::kNoUpdatesAvailable};
   Json::Value targets_meta;
   std::string message;
+  MetadataMetrics metrics;
 };
 
 /**
@@ -110,6 +127,31 @@ inline std::ostream& operator<<(std::ostream& os, const DownloadStatus stat) {
   return os;
 }
 
+/**
+ * Transfer statistics of a single Target download.
+ */
+class DownloadMetrics {
+ public:
+  /* Bytes received, over all attempts. The part of a resumed download that was
+   * received before is not counted. */
+  uint64_t bytes{0};
+  /* Time from the start of the first attempt until the Target was verified or
+   * the download was given up. */
+  std::chrono::milliseconds total_time{0};
+  /* Time from the start of the request until the first byte of the image was
+   * received, for the first attempt that received anything. */
+  std::chrono::milliseconds time_to_first_byte{0};
+  /* Time spent hashing the received data. */
+  std::chrono::milliseconds hash_time{0};
+  /* Number of attempts after the first one. */
+  unsigned int retries{0};
+
+  /* Average number of bytes received per second. */
+  double throughput() const {
+    return total_time.count() > 0 ? static_cast<double>(bytes) * 1000. / static_cast<double>(total_time.count()) : 0.;
+  }
+};
+
 /**
  * Container for information about downloading an update.
  */
@@ -121,6 +163,8 @@ class Download {
   std::vector<Uptane::Target> updates;
   DownloadStatus status{DownloadStatus::kNothingToDownload};
   std::string message;
+  /* Transfer statistics of each Target, by filename. */
+  std::map<std::string, DownloadMetrics> metrics;
 };
 
 /**
@@ -147,6 +191,10 @@ class Install {
     Uptane::Target update;
     Uptane::EcuSerial serial;
     data::InstallationResult install_res;
+    /* Time spent sending the image to a Secondary; always 0 for the Primary. */
+    std::chrono::milliseconds send_time{0};
+    /* Time spent installing the image on the ECU. */
+    std::chrono::milliseconds install_time{0};
   };
 };
 
@@ -1,6 +1,7 @@
 #ifndef UPTANE_SECONDARY_PROVIDER_H
 #define UPTANE_SECONDARY_PROVIDER_H
 
+#include <memory>
 #include <string>
 
 #include "libaktualizr/config.h"
@@ -9,6 +10,7 @@
 class INvStorage;
 
 class SecondaryProviderBuilder;
+class SharedFileReader;
 
 class SecondaryProvider {
  public:
@@ -20,6 +22,11 @@ class SecondaryProvider {
                             std::string* targets) const;
   std::string getTreehubCredentials() const;
   std::ifstream getTargetFileHandle(const Uptane::Target& target) const;
+  // Readers of the same Target share one pass over the file while they are
+  // in use, see SharedFile.
+  std::unique_ptr<SharedFileReader> getTargetFileReader(const Uptane::Target& target) const;
+  // Location of the stored image of a Target, if the Primary still has it.
+  boost::optional<boost::filesystem::path> getTargetFilePath(const Uptane::Target& target) const;
 
  private:
   SecondaryProvider(Config& config_in, const std::shared_ptr<const INvStorage>& storage_in,
@@ -18,6 +18,7 @@ TEST_WITH_P11=${TEST_WITH_P11:-0}
 TEST_WITH_OSTREE=${TEST_WITH_OSTREE:-1}
 TEST_WITH_DEB=${TEST_WITH_DEB:-1}
 TEST_WITH_FAULT_INJECTION=${TEST_WITH_FAULT_INJECTION:-0}
+TEST_WITH_ZSTD=${TEST_WITH_ZSTD:-0}
 
 TEST_CC=${TEST_CC:-gcc}
 TEST_CMAKE_GENERATOR=${TEST_CMAKE_GENERATOR:-Ninja}
@@ -47,6 +48,7 @@ fi
 if [[ $TEST_WITH_OSTREE = 1 ]]; then CMAKE_ARGS+=("-DBUILD_OSTREE=ON"); fi
 if [[ $TEST_WITH_DEB = 1 ]]; then CMAKE_ARGS+=("-DBUILD_DEB=ON"); fi
 if [[ $TEST_WITH_FAULT_INJECTION = 1 ]]; then CMAKE_ARGS+=("-DFAULT_INJECTION=ON"); fi
+if [[ $TEST_WITH_ZSTD = 1 ]]; then CMAKE_ARGS+=("-DBUILD_ZSTD=ON"); fi
 if [[ -n $TEST_SOTA_PACKED_CREDENTIALS ]]; then
     CMAKE_ARGS+=("-DSOTA_PACKED_CREDENTIALS=$TEST_SOTA_PACKED_CREDENTIALS");
 fi
@@ -10,6 +10,7 @@
 #include "logging/logging.h"
 #include "primary/aktualizr_helpers.h"
 #include "secondary.h"
+#include "telemetry/tracing.h"
 #include "utilities/aktualizr_version.h"
 #include "utilities/sig_handler.h"
 #include "utilities/utils.h"
@@ -117,6 +118,7 @@ int main(int argc, char *argv[]) {
                      "should be run as root for proper functionality.\033[0m\n";
     }
     Config config(commandline_map);
+    logger_configure_sink(config.logger);
     LOG_DEBUG << "Current directory: " << boost::filesystem::current_path().string();
 
     Aktualizr aktualizr(config);
@@ -137,6 +139,14 @@ int main(int argc, char *argv[]) {
 
     aktualizr.Initialize();
 
+#ifdef AKTUALIZR_TRACING
+    try {
+      tracing::Recorder::get().dumpOnSignal(SIGUSR2, config.storage.path / "trace.json");
+    } catch (const std::exception &e) {
+      LOG_ERROR << "Traces will not be written on SIGUSR2: " << e.what();
+    }
+#endif
+
     // handle unix signals
     SigHandler::get().start([&aktualizr]() {
       aktualizr.Abort();
@@ -5,8 +5,8 @@
 #include <boost/bind/bind.hpp>
 
 #include <algorithm>
+#include <map>
 #include <unordered_map>
-#include <unordered_set>
 
 #include "ipuptanesecondary.h"
 #include "logging/logging.h"
@@ -17,10 +17,15 @@
 namespace Primary {
 
 using Secondaries = std::vector<std::shared_ptr<SecondaryInterface>>;
+// shared by the Secondaries behind the same relay
+using Relays = std::map<std::pair<std::string, uint16_t>, std::shared_ptr<Uptane::IpRelay>>;
 using SecondaryFactoryRegistry =
     std::unordered_map<std::string, std::function<Secondaries(const SecondaryConfig&, Aktualizr& aktualizr)>>;
 
 static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktualizr& aktualizr);
+static void configureIPSecondary(const SecondaryInterface::Ptr& secondary, const IPSecondaryConfig& cfg,
+                                 Relays& relays);
+static std::string ipSecondaryData(const std::string& ip, uint16_t port, const std::string& segment);
 
 // NOLINTNEXTLINE(cppcoreguidelines-interfaces-global-init)
 static SecondaryFactoryRegistry sec_factory_registry = {
@@ -70,14 +75,15 @@ void initSecondaries(Aktualizr& aktualizr, const boost::filesystem::path& config
 
 class SecondaryWaiter {
  public:
-  SecondaryWaiter(Aktualizr& aktualizr, uint16_t wait_port, int timeout_s, Secondaries& secondaries)
+  SecondaryWaiter(Aktualizr& aktualizr, uint16_t wait_port, int timeout_s, Secondaries& secondaries, Relays& relays)
       : aktualizr_(aktualizr),
         endpoint_{boost::asio::ip::tcp::v4(), wait_port},
         timeout_{static_cast<boost::posix_time::seconds>(timeout_s)},
         timer_{io_context_},
-        connected_secondaries_{secondaries} {}
+        connected_secondaries_{secondaries},
+        relays_{relays} {}
 
-  void addSecondary(const std::string& ip, uint16_t port) { secondaries_to_wait_for_.insert(key(ip, port)); }
+  void addSecondary(const IPSecondaryConfig& cfg) { secondaries_to_wait_for_.emplace(key(cfg.ip, cfg.port), cfg); }
 
   void wait() {
     if (secondaries_to_wait_for_.empty()) {
@@ -115,12 +121,15 @@ class SecondaryWaiter {
       try {
         auto secondary = Uptane::IpUptaneSecondary::create(sec_ip, sec_port, con_socket_.native_handle());
         if (secondary) {
+          std::string segment;
+          auto waited = secondaries_to_wait_for_.find(key(sec_ip, sec_port));
+          if (waited != secondaries_to_wait_for_.end()) {
+            configureIPSecondary(secondary, waited->second, relays_);
+            segment = waited->second.segment;
+          }
           connected_secondaries_.push_back(secondary);
           // set ip/port in the db so that we can match everything later
-          Json::Value d;
-          d["ip"] = sec_ip;
-          d["port"] = sec_port;
-          aktualizr_.SetSecondaryData(secondary->getSerial(), Utils::jsonToCanonicalStr(d));
+          aktualizr_.SetSecondaryData(secondary->getSerial(), ipSecondaryData(sec_ip, sec_port, segment));
         }
       } catch (const std::exception& exc) {
         LOG_ERROR << "Failed to initialize a Secondary: " << exc.what();
@@ -151,7 +160,9 @@ class SecondaryWaiter {
   boost::asio::deadline_timer timer_;
 
   Secondaries& connected_secondaries_;
-  std::unordered_set<std::string> secondaries_to_wait_for_;
+  Relays& relays_;
+  // ip:port => configuration
+  std::unordered_map<std::string, IPSecondaryConfig> secondaries_to_wait_for_;
 };
 
 // Four options for each Secondary:
@@ -162,7 +173,8 @@ class SecondaryWaiter {
 // 4. Secondary is stored but not configured: it must have been removed. Skip it. This will cause re-registration.
 static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktualizr& aktualizr) {
   Secondaries result;
-  SecondaryWaiter sec_waiter{aktualizr, config.secondaries_wait_port, config.secondaries_timeout_s, result};
+  Relays relays;
+  SecondaryWaiter sec_waiter{aktualizr, config.secondaries_wait_port, config.secondaries_timeout_s, result, relays};
   auto secondaries_info = aktualizr.GetSecondaries();
 
   for (const auto& cfg : config.secondaries_cfg) {
@@ -181,10 +193,7 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
       // storage format (before we had the secondary_ecus table) and the
       // configuration, migrate it to the new format.
       info = &secondaries_info[0];
-      Json::Value d;
-      d["ip"] = cfg.ip;
-      d["port"] = cfg.port;
-      aktualizr.SetSecondaryData(info->serial, Utils::jsonToCanonicalStr(d));
+      aktualizr.SetSecondaryData(info->serial, ipSecondaryData(cfg.ip, cfg.port, cfg.segment));
       LOG_INFO << "Migrated a single IP Secondary to new storage format.";
     } else if (f == secondaries_info.cend()) {
       // Secondary was not found in storage; it must be new.
@@ -192,19 +201,22 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
       if (secondary == nullptr) {
         LOG_DEBUG << "Could not connect to IP Secondary at " << cfg.ip << ":" << cfg.port
                   << "; now trying to wait for it.";
-        sec_waiter.addSecondary(cfg.ip, cfg.port);
+        sec_waiter.addSecondary(cfg);
       } else {
+        configureIPSecondary(secondary, cfg, relays);
         result.push_back(secondary);
         // set ip/port in the db so that we can match everything later
-        Json::Value d;
-        d["ip"] = cfg.ip;
-        d["port"] = cfg.port;
-        aktualizr.SetSecondaryData(secondary->getSerial(), Utils::jsonToCanonicalStr(d));
+        aktualizr.SetSecondaryData(secondary->getSerial(), ipSecondaryData(cfg.ip, cfg.port, cfg.segment));
       }
       continue;
     } else {
       // The configured Secondary was found in storage.
       info = &(*f);
+      // its network segment may have been reconfigured
+      const std::string data = ipSecondaryData(cfg.ip, cfg.port, cfg.segment);
+      if (info->extra != data) {
+        aktualizr.SetSecondaryData(info->serial, data);
+      }
     }
 
     if (secondary == nullptr) {
@@ -216,6 +228,7 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
       }
     }
 
+    configureIPSecondary(secondary, cfg, relays);
     result.push_back(secondary);
   }
 
@@ -224,4 +237,31 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
   return result;
 }
 
+static void configureIPSecondary(const SecondaryInterface::Ptr& secondary, const IPSecondaryConfig& cfg,
+                                 Relays& relays) {
+  auto ip_secondary = std::static_pointer_cast<Uptane::IpUptaneSecondary>(secondary);
+  if (!cfg.multicast.group.empty()) {
+    ip_secondary->setMulticast(cfg.multicast);
+  }
+  if (!cfg.relay_ip.empty()) {
+    auto& relay = relays[{cfg.relay_ip, cfg.relay_port}];
+    if (!relay) {
+      relay = std::make_shared<Uptane::IpRelay>(cfg.relay_ip, cfg.relay_port);
+    }
+    ip_secondary->setRelay(relay);
+  }
+}
+
+// The network segment is stored along with the address, so that the Primary
+// can schedule installations per segment without knowing the Secondary type.
+static std::string ipSecondaryData(const std::string& ip, uint16_t port, const std::string& segment) {
+  Json::Value d;
+  d["ip"] = ip;
+  d["port"] = port;
+  if (!segment.empty()) {
+    d["segment"] = segment;
+  }
+  return Utils::jsonToCanonicalStr(d);
+}
+
 }  // namespace Primary
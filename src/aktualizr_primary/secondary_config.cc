@@ -1,5 +1,6 @@
 #include <fstream>
 #include <iostream>
+#include <tuple>
 #include <unordered_map>
 
 #include <json/json.h>
@@ -38,7 +39,12 @@ config file example
                 "secondaries_wait_timeout": 20,
                 "secondaries": [
                         {"addr": "127.0.0.1:9031"}
-                        {"addr": "127.0.0.1:9032"}
+                        {"addr": "127.0.0.1:9032", "segment": "can0"}
+                        {"addr": "127.0.0.1:9033", "multicast": "239.255.0.1:9050"}
+                        {"addr": "127.0.0.1:9035", "multicast": {"group": "239.255.0.1:9050",
+                                                                 "bytes_per_second": 1048576,
+                                                                 "interface": "192.168.1.1", "ttl": 1}}
+                        {"addr": "127.0.0.1:9034", "relay": "127.0.0.1:9031"}
                 ]
   },
   "socketcan": {
@@ -91,6 +97,34 @@ static std::pair<std::string, uint16_t> getIPAndPort(const std::string& addr) {
   return std::make_pair(ip, port);
 }
 
+// The multicast entry is either the group address, or an object with the group
+// address and the options for sending to it.
+static multicast::Options getMulticastOptions(const Json::Value& json_multicast) {
+  multicast::Options options;
+  const Json::Value& group = json_multicast.isObject() ? json_multicast["group"] : json_multicast;
+  if (group.asString().empty()) {
+    return options;
+  }
+  std::tie(options.group, options.port) = getIPAndPort(group.asString());
+  if (!json_multicast.isObject()) {
+    return options;
+  }
+  if (json_multicast.isMember("bytes_per_second")) {
+    options.bytes_per_second = json_multicast["bytes_per_second"].asUInt64();
+  }
+  options.interface = json_multicast["interface"].asString();
+  if (json_multicast.isMember("ttl")) {
+    options.ttl = json_multicast["ttl"].asInt();
+  }
+  if (json_multicast.isMember("timeout")) {
+    options.timeout = std::chrono::seconds(json_multicast["timeout"].asInt());
+  }
+  if (options.bytes_per_second == 0 || options.ttl < 1 || options.ttl > 255 || options.timeout.count() <= 0) {
+    throw std::invalid_argument("Invalid multicast rate, TTL or timeout for group " + group.asString());
+  }
+  return options;
+}
+
 void JsonConfigParser::createIPSecondariesCfg(Configs& configs, const Json::Value& json_ip_sec_cfg) {
   auto resultant_cfg = std::make_shared<IPSecondariesConfig>(
       static_cast<uint16_t>(json_ip_sec_cfg[IPSecondariesConfig::PortField].asUInt()),
@@ -101,7 +135,13 @@ void JsonConfigParser::createIPSecondariesCfg(Configs& configs, const Json::Valu
 
   for (const auto& secondary : secondaries) {
     auto addr = getIPAndPort(secondary[IPSecondaryConfig::AddrField].asString());
-    IPSecondaryConfig sec_cfg{addr.first, addr.second};
+    const multicast::Options multicast = getMulticastOptions(secondary[IPSecondaryConfig::MulticastField]);
+    std::pair<std::string, uint16_t> relay;
+    if (!secondary[IPSecondaryConfig::RelayField].asString().empty()) {
+      relay = getIPAndPort(secondary[IPSecondaryConfig::RelayField].asString());
+    }
+    IPSecondaryConfig sec_cfg{addr.first, addr.second, secondary[IPSecondaryConfig::SegmentField].asString(),
+                              multicast, relay.first, relay.second};
 
     LOG_INFO << "   found IP secondary config: " << sec_cfg;
     resultant_cfg->secondaries_cfg.push_back(sec_cfg);
@@ -5,6 +5,7 @@
 #include <boost/filesystem.hpp>
 #include <unordered_map>
 
+#include "multicast.h"
 #include "primary/secondary_config.h"
 #include "virtualsecondary.h"
 
@@ -13,17 +14,44 @@ namespace Primary {
 class IPSecondaryConfig {
  public:
   static constexpr const char* const AddrField{"addr"};
-
-  IPSecondaryConfig(std::string addr_ip, uint16_t addr_port) : ip(std::move(addr_ip)), port(addr_port) {}
+  static constexpr const char* const SegmentField{"segment"};
+  static constexpr const char* const MulticastField{"multicast"};
+  static constexpr const char* const RelayField{"relay"};
+
+  IPSecondaryConfig(std::string addr_ip, uint16_t addr_port, std::string net_segment = "",
+                    multicast::Options multicast_options = {}, std::string relay_addr_ip = "",
+                    uint16_t relay_addr_port = 0)
+      : ip(std::move(addr_ip)),
+        port(addr_port),
+        segment(std::move(net_segment)),
+        multicast(std::move(multicast_options)),
+        relay_ip(std::move(relay_addr_ip)),
+        relay_port(relay_addr_port) {}
 
   friend std::ostream& operator<<(std::ostream& os, const IPSecondaryConfig& cfg) {
-    os << "(addr: " << cfg.ip << ":" << cfg.port << ")";
+    os << "(addr: " << cfg.ip << ":" << cfg.port;
+    if (!cfg.segment.empty()) {
+      os << " segment: " << cfg.segment;
+    }
+    if (!cfg.multicast.group.empty()) {
+      os << " multicast: " << cfg.multicast.group << ":" << cfg.multicast.port;
+    }
+    if (!cfg.relay_ip.empty()) {
+      os << " relay: " << cfg.relay_ip << ":" << cfg.relay_port;
+    }
+    os << ")";
     return os;
   }
 
  public:
   const std::string ip;
   const uint16_t port;
+  const std::string segment;
+  // Images are sent to this group when the Secondary supports it.
+  const multicast::Options multicast;
+  // Images are uploaded through the aktualizr-secondary at this address.
+  const std::string relay_ip;
+  const uint16_t relay_port;
 };
 
 class IPSecondariesConfig : public SecondaryConfig {
@@ -1,5 +1,6 @@
 #include "aktualizr_secondary.h"
 
+#include "crypto/crypto.h"
 #include "crypto/keymanager.h"
 #include "logging/logging.h"
 #include "update_agent.h"
@@ -7,6 +8,7 @@
 #include "utilities/utils.h"
 
 #include <sys/types.h>
+#include <algorithm>
 #include <memory>
 
 AktualizrSecondary::AktualizrSecondary(AktualizrSecondaryConfig config, std::shared_ptr<INvStorage> storage)
@@ -16,6 +18,11 @@ AktualizrSecondary::AktualizrSecondary(AktualizrSecondaryConfig config, std::sha
   uptaneInitialize();
   manifest_issuer_ = std::make_shared<Uptane::ManifestIssuer>(keys_, ecu_serial_);
   registerHandlers();
+  if (config_.network.relay) {
+    relay_ = std_::make_unique<ImageRelay>(config_.storage.path / "relay",
+                                           ImageRelay::parseAddresses(config_.network.relay_secondaries));
+    relay_->registerHandlers(*this);
+  }
 }
 
 PublicKey AktualizrSecondary::publicKey() const { return keys_->UptanePublicKey(); }
@@ -25,7 +32,13 @@ Uptane::Manifest AktualizrSecondary::getManifest() const {
   Uptane::Manifest manifest;
 
   if (getInstalledImageInfo(installed_image_info)) {
-    manifest = manifest_issuer_->assembleAndSignManifest(installed_image_info);
+    const Uptane::Manifest unsigned_manifest = manifest_issuer_->assembleManifest(installed_image_info);
+    std::lock_guard<std::mutex> guard(manifest_mutex_);
+    if (signed_manifest_.empty() || unsigned_manifest != unsigned_manifest_) {
+      signed_manifest_ = manifest_issuer_->sign(unsigned_manifest);
+      unsigned_manifest_ = unsigned_manifest;
+    }
+    manifest = signed_manifest_;
   }
 
   return manifest;
@@ -76,24 +89,53 @@ data::InstallationResult AktualizrSecondary::doFullVerification(const Metadata&
   // 3. NOT SUPPORTED: Download and check the Timestamp metadata file from the Director repository.
   // 4. NOT SUPPORTED: Download and check the Snapshot metadata file from the Director repository.
   // 5. Download and check the Targets metadata file from the Director repository.
-  try {
-    director_repo_.updateMeta(*storage_, metadata);
-  } catch (const std::exception& e) {
-    LOG_ERROR << "Failed to update Director metadata: " << e.what();
-    return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
-                                    std::string("Failed to update Director metadata: ") + e.what());
+  //    The Primary sends the same metadata on every install attempt. If it is byte-identical to the metadata that
+  //    passed verification last time, director_repo_ still holds the result and only its expiry is checked again.
+  Uptane::MetaBundle director_meta = digestMeta(metadata.bundle(), Uptane::RepositoryType::Director());
+  if (!verified_director_meta_.empty() && director_meta == verified_director_meta_) {
+    try {
+      director_repo_.checkMetaExpired();
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Director metadata has expired: " << e.what();
+      return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
+                                      std::string("Director metadata has expired: ") + e.what());
+    }
+  } else {
+    verified_director_meta_.clear();
+    try {
+      director_repo_.updateMeta(*storage_, metadata);
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Failed to update Director metadata: " << e.what();
+      return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
+                                      std::string("Failed to update Director metadata: ") + e.what());
+    }
+    verified_director_meta_ = std::move(director_meta);
   }
 
   // 6. Download and check the Root metadata file from the Image repository.
   // 7. Download and check the Timestamp metadata file from the Image repository.
   // 8. Download and check the Snapshot metadata file from the Image repository.
   // 9. Download and check the top-level Targets metadata file from the Image repository.
-  try {
-    image_repo_.updateMeta(*storage_, metadata);
-  } catch (const std::exception& e) {
-    LOG_ERROR << "Failed to update Image repo metadata: " << e.what();
-    return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
-                                    std::string("Failed to update Image repo metadata: ") + e.what());
+  //    As above, metadata that is identical to the last verified one is only checked for expiry.
+  Uptane::MetaBundle image_meta = digestMeta(metadata.bundle(), Uptane::RepositoryType::Image());
+  if (!verified_image_meta_.empty() && image_meta == verified_image_meta_) {
+    try {
+      image_repo_.checkMetaExpired();
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Image repo metadata has expired: " << e.what();
+      return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
+                                      std::string("Image repo metadata has expired: ") + e.what());
+    }
+  } else {
+    verified_image_meta_.clear();
+    try {
+      image_repo_.updateMeta(*storage_, metadata);
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Failed to update Image repo metadata: " << e.what();
+      return data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed,
+                                      std::string("Failed to update Image repo metadata: ") + e.what());
+    }
+    verified_image_meta_ = std::move(image_meta);
   }
 
   // 10. Verify that Targets metadata from the Director and Image repositories match.
@@ -124,6 +166,16 @@ data::InstallationResult AktualizrSecondary::doFullVerification(const Metadata&
   return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
 }
 
+Uptane::MetaBundle AktualizrSecondary::digestMeta(const Uptane::MetaBundle& meta_bundle, Uptane::RepositoryType repo) {
+  Uptane::MetaBundle digests;
+  for (const auto& meta : meta_bundle) {
+    if (meta.first.first == repo) {
+      digests.emplace(meta.first, Crypto::sha256digest(meta.second));
+    }
+  }
+  return digests;
+}
+
 void AktualizrSecondary::uptaneInitialize() {
   if (keys_->generateUptaneKeyPair().empty()) {
     throw std::runtime_error("Failed to generate Uptane key pair");
@@ -190,12 +242,18 @@ void AktualizrSecondary::initPendingTargetIfAny() {
   pending_target_ = targetsForThisEcu[0];
 }
 
+void AktualizrSecondary::dropTargets() {
+  director_repo_.dropTargets(*storage_);
+  verified_director_meta_.clear();
+}
+
 void AktualizrSecondary::registerHandlers() {
   registerHandler(AKIpUptaneMes_PR_getInfoReq,
-                  std::bind(&AktualizrSecondary::getInfoHdlr, this, std::placeholders::_1, std::placeholders::_2));
+                  std::bind(&AktualizrSecondary::getInfoHdlr, this, std::placeholders::_1, std::placeholders::_2),
+                  true);
 
   registerHandler(AKIpUptaneMes_PR_versionReq,
-                  std::bind(&AktualizrSecondary::versionHdlr, std::placeholders::_1, std::placeholders::_2));
+                  std::bind(&AktualizrSecondary::versionHdlr, std::placeholders::_1, std::placeholders::_2), true);
 
   registerHandler(AKIpUptaneMes_PR_manifestReq,
                   std::bind(&AktualizrSecondary::getManifestHdlr, this, std::placeholders::_1, std::placeholders::_2));
@@ -223,10 +281,19 @@ MsgHandler::ReturnCode AktualizrSecondary::getInfoHdlr(Asn1Message& in_msg, Asn1
 }
 
 MsgHandler::ReturnCode AktualizrSecondary::versionHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+#if defined(BUILD_ZSTD_DELTA)
+  const uint32_t version = 4;
+#elif defined(BUILD_ZSTD)
+  const uint32_t version = 3;
+#else
   const uint32_t version = 2;
+#endif
+  // Versions 3 and 4 only add compressed and delta image uploads, so version 2
+  // Primaries are served as before.
+  const uint32_t min_version = 2;
   auto version_req = in_msg.versionReq();
   const auto primary_version = static_cast<uint32_t>(version_req->version);
-  if (primary_version < version) {
+  if (primary_version < min_version) {
     LOG_ERROR << "Primary protocol version is " << primary_version << " but Secondary version is " << version
               << "! Communication will most likely fail!";
   } else if (primary_version > version) {
@@ -236,7 +303,7 @@ MsgHandler::ReturnCode AktualizrSecondary::versionHdlr(Asn1Message& in_msg, Asn1
 
   out_msg.present(AKIpUptaneMes_PR_versionResp);
   auto version_resp = out_msg.versionResp();
-  version_resp->version = version;
+  version_resp->version = std::max(min_version, std::min(primary_version, version));
 
   return ReturnCode::kOk;
 }
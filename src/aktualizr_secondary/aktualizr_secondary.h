@@ -1,8 +1,11 @@
 #ifndef AKTUALIZR_SECONDARY_H
 #define AKTUALIZR_SECONDARY_H
 
+#include <mutex>
+
 #include "aktualizr_secondary_config.h"
 #include "aktualizr_secondary_metadata.h"
+#include "image_relay.h"
 #include "msg_handler.h"
 
 #include "uptane/directorrepository.h"
@@ -45,6 +48,7 @@ class AktualizrSecondary : public MsgDispatcher {
   INvStorage& storage() { return *storage_; }
   std::shared_ptr<INvStorage>& storagePtr() { return storage_; }
   Uptane::DirectorRepository& directorRepo() { return director_repo_; }
+  void dropTargets();
   std::shared_ptr<KeyManager>& keyMngr() { return keys_; }
 
   void initPendingTargetIfAny();
@@ -52,6 +56,7 @@ class AktualizrSecondary : public MsgDispatcher {
  private:
   static void copyMetadata(Uptane::MetaBundle& meta_bundle, Uptane::RepositoryType repo, const Uptane::Role& role,
                            std::string& json);
+  static Uptane::MetaBundle digestMeta(const Uptane::MetaBundle& meta_bundle, Uptane::RepositoryType repo);
   data::InstallationResult doFullVerification(const Metadata& metadata);
   void uptaneInitialize();
   void registerHandlers();
@@ -71,10 +76,19 @@ class AktualizrSecondary : public MsgDispatcher {
   std::shared_ptr<KeyManager> keys_;
 
   Uptane::ManifestIssuer::Ptr manifest_issuer_;
+  // The manifest is only signed again if its content changes.
+  mutable std::mutex manifest_mutex_;
+  mutable Uptane::Manifest unsigned_manifest_;
+  mutable Uptane::Manifest signed_manifest_;
 
   Uptane::DirectorRepository director_repo_;
   Uptane::ImageRepository image_repo_;
+  // Digests of the metadata that last passed verification, per repository. The
+  // trusted copies themselves are persisted in storage by updateMeta().
+  Uptane::MetaBundle verified_director_meta_;
+  Uptane::MetaBundle verified_image_meta_;
   Uptane::Target pending_target_{Uptane::Target::Unknown()};
+  std::unique_ptr<ImageRelay> relay_;
 };
 
 #endif  // AKTUALIZR_SECONDARY_H
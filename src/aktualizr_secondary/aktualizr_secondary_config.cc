@@ -6,12 +6,16 @@ void AktualizrSecondaryNetConfig::updateFromPropertyTree(const boost::property_t
   CopyFromConfig(port, "port", pt);
   CopyFromConfig(primary_ip, "primary_ip", pt);
   CopyFromConfig(primary_port, "primary_port", pt);
+  CopyFromConfig(relay, "relay", pt);
+  CopyFromConfig(relay_secondaries, "relay_secondaries", pt);
 }
 
 void AktualizrSecondaryNetConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, port, "port");
   writeOption(out_stream, primary_ip, "primary_ip");
   writeOption(out_stream, primary_port, "primary_port");
+  writeOption(out_stream, relay, "relay");
+  writeOption(out_stream, relay_secondaries, "relay_secondaries");
 }
 
 void AktualizrSecondaryUptaneConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt) {
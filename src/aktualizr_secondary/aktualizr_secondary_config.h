@@ -16,6 +16,11 @@ struct AktualizrSecondaryNetConfig {
   in_port_t port{9030};
   std::string primary_ip;
   in_port_t primary_port{9030};
+  // Keep images uploaded by the Primary and upload them to other Secondaries
+  // on its behalf, only to the comma-separated ip:port addresses in
+  // relay_secondaries.
+  bool relay{false};
+  std::string relay_secondaries;
 
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
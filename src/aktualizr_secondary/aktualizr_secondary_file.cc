@@ -12,6 +12,18 @@ AktualizrSecondaryFile::AktualizrSecondaryFile(const AktualizrSecondaryConfig& c
     : AktualizrSecondary(config, std::move(storage)), update_agent_{std::move(update_agent)} {
   registerHandler(AKIpUptaneMes_PR_uploadDataReq, std::bind(&AktualizrSecondaryFile::uploadDataHdlr, this,
                                                             std::placeholders::_1, std::placeholders::_2));
+#ifdef BUILD_ZSTD
+  registerHandler(AKIpUptaneMes_PR_uploadZstdDataReq, std::bind(&AktualizrSecondaryFile::uploadDataHdlr, this,
+                                                                std::placeholders::_1, std::placeholders::_2));
+#endif
+#ifdef BUILD_ZSTD_DELTA
+  registerHandler(AKIpUptaneMes_PR_uploadDeltaDataReq, std::bind(&AktualizrSecondaryFile::uploadDeltaDataHdlr, this,
+                                                                 std::placeholders::_1, std::placeholders::_2));
+#endif
+  registerHandler(AKIpUptaneMes_PR_multicastStartReq, std::bind(&AktualizrSecondaryFile::multicastStartHdlr, this,
+                                                                std::placeholders::_1, std::placeholders::_2));
+  registerHandler(AKIpUptaneMes_PR_multicastStatusReq, std::bind(&AktualizrSecondaryFile::multicastStatusHdlr, this,
+                                                                 std::placeholders::_1, std::placeholders::_2));
   if (!update_agent_) {
     std::string current_target_name;
 
@@ -32,16 +44,59 @@ AktualizrSecondaryFile::AktualizrSecondaryFile(const AktualizrSecondaryConfig& c
 
 void AktualizrSecondaryFile::initialize() { initPendingTargetIfAny(); }
 
-data::InstallationResult AktualizrSecondaryFile::receiveData(const uint8_t* data, size_t size) {
+data::InstallationResult AktualizrSecondaryFile::receiveData(const uint8_t* data, size_t size, bool compressed) {
   if (!pendingTarget().IsValid()) {
     LOG_ERROR << "Aborting image download; no valid target found.";
     return data::InstallationResult(data::ResultCode::Numeric::kGeneralError,
                                     "Aborting image download; no valid target found.");
   }
 
+  if (compressed) {
+#ifdef BUILD_ZSTD
+    return update_agent_->receiveCompressedData(pendingTarget(), data, size);
+#else
+    LOG_ERROR << "Aborting image download; compressed images are not supported.";
+    return data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                    "Aborting image download; compressed images are not supported.");
+#endif
+  }
   return update_agent_->receiveData(pendingTarget(), data, size);
 }
 
+data::InstallationResult AktualizrSecondaryFile::receiveDeltaData(const std::string& base_hash, const uint8_t* data,
+                                                                  size_t size) {
+  if (!pendingTarget().IsValid()) {
+    LOG_ERROR << "Aborting image download; no valid target found.";
+    return data::InstallationResult(data::ResultCode::Numeric::kGeneralError,
+                                    "Aborting image download; no valid target found.");
+  }
+
+#ifdef BUILD_ZSTD_DELTA
+  return update_agent_->receiveDeltaData(pendingTarget(), base_hash, data, size);
+#else
+  (void)base_hash;
+  (void)data;
+  (void)size;
+  LOG_ERROR << "Aborting image download; delta images are not supported.";
+  return data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                  "Aborting image download; delta images are not supported.");
+#endif
+}
+
+data::InstallationResult AktualizrSecondaryFile::startMulticast(const std::string& group, uint16_t port,
+                                                               uint32_t session) {
+  if (!pendingTarget().IsValid()) {
+    LOG_ERROR << "Aborting image download; no valid target found.";
+    return data::InstallationResult(data::ResultCode::Numeric::kGeneralError,
+                                    "Aborting image download; no valid target found.");
+  }
+  return update_agent_->startMulticast(pendingTarget(), group, port, session);
+}
+
+data::InstallationResult AktualizrSecondaryFile::multicastStatus(uint32_t* missing) {
+  return update_agent_->multicastStatus(missing);
+}
+
 bool AktualizrSecondaryFile::isTargetSupported(const Uptane::Target& target) const {
   return update_agent_->isTargetSupported(target);
 }
@@ -61,19 +116,44 @@ data::InstallationResult AktualizrSecondaryFile::installPendingTarget(const Upta
 void AktualizrSecondaryFile::completeInstall() { return update_agent_->completeInstall(); }
 
 MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
-  if (last_msg_ != AKIpUptaneMes_PR_uploadDataReq) {
+  if (last_msg_ != static_cast<unsigned int>(in_msg.present())) {
     LOG_INFO << "Received an initial data upload request message; attempting to receive data...";
   } else {
     LOG_DEBUG << "Received another data upload request message; attempting to receive data...";
   }
 
-  auto rec_buf_size = in_msg.uploadDataReq()->data.size;
+  const bool compressed = in_msg.present() == AKIpUptaneMes_PR_uploadZstdDataReq;
+  auto req = compressed ? in_msg.uploadZstdDataReq() : in_msg.uploadDataReq();
+  auto rec_buf_size = req->data.size;
+  if (rec_buf_size < 0) {
+    LOG_ERROR << "The received data buffer size is negative: " << rec_buf_size;
+    return ReturnCode::kOk;
+  }
+
+  auto result = receiveData(req->data.buf, static_cast<size_t>(rec_buf_size), compressed);
+
+  auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
+  m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+  SetString(&m->description, result.description);
+
+  return ReturnCode::kOk;
+}
+
+MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDeltaDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  if (last_msg_ != static_cast<unsigned int>(in_msg.present())) {
+    LOG_INFO << "Received an initial delta upload request message; attempting to receive data...";
+  } else {
+    LOG_DEBUG << "Received another delta upload request message; attempting to receive data...";
+  }
+
+  auto req = in_msg.uploadDeltaDataReq();
+  auto rec_buf_size = req->data.size;
   if (rec_buf_size < 0) {
     LOG_ERROR << "The received data buffer size is negative: " << rec_buf_size;
     return ReturnCode::kOk;
   }
 
-  auto result = receiveData(in_msg.uploadDataReq()->data.buf, static_cast<size_t>(rec_buf_size));
+  auto result = receiveDeltaData(ToString(req->baseHash), req->data.buf, static_cast<size_t>(rec_buf_size));
 
   auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
   m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
@@ -81,3 +161,39 @@ MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDataHdlr(Asn1Message& in_ms
 
   return ReturnCode::kOk;
 }
+
+static void setMulticastStatus(Asn1Message& out_msg, const data::InstallationResult& result, uint32_t missing) {
+  auto m = out_msg.present(AKIpUptaneMes_PR_multicastStatusResp).multicastStatusResp();
+  m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+  SetString(&m->description, result.description);
+  m->missing = missing;
+}
+
+MsgHandler::ReturnCode AktualizrSecondaryFile::multicastStartHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  LOG_INFO << "Received a request to receive the image over multicast";
+
+  auto req = in_msg.multicastStartReq();
+  data::InstallationResult result;
+  uint32_t missing = 0;
+  if (req->port <= 0 || req->port > UINT16_MAX || req->session < 0 || req->session > UINT32_MAX) {
+    result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, "Invalid multicast request");
+  } else {
+    result = startMulticast(ToString(req->group), static_cast<uint16_t>(req->port),
+                            static_cast<uint32_t>(req->session));
+  }
+  if (result.isSuccess()) {
+    result = multicastStatus(&missing);
+  }
+
+  setMulticastStatus(out_msg, result, missing);
+  return ReturnCode::kOk;
+}
+
+MsgHandler::ReturnCode AktualizrSecondaryFile::multicastStatusHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  (void)in_msg;
+
+  uint32_t missing = 0;
+  auto result = multicastStatus(&missing);
+  setMulticastStatus(out_msg, result, missing);
+  return ReturnCode::kOk;
+}
@@ -16,7 +16,10 @@ class AktualizrSecondaryFile : public AktualizrSecondary {
                          std::shared_ptr<FileUpdateAgent> update_agent = nullptr);
 
   void initialize() override;
-  data::InstallationResult receiveData(const uint8_t* data, size_t size);
+  data::InstallationResult receiveData(const uint8_t* data, size_t size, bool compressed = false);
+  data::InstallationResult receiveDeltaData(const std::string& base_hash, const uint8_t* data, size_t size);
+  data::InstallationResult startMulticast(const std::string& group, uint16_t port, uint32_t session);
+  data::InstallationResult multicastStatus(uint32_t* missing);
 
  protected:
   bool getInstalledImageInfo(Uptane::InstalledImageInfo& installed_image_info) const override;
@@ -26,6 +29,9 @@ class AktualizrSecondaryFile : public AktualizrSecondary {
   void completeInstall() override;
 
   ReturnCode uploadDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  ReturnCode uploadDeltaDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  ReturnCode multicastStartHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  ReturnCode multicastStatusHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
 
  private:
   std::shared_ptr<FileUpdateAgent> update_agent_;
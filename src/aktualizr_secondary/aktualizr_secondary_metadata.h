@@ -13,6 +13,7 @@ class Metadata : public Uptane::IMetadataFetcher {
                  Uptane::Version version) const override;
   void fetchLatestRole(std::string* result, int64_t maxsize, Uptane::RepositoryType repo,
                        const Uptane::Role& role) const override;
+  const Uptane::MetaBundle& bundle() const { return meta_bundle_; }
 
  protected:
   virtual void getRoleMetadata(std::string* result, const Uptane::RepositoryType& repo, const Uptane::Role& role,
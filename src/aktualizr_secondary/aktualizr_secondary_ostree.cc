@@ -49,7 +49,7 @@ void AktualizrSecondaryOstree::initialize() {
                                                              InstalledVersionUpdateMode::kNone);
         }
 
-        directorRepo().dropTargets(AktualizrSecondary::storage());
+        dropTargets();
       } else {
         LOG_INFO << "Pending update hasn't been applied because a reboot hasn't been detected";
       }
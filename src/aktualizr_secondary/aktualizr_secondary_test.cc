@@ -3,6 +3,10 @@
 
 #include <boost/process.hpp>
 
+#ifdef BUILD_ZSTD
+#include <zstd.h>
+#endif
+
 #include "aktualizr_secondary_file.h"
 #include "crypto/keymanager.h"
 #include "test_utils.h"
@@ -325,6 +329,134 @@ TEST_F(SecondaryTest, fullUptaneVerificationPositive) {
   EXPECT_EQ(manifest.filepath(), target.filename());
 }
 
+TEST_F(SecondaryTest, InstalledImageInfoCached) {
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+  ASSERT_EQ(sendImageFile(), data::ResultCode::Numeric::kOk);
+  ASSERT_TRUE(secondary_->install().isSuccess());
+  EXPECT_EQ(secondary_->getManifest().installedImageHash(), getDefaultTargetHash());
+
+  // the info stored on install is picked up after a restart
+  FileUpdateAgent restarted_agent(secondary_.targetFilepath(), "restarted");
+  Uptane::InstalledImageInfo info;
+  ASSERT_TRUE(restarted_agent.getInstalledImageInfo(info));
+  EXPECT_EQ(info.hash, getDefaultTarget().sha256Hash());
+  EXPECT_EQ(info.len, target_size);
+
+  // a file changed behind our back is hashed again
+  Utils::writeFile(secondary_.targetFilepath(), std::string("modified image"));
+  auto manifest = secondary_->getManifest();
+  EXPECT_EQ(manifest.installedImageHash(), Hash::generate(Hash::Type::kSha256, "modified image"));
+  EXPECT_EQ(manifest["signed"]["installed_image"]["fileinfo"]["length"].asUInt64(), 14);
+}
+
+/*
+ * Replace a longer new image file left behind by an interrupted upload.
+ */
+TEST_F(SecondaryTest, StaleNewImageTruncated) {
+  const boost::filesystem::path new_image = secondary_.targetFilepath().string() + ".newtarget";
+  Utils::writeFile(new_image, std::string(3 * target_size, 'x'));
+
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+  ASSERT_EQ(sendImageFile(), data::ResultCode::Numeric::kOk);
+  ASSERT_TRUE(secondary_->install().isSuccess());
+  EXPECT_EQ(boost::filesystem::file_size(secondary_.targetFilepath()), target_size);
+  EXPECT_EQ(Hash::generate(Hash::Type::kSha256, Utils::readFile(secondary_.targetFilepath())),
+            getDefaultTargetHash());
+}
+
+/*
+ * Reserve the space of the whole image when its first piece is received.
+ */
+TEST_F(SecondaryTest, NewImagePreallocated) {
+  const boost::filesystem::path new_image = secondary_.targetFilepath().string() + ".newtarget";
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+
+  const std::string image = Utils::readFile(uptane_repo_.getTargetImagePath(default_target_));
+  ASSERT_TRUE(secondary_->receiveData(reinterpret_cast<const uint8_t*>(image.data()), send_buffer_size).isSuccess());
+  EXPECT_EQ(boost::filesystem::file_size(new_image), target_size);
+}
+
+/*
+ * Refuse an image that does not fit on the filesystem before receiving it.
+ */
+TEST_F(SecondaryTest, NewImageDoesNotFit) {
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = getDefaultTarget().sha256Hash();
+  target_json["length"] = Json::UInt64(1) << 60;
+  const Uptane::Target target("huge-target", target_json);
+
+  const uint8_t data[1] = {0};
+  const auto result = update_agent_.receiveData(target, data, sizeof(data));
+  EXPECT_EQ(result.result_code, data::ResultCode::Numeric::kDownloadFailed);
+  EXPECT_FALSE(result.isSuccess());
+}
+
+#ifdef BUILD_ZSTD
+/*
+ * Decompress an image received as a zstd stream split into arbitrary pieces.
+ * Data that does not decompress is rejected.
+ */
+TEST_F(SecondaryTest, CompressedImage) {
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+
+  const std::string image = Utils::readFile(uptane_repo_.getTargetImagePath(default_target_));
+  std::vector<uint8_t> compressed(ZSTD_compressBound(image.size()));
+  const size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), image.data(), image.size(), 3);
+  ASSERT_EQ(ZSTD_isError(compressed_size), 0U);
+
+  // a broken upload is started over
+  const std::string garbage = "this is not a zstd stream";
+  EXPECT_EQ(secondary_->receiveData(reinterpret_cast<const uint8_t*>(garbage.data()), garbage.size(), true).result_code,
+            data::ResultCode::Numeric::kDownloadFailed);
+
+  for (size_t offset = 0; offset < compressed_size; offset += 100) {
+    const size_t size = std::min<size_t>(100, compressed_size - offset);
+    ASSERT_TRUE(secondary_->receiveData(&compressed[offset], size, true).isSuccess());
+  }
+  ASSERT_TRUE(secondary_->install().isSuccess());
+  EXPECT_EQ(Hash::generate(Hash::Type::kSha256, Utils::readFile(secondary_.targetFilepath())),
+            getDefaultTargetHash());
+}
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+/*
+ * Reconstruct an image from a zstd delta against the installed image. A delta
+ * against another image is rejected.
+ */
+TEST_F(SecondaryTest, DeltaImage) {
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+
+  // the installed image only differs from the new one in a few bytes
+  const std::string image = Utils::readFile(uptane_repo_.getTargetImagePath(default_target_));
+  std::string base = image;
+  base.replace(10, 4, "####");
+  base.replace(1000, 4, "####");
+  Utils::writeFile(secondary_.targetFilepath(), base);
+
+  std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+  ASSERT_EQ(ZSTD_isError(ZSTD_CCtx_refPrefix(cctx.get(), base.data(), base.size())), 0U);
+  std::vector<uint8_t> delta(ZSTD_compressBound(image.size()));
+  const size_t delta_size = ZSTD_compress2(cctx.get(), delta.data(), delta.size(), image.data(), image.size());
+  ASSERT_EQ(ZSTD_isError(delta_size), 0U);
+  EXPECT_LT(delta_size, image.size() / 10);
+
+  const std::string other_hash = Hash::generate(Hash::Type::kSha256, "another image").HashString();
+  EXPECT_EQ(secondary_->receiveDeltaData(other_hash, delta.data(), delta_size).result_code,
+            data::ResultCode::Numeric::kDownloadFailed);
+
+  const std::string base_hash = Hash::generate(Hash::Type::kSha256, base).HashString();
+  for (size_t offset = 0; offset < delta_size; offset += 10) {
+    const size_t size = std::min<size_t>(10, delta_size - offset);
+    ASSERT_TRUE(secondary_->receiveDeltaData(base_hash, &delta[offset], size).isSuccess());
+  }
+  ASSERT_TRUE(secondary_->install().isSuccess());
+  EXPECT_EQ(Hash::generate(Hash::Type::kSha256, Utils::readFile(secondary_.targetFilepath())),
+            getDefaultTargetHash());
+  EXPECT_FALSE(boost::filesystem::exists(secondary_.targetFilepath().string() + ".delta"));
+}
+#endif
+
 TEST_F(SecondaryTest, TwoImagesAndOneTarget) {
   // two images for the same ECU, just one of them is added as a target and signed
   // default image and corresponding target has been already added, just add another image
@@ -361,6 +493,33 @@ TEST_F(SecondaryTest, DirectorRootVersionIncremented) {
   EXPECT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
 }
 
+/*
+ * Accept metadata that is sent again after it has been verified, but still
+ * reject different metadata afterwards.
+ */
+TEST_F(SecondaryTest, ResentMetadata) {
+  ASSERT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+  ASSERT_EQ(sendImageFile(), data::ResultCode::Numeric::kOk);
+  ASSERT_TRUE(secondary_->install().isSuccess());
+
+  EXPECT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+
+  // metadata signed with other keys
+  auto metadata = UptaneRepoWrapper().addImageFile(default_target_, secondary_->hwID().ToString(),
+                                                   secondary_->serial().ToString());
+  EXPECT_FALSE(secondary_->putMetadata(metadata).isSuccess());
+
+  // metadata with a modified signature
+  auto meta_bundle = uptane_repo_.getCurrentMetadata();
+  auto& image_targets = meta_bundle[std::make_pair(Uptane::RepositoryType::Image(), Uptane::Role::Targets())];
+  const auto sig_pos = image_targets.find("\"sig\"");
+  ASSERT_NE(sig_pos, std::string::npos);
+  image_targets[image_targets.find('"', sig_pos + 5) + 1] ^= 1;
+  EXPECT_FALSE(secondary_->putMetadata(meta_bundle).isSuccess());
+
+  EXPECT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+}
+
 TEST_F(SecondaryTest, ImageRootVersionIncremented) {
   uptane_repo_.refreshRoot(Uptane::RepositoryType::Image());
   EXPECT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
@@ -0,0 +1,353 @@
+#include "image_relay.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include "crypto/crypto.h"
+#include "logging/logging.h"
+#include "utilities/shared_file.h"
+#include "utilities/utils.h"
+
+constexpr size_t ImageRelay::kMaxImages;
+constexpr size_t ImageRelay::kMaxForwards;
+
+// The hash names the cached file, so anything but a sha256 digest is refused.
+static bool normalizeHash(const std::string& hash, std::string* normalized) {
+  if (hash.size() != 64 || !std::all_of(hash.cbegin(), hash.cend(), [](char c) { return std::isxdigit(c) != 0; })) {
+    return false;
+  }
+  *normalized = boost::algorithm::to_lower_copy(hash);
+  return true;
+}
+
+static std::string toString(const ImageRelay::Address& addr) { return addr.first + ":" + std::to_string(addr.second); }
+
+ImageRelay::ImageRelay(boost::filesystem::path cache_dir, std::set<Address> secondaries)
+    : cache_dir_{std::move(cache_dir)}, secondaries_{std::move(secondaries)} {
+  if (secondaries_.empty()) {
+    LOG_WARNING << "No Secondaries to relay images to are configured";
+  }
+  Utils::createDirectories(cache_dir_, S_IRWXU);
+  // left behind by uploads that were interrupted by a restart
+  for (const auto& entry : boost::filesystem::directory_iterator(cache_dir_)) {
+    if (entry.path().extension() == ".part") {
+      boost::filesystem::remove(entry.path());
+    }
+  }
+}
+
+ImageRelay::~ImageRelay() { stopReceiving(); }
+
+std::set<ImageRelay::Address> ImageRelay::parseAddresses(const std::string& addresses) {
+  std::vector<std::string> entries;
+  boost::split(entries, addresses, boost::is_any_of(","));
+  std::set<Address> result;
+  for (auto& entry : entries) {
+    boost::trim(entry);
+    if (entry.empty()) {
+      continue;
+    }
+    const auto del_pos = entry.find_last_of(':');
+    const std::string port = del_pos == std::string::npos ? "" : entry.substr(del_pos + 1);
+    if (del_pos == 0 || port.empty() || port.size() > 5 ||
+        !std::all_of(port.cbegin(), port.cend(), [](char c) { return std::isdigit(c) != 0; }) ||
+        std::stoul(port) == 0 || std::stoul(port) > UINT16_MAX) {
+      throw std::invalid_argument("Invalid address of a Secondary to relay images to: " + entry);
+    }
+    result.emplace(entry.substr(0, del_pos), static_cast<uint16_t>(std::stoul(port)));
+  }
+  return result;
+}
+
+void ImageRelay::registerHandlers(MsgDispatcher& dispatcher) {
+  dispatcher.registerHandler(AKIpUptaneMes_PR_relayDataReq,
+                             std::bind(&ImageRelay::relayDataHdlr, this, std::placeholders::_1, std::placeholders::_2),
+                             true);
+  dispatcher.registerLongRunningHandler(
+      AKIpUptaneMes_PR_relayReq, std::bind(&ImageRelay::relayHdlr, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+data::InstallationResult ImageRelay::receiveData(const std::string& hash, uint64_t length, uint64_t offset,
+                                                 const uint8_t* data, size_t size) {
+  std::string image_hash;
+  if (!normalizeHash(hash, &image_hash) || length == 0) {
+    LOG_ERROR << "Refusing to relay an image with hash " << hash << " and length " << length;
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Refusing to relay an image with hash " + hash);
+  }
+
+  std::lock_guard<std::mutex> guard(m_);
+  const boost::filesystem::path part_path = imagePath(image_hash).string() + ".part";
+  if (offset == 0) {
+    const auto result = startReceiving(image_hash, length);
+    if (!result.isSuccess()) {
+      return result;
+    }
+  } else if (receive_fd_ < 0 || image_hash != receive_hash_ || offset != received_) {
+    LOG_ERROR << "Unexpected data at offset " << offset << " of the image to relay " << image_hash;
+    return data::InstallationResult(
+        data::ResultCode::Numeric::kDownloadFailed,
+        "Unexpected data at offset " + std::to_string(offset) + " of the image to relay " + image_hash);
+  }
+  if (received_ + size > length) {
+    LOG_ERROR << "The image to relay exceeds its length of " << length << " bytes";
+    stopReceiving();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "The image to relay exceeds its length of " + std::to_string(length) + " bytes");
+  }
+
+  size_t written = 0;
+  while (written < size) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const ssize_t res = write(receive_fd_, data + written, size - written);
+    if (res < 0 && errno != EINTR) {
+      LOG_ERROR << "Failed to store the image to relay in " << part_path << ": " << std::strerror(errno);
+      stopReceiving();
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "Failed to store the image to relay");
+    }
+    written += res > 0 ? static_cast<size_t>(res) : 0;
+  }
+  receive_hasher_->update(data, size);
+  received_ += size;
+  if (received_ < length) {
+    return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  }
+
+  // synced before it is renamed, so that a cached image is never incomplete
+  if (fsync(receive_fd_) != 0) {
+    LOG_ERROR << "Failed to store the image to relay in " << part_path << ": " << std::strerror(errno);
+    stopReceiving();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Failed to store the image to relay");
+  }
+  close(receive_fd_);
+  receive_fd_ = -1;
+  receive_hash_.clear();
+  const std::string received_hash = boost::algorithm::to_lower_copy(receive_hasher_->getHexDigest());
+  if (received_hash != image_hash) {
+    LOG_ERROR << "The image to relay does not match its hash: " << received_hash << " != " << image_hash;
+    boost::filesystem::remove(part_path);
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "The image to relay does not match its hash: " + received_hash +
+                                        " != " + image_hash);
+  }
+  boost::filesystem::rename(part_path, imagePath(image_hash));
+  LOG_INFO << "Stored the image " << image_hash << " of " << length << " bytes for relaying";
+  evict();
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
+// Starts over with a new image, replacing an unfinished one.
+data::InstallationResult ImageRelay::startReceiving(const std::string& hash, uint64_t length) {
+  stopReceiving();
+  const boost::filesystem::path part_path = imagePath(hash).string() + ".part";
+  receive_fd_ = open(part_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (receive_fd_ < 0) {
+    LOG_ERROR << "Failed to store the image to relay in " << part_path << ": " << std::strerror(errno);
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Failed to store the image to relay");
+  }
+  receive_hash_ = hash;
+  const int err = Utils::reserveFileSpace(receive_fd_, length);
+  if (err == ENOSPC || err == EFBIG) {
+    LOG_ERROR << "Not enough space to relay an image of " << length << " bytes";
+    stopReceiving();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Not enough space to relay an image of " + std::to_string(length) + " bytes");
+  }
+  if (err != 0) {
+    LOG_DEBUG << "Could not preallocate " << length << " bytes for " << part_path << ": " << std::strerror(err);
+  }
+  received_ = 0;
+  receive_hasher_ = MultiPartHasher::create(Hash::Type::kSha256);
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
+// Drops the unfinished image, if any.
+void ImageRelay::stopReceiving() {
+  if (receive_fd_ >= 0) {
+    close(receive_fd_);
+    receive_fd_ = -1;
+  }
+  if (!receive_hash_.empty()) {
+    boost::filesystem::remove(imagePath(receive_hash_).string() + ".part");
+    receive_hash_.clear();
+  }
+}
+
+bool ImageRelay::isCached(const std::string& hash, uint64_t length) const {
+  std::string image_hash;
+  if (!normalizeHash(hash, &image_hash)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(m_);
+  return isCachedLocked(image_hash, length);
+}
+
+bool ImageRelay::isCachedLocked(const std::string& hash, uint64_t length) const {
+  boost::system::error_code ec;
+  const auto size = boost::filesystem::file_size(imagePath(hash), ec);
+  return !ec && size == length;
+}
+
+data::InstallationResult ImageRelay::forward(const std::string& hash, uint64_t length, const Address& addr) {
+  if (secondaries_.count(addr) == 0) {
+    LOG_WARNING << "Refusing to relay an image to " << toString(addr) << ", which is not one of the relay's Secondaries";
+    return data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                    "Not relaying images to " + toString(addr));
+  }
+
+  std::string image_hash;
+  std::shared_ptr<SharedFile> file;
+  try {
+    std::lock_guard<std::mutex> guard(m_);
+    if (!normalizeHash(hash, &image_hash) || !isCachedLocked(image_hash, length)) {
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "The image to relay is not cached: " + hash);
+    }
+    // shared by the uploads of the image to several Secondaries
+    file = SharedFile::open(imagePath(image_hash));
+    // the most recently relayed images are kept
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(imagePath(image_hash), std::time(nullptr), ec);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to open the image to relay: " << e.what();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    std::string("Failed to open the image to relay: ") + e.what());
+  }
+
+  LOG_INFO << "Relaying the image " << image_hash << " to " << toString(addr);
+  SharedFileReader reader(file);
+  // same chunk size as the Primary's uploads
+  std::vector<uint8_t> buf(64 * 1024);
+  uint64_t total_send_data = 0;
+  try {
+    while (total_send_data < length) {
+      const size_t read_size = reader.read(buf.data(), buf.size());
+      if (read_size == 0) {
+        break;
+      }
+      Asn1Message::Ptr req(Asn1Message::Empty());
+      req->present(AKIpUptaneMes_PR_uploadDataReq);
+      auto m = req->uploadDataReq();
+      Asn1StringView data_view(&m->data, buf.data(), read_size);
+      auto resp = Asn1Rpc(req, addr);
+      if (resp->present() != AKIpUptaneMes_PR_uploadDataResp) {
+        LOG_ERROR << "The Secondary at " << toString(addr)
+                  << " failed to respond to a request to receive firmware data.";
+        return data::InstallationResult(
+            data::ResultCode::Numeric::kUnknown,
+            "The Secondary at " + toString(addr) + " failed to respond to a request to receive firmware data.");
+      }
+      auto r = resp->uploadDataResp();
+      auto result =
+          data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result), ToString(r->description));
+      if (!result.isSuccess()) {
+        return result;
+      }
+      total_send_data += read_size;
+    }
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to relay the image: " << e.what();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    std::string("Failed to relay the image: ") + e.what());
+  }
+
+  if (total_send_data != length) {
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
+  }
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
+void ImageRelay::evict() {
+  std::vector<std::pair<std::time_t, boost::filesystem::path>> images;
+  for (const auto& entry : boost::filesystem::directory_iterator(cache_dir_)) {
+    boost::system::error_code ec;
+    const std::time_t mtime = boost::filesystem::last_write_time(entry.path(), ec);
+    if (!ec && entry.path().extension() != ".part") {
+      images.emplace_back(mtime, entry.path());
+    }
+  }
+  if (images.size() <= kMaxImages) {
+    return;
+  }
+  std::sort(images.begin(), images.end(), std::greater<std::pair<std::time_t, boost::filesystem::path>>());
+  for (auto it = images.begin() + kMaxImages; it != images.end(); ++it) {
+    LOG_INFO << "Removing the relayed image " << it->second.filename();
+    // uploads of it that are still running keep it open
+    boost::filesystem::remove(it->second);
+  }
+}
+
+MsgHandler::ReturnCode ImageRelay::relayDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  auto req = in_msg.relayDataReq();
+  data::InstallationResult result;
+  if (req->length < 0 || req->offset < 0 || req->data.size < 0) {
+    LOG_ERROR << "Invalid request to receive an image to relay";
+    result = data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                      "Invalid request to receive an image to relay");
+  } else {
+    result = receiveData(ToString(req->hash), static_cast<uint64_t>(req->length), static_cast<uint64_t>(req->offset),
+                         req->data.buf, static_cast<size_t>(req->data.size));
+  }
+
+  auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
+  m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+  SetString(&m->description, result.description);
+  return MsgHandler::kOk;
+}
+
+MsgHandler::ReturnCode ImageRelay::relayHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  auto req = in_msg.relayReq();
+  const std::string hash = ToString(req->hash);
+  const uint64_t length = req->length > 0 ? static_cast<uint64_t>(req->length) : 0;
+  const bool cached = length > 0 && isCached(hash, length);
+  const Address addr{ToString(req->host),
+                     static_cast<uint16_t>(req->port > 0 && req->port <= UINT16_MAX ? req->port : 0)};
+
+  // Refused requests are answered before anything is uploaded to the relay,
+  // and as if the image was not cached, since nothing has been sent.
+  data::InstallationResult result;
+  bool forwarded = false;
+  if (secondaries_.count(addr) == 0) {
+    LOG_WARNING << "Refusing to relay an image to " << ToString(req->host) << ":" << req->port
+                << ", which is not one of the relay's Secondaries";
+    result = data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                      "Not relaying images to " + ToString(req->host) + ":" +
+                                          std::to_string(req->port));
+  } else if (!cached) {
+    result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "The image to relay is not cached: " + hash);
+  } else if (forwards_.fetch_add(1) >= kMaxForwards) {
+    --forwards_;
+    LOG_WARNING << "Refusing to relay an image to " << addr.first << ":" << addr.second << ", " << kMaxForwards
+                << " images are being relayed already";
+    result = data::InstallationResult(data::ResultCode::Numeric::kGeneralError,
+                                      "Too many images are being relayed at once");
+  } else {
+    result = forward(hash, length, addr);
+    --forwards_;
+    forwarded = true;
+  }
+
+  auto m = out_msg.present(AKIpUptaneMes_PR_relayResp).relayResp();
+  m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+  SetString(&m->description, result.description);
+  m->cached = forwarded ? 1 : 0;
+  return MsgHandler::kOk;
+}
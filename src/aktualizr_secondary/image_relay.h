@@ -0,0 +1,84 @@
+#ifndef AKTUALIZR_SECONDARY_IMAGE_RELAY_H_
+#define AKTUALIZR_SECONDARY_IMAGE_RELAY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "libaktualizr/types.h"
+#include "msg_handler.h"
+
+class MultiPartHasher;
+
+/**
+ * Keeps images uploaded by the Primary and uploads them to the Secondaries
+ * behind this one on the Primary's behalf, with the same requests the Primary
+ * uses. An image then only crosses the Primary's link once for all
+ * Secondaries behind the relay.
+ *
+ * Images are identified by their sha256 hash, which is checked once the whole
+ * image has been received. The Secondaries the image is uploaded to verify it
+ * against their own metadata as usual.
+ *
+ * The relay requests are not authenticated, so images are only uploaded to
+ * the Secondaries the relay is configured with.
+ */
+class ImageRelay {
+ public:
+  using Address = std::pair<std::string, uint16_t>;
+
+  ImageRelay(boost::filesystem::path cache_dir, std::set<Address> secondaries);
+  ~ImageRelay();
+  ImageRelay(const ImageRelay&) = delete;
+  ImageRelay& operator=(const ImageRelay&) = delete;
+
+  // Parses a comma-separated list of ip:port addresses.
+  static std::set<Address> parseAddresses(const std::string& addresses);
+
+  // The least recently relayed images beyond this number are removed.
+  static constexpr size_t kMaxImages = 4;
+  // Requests to upload an image to a Secondary beyond this number at once
+  // are refused.
+  static constexpr size_t kMaxForwards = 8;
+
+  // The relay requests are handled concurrently with other requests, so that
+  // several Secondaries are uploaded to at once. Requests to upload an image
+  // to a Secondary are long-running, so that they do not keep the Primary
+  // from connecting.
+  void registerHandlers(MsgDispatcher& dispatcher);
+
+  data::InstallationResult receiveData(const std::string& hash, uint64_t length, uint64_t offset, const uint8_t* data,
+                                       size_t size);
+  bool isCached(const std::string& hash, uint64_t length) const;
+  // Uploads a cached image to the Secondary at `addr`, which must be one of
+  // the relay's Secondaries and have received the metadata of the image as
+  // its pending Target.
+  data::InstallationResult forward(const std::string& hash, uint64_t length, const Address& addr);
+
+ private:
+  MsgHandler::ReturnCode relayDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  MsgHandler::ReturnCode relayHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  bool isCachedLocked(const std::string& hash, uint64_t length) const;
+  data::InstallationResult startReceiving(const std::string& hash, uint64_t length);
+  void stopReceiving();
+  boost::filesystem::path imagePath(const std::string& hash) const { return cache_dir_ / hash; }
+  void evict();
+
+  const boost::filesystem::path cache_dir_;
+  const std::set<Address> secondaries_;
+  std::atomic<size_t> forwards_{0};
+  mutable std::mutex m_;
+  // the image being received, its space is reserved when it starts
+  std::string receive_hash_;
+  uint64_t received_{0};
+  int receive_fd_{-1};
+  std::shared_ptr<MultiPartHasher> receive_hasher_;
+};
+
+#endif  // AKTUALIZR_SECONDARY_IMAGE_RELAY_H_
@@ -88,6 +88,7 @@ int main(int argc, char *argv[]) {
   int ret = EXIT_SUCCESS;
   try {
     AktualizrSecondaryConfig config(commandline_map);
+    logger_configure_sink(config.logger);
     AktualizrSecondary::Ptr secondary;
 
     if (config.pacman.type != PACKAGE_MANAGER_OSTREE) {
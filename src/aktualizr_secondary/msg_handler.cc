@@ -4,8 +4,17 @@
 
 void MsgDispatcher::clearHandlers() { handler_map_.clear(); }
 
-void MsgDispatcher::registerHandler(AKIpUptaneMes_PR msg_id, Handler handler) {
-  handler_map_[msg_id] = std::move(handler);
+void MsgDispatcher::registerHandler(AKIpUptaneMes_PR msg_id, Handler handler, bool concurrent) {
+  handler_map_[msg_id] = HandlerEntry{std::move(handler), concurrent, false};
+}
+
+void MsgDispatcher::registerLongRunningHandler(AKIpUptaneMes_PR msg_id, Handler handler) {
+  handler_map_[msg_id] = HandlerEntry{std::move(handler), true, true};
+}
+
+bool MsgDispatcher::isLongRunning(const Asn1Message& msg) const {
+  auto find_res_it = handler_map_.find(msg.present());
+  return find_res_it != handler_map_.end() && find_res_it->second.long_running;
 }
 
 MsgHandler::ReturnCode MsgDispatcher::handleMsg(const Asn1Message::Ptr& in_msg, Asn1Message::Ptr& out_msg) {
@@ -14,7 +23,11 @@ MsgHandler::ReturnCode MsgDispatcher::handleMsg(const Asn1Message::Ptr& in_msg,
     return MsgHandler::kUnkownMsg;
   }
   LOG_TRACE << "Found a handler for the request, processing it...";
-  auto handle_status_code = find_res_it->second(*in_msg, *out_msg);
+  std::unique_lock<std::mutex> lock(handler_mutex_, std::defer_lock);
+  if (!find_res_it->second.concurrent) {
+    lock.lock();
+  }
+  auto handle_status_code = find_res_it->second.handler(*in_msg, *out_msg);
   LOG_TRACE << "Request handler returned a response: " << out_msg->toStr();
 
   // Track the last message to help cut down on repetitive logging. Ignore the
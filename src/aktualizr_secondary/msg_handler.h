@@ -1,7 +1,9 @@
 #ifndef MSG_HANDLER_H
 #define MSG_HANDLER_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "AKIpUptaneMes.h"
@@ -21,22 +23,45 @@ class MsgHandler {
 
  public:
   virtual ReturnCode handleMsg(const Asn1Message::Ptr& in_msg, Asn1Message::Ptr& out_msg) = 0;
+  // Whether handling the request may take long, e.g. because it sends data to
+  // another host. The connection it came in on does not count against the
+  // server's limit of connections while it is being handled.
+  virtual bool isLongRunning(const Asn1Message& msg) const {
+    (void)msg;
+    return false;
+  }
 };
 
 class MsgDispatcher : public MsgHandler {
  public:
   using Handler = std::function<ReturnCode(Asn1Message&, Asn1Message&)>;
 
-  void registerHandler(AKIpUptaneMes_PR msg_id, Handler handler);
+  // Handlers are called one at a time, except for those registered as
+  // concurrent, which may be called while another request is being handled.
+  // This is meant for cheap requests that only read immutable state, like
+  // version and info requests, so that they are answered during an
+  // installation.
+  void registerHandler(AKIpUptaneMes_PR msg_id, Handler handler, bool concurrent = false);
+  // Long-running handlers are concurrent, and must limit the number of
+  // requests they handle at once themselves.
+  void registerLongRunningHandler(AKIpUptaneMes_PR msg_id, Handler handler);
   ReturnCode handleMsg(const Asn1Message::Ptr& in_msg, Asn1Message::Ptr& out_msg) override;
+  bool isLongRunning(const Asn1Message& msg) const override;
 
  protected:
   void clearHandlers();
 
-  unsigned int last_msg_ = 0;
+  std::atomic<unsigned int> last_msg_{0};
 
  private:
-  std::unordered_map<unsigned int, Handler> handler_map_;
+  struct HandlerEntry {
+    Handler handler;
+    bool concurrent;
+    bool long_running;
+  };
+
+  std::unordered_map<unsigned int, HandlerEntry> handler_map_;
+  std::mutex handler_mutex_;
 };
 
 #endif  // MSG_HANDLER_H
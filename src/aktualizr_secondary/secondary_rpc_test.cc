@@ -1,11 +1,19 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 #include <gtest/gtest.h>
 #include <netinet/tcp.h>
 
+#ifdef BUILD_ZSTD
+#include <zstd.h>
+#endif
+
 #include "libaktualizr/packagemanagerfactory.h"
 #include "libaktualizr/packagemanagerinterface.h"
 
+#include "image_relay.h"
 #include "ipuptanesecondary.h"
 #include "logging/logging.h"
 #include "msg_handler.h"
@@ -14,7 +22,9 @@
 #include "storage/invstorage.h"
 #include "test_utils.h"
 
-enum class HandlerVersion { kV1, kV2, kV2Failure };
+enum class HandlerVersion { kV1, kV2, kV2Failure, kV3, kV4 };
+// How the mock reports the progress of receiving an image over multicast.
+enum class MulticastMode { kReceive, kStall, kBadImage };
 
 /* This class allows us to divert messages from the regular handlers in
  * AktualizrSecondary to our own test functions. This lets us test only what was
@@ -22,7 +32,8 @@ enum class HandlerVersion { kV1, kV2, kV2Failure };
  *
  * It also has handlers for both the old/v1 and new/v2 versions of the RPC
  * protocol, so this is how we prove that the Primary is still
- * backwards-compatible with older/v1 Secondaries. */
+ * backwards-compatible with older/v1 Secondaries. v3 adds compressed uploads
+ * to v2 when built with zstd, and v4 adds delta uploads to v3. */
 class SecondaryMock : public MsgDispatcher {
  public:
   SecondaryMock(const Uptane::EcuSerial& serial, const Uptane::HardwareIdentifier& hdw_id, const PublicKey& pub_key,
@@ -47,6 +58,7 @@ class SecondaryMock : public MsgDispatcher {
   const Uptane::HardwareIdentifier& hwID() const { return hdw_id_; }
   const PublicKey& publicKey() const { return pub_key_; }
   const Uptane::Manifest& manifest() const { return manifest_; }
+  void setManifest(const Uptane::Manifest& manifest) { manifest_ = manifest; }
   const Uptane::MetaBundle& metadata() const { return meta_bundle_; }
   HandlerVersion handlerVersion() const { return handler_version_; }
   void setHandlerVersion(HandlerVersion handler_version_in) { handler_version_ = handler_version_in; }
@@ -56,6 +68,17 @@ class SecondaryMock : public MsgDispatcher {
       registerV1Handlers();
     } else if (handler_version_ == HandlerVersion::kV2) {
       registerV2Handlers();
+#ifdef BUILD_ZSTD
+    } else if (handler_version_ == HandlerVersion::kV3) {
+      registerV2Handlers();
+      registerV3Handlers();
+#endif
+#ifdef BUILD_ZSTD_DELTA
+    } else if (handler_version_ == HandlerVersion::kV4) {
+      registerV2Handlers();
+      registerV3Handlers();
+      registerV4Handlers();
+#endif
     } else {
       registerV2FailureHandlers();
     }
@@ -66,6 +89,17 @@ class SecondaryMock : public MsgDispatcher {
   size_t getReceivedImageSize() const { return boost::filesystem::file_size(image_filepath_); }
 
   const std::string& getReceivedTlsCreds() const { return tls_creds_; }
+  size_t getReceivedCompressedChunks() const { return compressed_chunks_; }
+  size_t getReceivedUploadChunks() const { return upload_chunks_; }
+  size_t getMulticastStarts() const { return multicast_starts_; }
+  uint32_t getMulticastSession() const { return multicast_session_; }
+  bool isMulticastReceiving() const { return multicast_receiving_; }
+  void setMulticastImage(const std::string& image) { multicast_image_ = image; }
+#ifdef BUILD_ZSTD_DELTA
+  size_t getReceivedDeltaChunks() const { return delta_chunks_; }
+  const std::string& getReceivedDeltaBaseHash() const { return delta_base_hash_; }
+  void setDeltaBase(const std::string& base) { delta_base_ = base; }
+#endif
 
   // Used by both protocol versions:
   void registerBaseHandlers() {
@@ -106,6 +140,35 @@ class SecondaryMock : public MsgDispatcher {
                     std::bind(&SecondaryMock::install2Hdlr, this, std::placeholders::_1, std::placeholders::_2));
   }
 
+#ifdef BUILD_ZSTD
+  // Used by protocol v3 only, on top of the v2 handlers:
+  void registerV3Handlers() {
+    ZSTD_initDStream(dstream_.get());
+    registerHandler(AKIpUptaneMes_PR_uploadZstdDataReq,
+                    std::bind(&SecondaryMock::uploadZstdDataHdlr, this, std::placeholders::_1, std::placeholders::_2));
+  }
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+  // Used by protocol v4 only, on top of the v3 handlers. Deltas are applied
+  // to the image set with setDeltaBase().
+  void registerV4Handlers() {
+    registerHandler(AKIpUptaneMes_PR_uploadDeltaDataReq, std::bind(&SecondaryMock::uploadDeltaDataHdlr, this,
+                                                                   std::placeholders::_1, std::placeholders::_2));
+  }
+#endif
+
+  // The multicast requests, on top of the v2 handlers. The blocks are not
+  // actually received: each status request counts one down, and the image set
+  // with setMulticastImage() is stored once none are missing.
+  void enableMulticast(MulticastMode mode) {
+    multicast_mode_ = mode;
+    registerHandler(AKIpUptaneMes_PR_multicastStartReq,
+                    std::bind(&SecondaryMock::multicastStartHdlr, this, std::placeholders::_1, std::placeholders::_2));
+    registerHandler(AKIpUptaneMes_PR_multicastStatusReq,
+                    std::bind(&SecondaryMock::multicastStatusHdlr, this, std::placeholders::_1, std::placeholders::_2));
+  }
+
   // Procotol v2 handlers that fail in predictable ways.
   void registerV2FailureHandlers() {
     registerHandler(AKIpUptaneMes_PR_putMetaReq2,
@@ -144,6 +207,10 @@ class SecondaryMock : public MsgDispatcher {
 
     if (handler_version_ == HandlerVersion::kV1) {
       version_resp->version = 1;
+    } else if (handler_version_ == HandlerVersion::kV3) {
+      version_resp->version = 3;
+    } else if (handler_version_ == HandlerVersion::kV4) {
+      version_resp->version = 4;
     } else {
       version_resp->version = 2;
     }
@@ -292,6 +359,20 @@ class SecondaryMock : public MsgDispatcher {
 
     size_t data_size = static_cast<size_t>(in_msg.uploadDataReq()->data.size);
     auto result = receiveImageData(in_msg.uploadDataReq()->data.buf, data_size);
+    ++upload_chunks_;
+
+    auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
+    m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+    SetString(&m->description, result.description);
+
+    return ReturnCode::kOk;
+  }
+
+#ifdef BUILD_ZSTD
+  MsgHandler::ReturnCode uploadZstdDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+    auto req = in_msg.uploadZstdDataReq();
+    auto result = decompressImageData(dstream_.get(), req->data);
+    ++compressed_chunks_;
 
     auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
     m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
@@ -300,6 +381,84 @@ class SecondaryMock : public MsgDispatcher {
     return ReturnCode::kOk;
   }
 
+  data::InstallationResult decompressImageData(ZSTD_DStream* dstream, const OCTET_STRING_t& data) {
+    ZSTD_inBuffer in{data.buf, static_cast<size_t>(data.size), 0};
+    std::vector<uint8_t> buf(ZSTD_DStreamOutSize());
+    auto result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+    bool output_full = false;
+    while ((in.pos < in.size || output_full) && result.isSuccess()) {
+      ZSTD_outBuffer out{buf.data(), buf.size(), 0};
+      const size_t res = ZSTD_decompressStream(dstream, &out, &in);
+      if (ZSTD_isError(res) != 0U) {
+        result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, ZSTD_getErrorName(res));
+      } else {
+        result = receiveImageData(buf.data(), out.pos);
+      }
+      output_full = out.pos == out.size;
+    }
+    return result;
+  }
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+  MsgHandler::ReturnCode uploadDeltaDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+    auto req = in_msg.uploadDeltaDataReq();
+    if (delta_chunks_ == 0) {
+      delta_base_hash_ = ToString(req->baseHash);
+      delta_dstream_.reset(ZSTD_createDStream());
+      ZSTD_DCtx_setParameter(delta_dstream_.get(), ZSTD_d_windowLogMax,
+                             ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound);
+      ZSTD_DCtx_refPrefix(delta_dstream_.get(), delta_base_.data(), delta_base_.size());
+    }
+    auto result = decompressImageData(delta_dstream_.get(), req->data);
+    ++delta_chunks_;
+
+    auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
+    m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+    SetString(&m->description, result.description);
+
+    return ReturnCode::kOk;
+  }
+#endif
+
+  static void setMulticastStatus(Asn1Message& out_msg, const data::InstallationResult& result, uint32_t missing) {
+    auto m = out_msg.present(AKIpUptaneMes_PR_multicastStatusResp).multicastStatusResp();
+    m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
+    SetString(&m->description, result.description);
+    m->missing = missing;
+  }
+
+  MsgHandler::ReturnCode multicastStartHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+    auto req = in_msg.multicastStartReq();
+    EXPECT_FALSE(ToString(req->group).empty());
+    EXPECT_GT(req->port, 0);
+    multicast_session_ = static_cast<uint32_t>(req->session);
+    ++multicast_starts_;
+    multicast_receiving_ = true;
+    multicast_missing_ = 3;
+    setMulticastStatus(out_msg, data::InstallationResult(data::ResultCode::Numeric::kOk, ""), multicast_missing_);
+    return ReturnCode::kOk;
+  }
+
+  MsgHandler::ReturnCode multicastStatusHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+    (void)in_msg;
+
+    auto result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+    if (!multicast_receiving_) {
+      result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Not receiving over multicast");
+    } else if (multicast_mode_ != MulticastMode::kStall && --multicast_missing_ == 0) {
+      multicast_receiving_ = false;
+      if (multicast_mode_ == MulticastMode::kBadImage) {
+        result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                          "The image received over multicast does not match its hash");
+      } else {
+        receiveImageData(reinterpret_cast<const uint8_t*>(multicast_image_.data()), multicast_image_.size());
+      }
+    }
+    setMulticastStatus(out_msg, result, multicast_missing_);
+    return ReturnCode::kOk;
+  }
+
   MsgHandler::ReturnCode uploadDataFailureHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
     (void)in_msg;
 
@@ -342,6 +501,8 @@ class SecondaryMock : public MsgDispatcher {
   }
 
   data::InstallationResult receiveImageData(const uint8_t* data, size_t size) {
+    // like the file update agent, an upload aborts receiving over multicast
+    multicast_receiving_ = false;
     std::ofstream target_file(image_filepath_.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
 
     target_file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
@@ -369,7 +530,7 @@ class SecondaryMock : public MsgDispatcher {
   const Uptane::EcuSerial serial_;
   const Uptane::HardwareIdentifier hdw_id_;
   const PublicKey pub_key_;
-  const Uptane::Manifest manifest_;
+  Uptane::Manifest manifest_;
 
   Uptane::MetaBundle meta_bundle_;
 
@@ -380,6 +541,23 @@ class SecondaryMock : public MsgDispatcher {
   std::string tls_creds_;
   std::string received_firmware_data_;
   HandlerVersion handler_version_;
+  size_t compressed_chunks_{0};
+  size_t upload_chunks_{0};
+  MulticastMode multicast_mode_{MulticastMode::kReceive};
+  size_t multicast_starts_{0};
+  uint32_t multicast_session_{0};
+  uint32_t multicast_missing_{0};
+  bool multicast_receiving_{false};
+  std::string multicast_image_;
+#ifdef BUILD_ZSTD
+  std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> dstream_{ZSTD_createDStream(), ZSTD_freeDStream};
+#endif
+#ifdef BUILD_ZSTD_DELTA
+  size_t delta_chunks_{0};
+  std::string delta_base_;
+  std::string delta_base_hash_;
+  std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> delta_dstream_{nullptr, ZSTD_freeDStream};
+#endif
 };
 
 class TargetFile {
@@ -534,6 +712,10 @@ class SecondaryRpcCommon : public ::testing::Test {
       EXPECT_TRUE(result.isSuccess());
       EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
     }
+    if (handler_version == HandlerVersion::kV3 || handler_version == HandlerVersion::kV4) {
+      // v4 only sends a delta if the Primary has the Secondary's image
+      EXPECT_GT(secondary_.getReceivedCompressedChunks(), 0U);
+    }
   }
 
   void installOstreeRev() {
@@ -630,6 +812,88 @@ INSTANTIATE_TEST_SUITE_P(
                       std::make_pair(1024 + 1, HandlerVersion::kV1), std::make_pair(1024 * 10 + 1, HandlerVersion::kV1),
                       std::make_pair(1024, HandlerVersion::kV2Failure)));
 
+#ifdef BUILD_ZSTD
+/* Images are compressed for Secondaries that support protocol v3. The largest
+ * image is sent in several compressed chunks. */
+INSTANTIATE_TEST_SUITE_P(SecondaryRpcTestCasesV3, SecondaryRpcTest,
+                         ::testing::Values(std::make_pair(1, HandlerVersion::kV3),
+                                           std::make_pair(1024 + 1, HandlerVersion::kV3),
+                                           std::make_pair(1024 * 1024, HandlerVersion::kV3)));
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+/* Without a base image for a delta, v4 Secondaries get compressed images. */
+INSTANTIATE_TEST_SUITE_P(SecondaryRpcTestCasesV4, SecondaryRpcTest,
+                         ::testing::Values(std::make_pair(1024 + 1, HandlerVersion::kV4)));
+
+class SecondaryRpcDelta : public SecondaryRpcCommon {
+ protected:
+  SecondaryRpcDelta() : SecondaryRpcCommon(1024 * 1024, HandlerVersion::kV4) {}
+};
+
+/* Send a delta against the image installed on the Secondary when the Primary
+ * still has a copy of that image. */
+TEST_F(SecondaryRpcDelta, DeltaUpload) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+
+  // the installed image only differs from the new one in a few bytes
+  std::string base = Utils::readFile(image_file_.path());
+  base.replace(1000, 8, "########");
+  base.replace(500 * 1024, 8, "########");
+  const Hash base_hash = Hash::generate(Hash::Type::kSha256, base);
+
+  Json::Value base_json;
+  base_json["hashes"]["sha256"] = base_hash.HashString();
+  base_json["length"] = static_cast<Json::UInt64>(base.size());
+  const Uptane::Target base_target("base.img", base_json);
+  auto fhandle = package_manager_->createTargetFile(base_target);
+  fhandle.write(base.data(), static_cast<std::streamsize>(base.size()));
+  fhandle.close();
+
+  Json::Value manifest;
+  manifest["signed"]["installed_image"]["filepath"] = base_target.filename();
+  manifest["signed"]["installed_image"]["fileinfo"]["length"] = static_cast<Json::UInt64>(base.size());
+  manifest["signed"]["installed_image"]["fileinfo"]["hashes"]["sha256"] = base_target.sha256Hash();
+  secondary_.setManifest(manifest);
+  secondary_.setDeltaBase(base);
+
+  Uptane::Target target = image_file_.createTarget(package_manager_);
+  EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+  EXPECT_EQ(Hash(Hash::Type::kSha256, secondary_.getReceivedDeltaBaseHash()), base_hash);
+  EXPECT_GT(secondary_.getReceivedDeltaChunks(), 0U);
+  EXPECT_EQ(secondary_.getReceivedCompressedChunks(), 0U);
+}
+
+/* Upload the compressed image instead of a delta that is not smaller, without
+ * sending any of the delta first. */
+TEST_F(SecondaryRpcDelta, DeltaNotSmaller) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+
+  // the installed image has nothing in common with the new one
+  TargetFile base_file("base.img", image_file_.size());
+  const std::string base = Utils::readFile(base_file.path());
+  const Uptane::Target base_target = base_file.createTarget(package_manager_);
+
+  Json::Value manifest;
+  manifest["signed"]["installed_image"]["filepath"] = base_target.filename();
+  manifest["signed"]["installed_image"]["fileinfo"]["length"] = static_cast<Json::UInt64>(base.size());
+  manifest["signed"]["installed_image"]["fileinfo"]["hashes"]["sha256"] = base_target.sha256Hash();
+  secondary_.setManifest(manifest);
+  secondary_.setDeltaBase(base);
+
+  Uptane::Target target = image_file_.createTarget(package_manager_);
+  EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+  EXPECT_EQ(secondary_.getReceivedDeltaChunks(), 0U);
+  EXPECT_GT(secondary_.getReceivedCompressedChunks(), 0U);
+}
+#endif
+
 class SecondaryRpcUpgrade : public SecondaryRpcCommon {
  protected:
   SecondaryRpcUpgrade() : SecondaryRpcCommon(1024, HandlerVersion::kV1) {}
@@ -656,6 +920,237 @@ TEST_F(SecondaryRpcUpgrade, VersionUpgrade) {
   installOstreeRev();
 }
 
+class SecondaryRpcMulticast : public SecondaryRpcCommon {
+ protected:
+  SecondaryRpcMulticast() : SecondaryRpcCommon(1024 * 10 + 1, HandlerVersion::kV2) {
+    multicast::Options options;
+    options.group = "239.255.0.1";
+    options.port = TestUtils::getFreePortAsInt();
+    options.interface = "127.0.0.1";
+    options.timeout = std::chrono::seconds(1);
+    std::static_pointer_cast<Uptane::IpUptaneSecondary>(ip_secondary_)->setMulticast(options);
+    secondary_.setMulticastImage(Utils::readFile(image_file_.path()));
+  }
+
+  void sendAndInstall() {
+    Uptane::Target target = image_file_.createTarget(package_manager_);
+    EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+    EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+    EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+    EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+    EXPECT_EQ(image_file_.size(), secondary_.getReceivedImageSize());
+  }
+};
+
+/* Start a multicast session and poll its status until the Secondary has the
+ * whole image, without uploading anything over TCP. */
+TEST_F(SecondaryRpcMulticast, MulticastUpload) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  secondary_.enableMulticast(MulticastMode::kReceive);
+
+  sendAndInstall();
+  EXPECT_EQ(secondary_.getMulticastStarts(), 1U);
+  EXPECT_NE(secondary_.getMulticastSession(), 0U);
+  EXPECT_EQ(secondary_.getReceivedUploadChunks(), 0U);
+}
+
+/* Give up on a Secondary that makes no progress and upload the image over
+ * TCP, which stops the Secondary from receiving it over multicast. */
+TEST_F(SecondaryRpcMulticast, MulticastStalled) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  secondary_.enableMulticast(MulticastMode::kStall);
+
+  sendAndInstall();
+  EXPECT_EQ(secondary_.getMulticastStarts(), 1U);
+  EXPECT_GT(secondary_.getReceivedUploadChunks(), 0U);
+  EXPECT_FALSE(secondary_.isMulticastReceiving());
+}
+
+/* Upload the image over TCP if the one received over multicast does not match
+ * its hash. */
+TEST_F(SecondaryRpcMulticast, MulticastBadImage) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  secondary_.enableMulticast(MulticastMode::kBadImage);
+
+  sendAndInstall();
+  EXPECT_EQ(secondary_.getMulticastStarts(), 1U);
+  EXPECT_GT(secondary_.getReceivedUploadChunks(), 0U);
+}
+
+/* Secondaries that do not know the multicast requests get the image over
+ * TCP. */
+TEST_F(SecondaryRpcMulticast, MulticastNotSupported) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+
+  sendAndInstall();
+  EXPECT_EQ(secondary_.getMulticastStarts(), 0U);
+  EXPECT_GT(secondary_.getReceivedUploadChunks(), 0U);
+}
+
+class SecondaryRpcRelay : public SecondaryRpcCommon {
+ protected:
+  SecondaryRpcRelay()
+      : SecondaryRpcCommon(64 * 1024 * 3 + 1, HandlerVersion::kV2),
+        relay_{relay_dir_.Path(), {{"localhost", secondary_server_.port()}}},
+        relay_server_{relay_dispatcher_, "", 0},
+        relay_server_thread_{[this]() { relay_server_.run(); }} {
+    relay_.registerHandlers(relay_dispatcher_);
+    relay_server_.wait_until_running();
+  }
+
+  ~SecondaryRpcRelay() {
+    relay_server_.stop();
+    relay_server_thread_.join();
+  }
+
+  TemporaryDirectory relay_dir_;
+  ImageRelay relay_;
+  MsgDispatcher relay_dispatcher_;
+  SecondaryTcpServer relay_server_;
+  std::thread relay_server_thread_;
+};
+
+/* Upload an image through a relay, which keeps it for the next uploads. */
+TEST_F(SecondaryRpcRelay, RelayedUpload) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  std::static_pointer_cast<Uptane::IpUptaneSecondary>(ip_secondary_)->setRelay(
+      std::make_shared<Uptane::IpRelay>("localhost", relay_server_.port()));
+
+  Uptane::Target target = image_file_.createTarget(package_manager_);
+  EXPECT_FALSE(relay_.isCached(target.sha256Hash(), target.length()));
+  EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+  EXPECT_TRUE(relay_.isCached(target.sha256Hash(), target.length()));
+
+  secondary_.resetImageHash();
+  const auto result = relay_.forward(target.sha256Hash(), target.length(), {"localhost", secondary_server_.port()});
+  EXPECT_TRUE(result.isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+}
+
+/* Upload the image directly if the relay is not running. */
+TEST_F(SecondaryRpcRelay, RelayNotRunning) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  std::static_pointer_cast<Uptane::IpUptaneSecondary>(ip_secondary_)
+      ->setRelay(std::make_shared<Uptane::IpRelay>("localhost", TestUtils::getFreePortAsInt()));
+
+  Uptane::Target target = image_file_.createTarget(package_manager_);
+  EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+}
+
+/* Only keep images that match their hash, and refuse anything else as a
+ * hash. */
+TEST_F(SecondaryRpcRelay, RejectedImages) {
+  const std::string image = "image";
+  const auto data = reinterpret_cast<const uint8_t*>(image.data());
+  const std::string hash = Hash::generate(Hash::Type::kSha256, image).HashString();
+  const std::string other_hash = Hash::generate(Hash::Type::kSha256, "other").HashString();
+
+  EXPECT_FALSE(relay_.receiveData("../" + hash.substr(3), image.size(), 0, data, image.size()).isSuccess());
+  EXPECT_FALSE(relay_.receiveData(other_hash, image.size(), 0, data, image.size()).isSuccess());
+  EXPECT_FALSE(relay_.isCached(other_hash, image.size()));
+  EXPECT_TRUE(relay_.receiveData(hash, image.size(), 0, data, 2).isSuccess());
+  EXPECT_FALSE(relay_.receiveData(hash, image.size(), 3, data, 2).isSuccess());
+  EXPECT_TRUE(relay_.receiveData(hash, image.size(), 0, data, image.size()).isSuccess());
+  EXPECT_TRUE(relay_.isCached(hash, image.size()));
+  EXPECT_FALSE(relay_.isCached(hash, image.size() + 1));
+
+  // refused before any of it is stored
+  EXPECT_FALSE(relay_.receiveData(other_hash, uint64_t(1) << 60, 0, data, image.size()).isSuccess());
+  EXPECT_FALSE(boost::filesystem::exists(relay_dir_ / (other_hash + ".part")));
+}
+
+/* Only upload images to the relay's Secondaries, and upload the image directly
+ * if the relay refuses to. */
+TEST_F(SecondaryRpcRelay, RelayRefused) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+  Uptane::Target target = image_file_.createTarget(package_manager_);
+  const std::string image = Utils::readFile(image_file_.path());
+  EXPECT_TRUE(relay_
+                  .receiveData(target.sha256Hash(), target.length(), 0,
+                               reinterpret_cast<const uint8_t*>(image.data()), image.size())
+                  .isSuccess());
+  EXPECT_FALSE(relay_.forward(target.sha256Hash(), target.length(), {"127.0.0.1", secondary_server_.port()})
+                   .isSuccess());
+  EXPECT_FALSE(relay_.forward(target.sha256Hash(), target.length(), {"localhost", TestUtils::getFreePortAsInt()})
+                   .isSuccess());
+
+  TemporaryDirectory other_dir;
+  ImageRelay other_relay{other_dir.Path(), {}};
+  MsgDispatcher other_dispatcher;
+  other_relay.registerHandlers(other_dispatcher);
+  SecondaryTcpServer other_server{other_dispatcher, "", 0};
+  std::thread other_server_thread{[&other_server]() { other_server.run(); }};
+  other_server.wait_until_running();
+  std::static_pointer_cast<Uptane::IpUptaneSecondary>(ip_secondary_)->setRelay(
+      std::make_shared<Uptane::IpRelay>("localhost", other_server.port()));
+
+  EXPECT_TRUE(ip_secondary_->putMetadata(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->sendFirmware(target).isSuccess());
+  EXPECT_TRUE(ip_secondary_->install(target).isSuccess());
+  EXPECT_EQ(image_file_.hash(), secondary_.getReceivedImageHash());
+  // nothing was uploaded to the relay
+  EXPECT_FALSE(other_relay.isCached(target.sha256Hash(), target.length()));
+
+  other_server.stop();
+  other_server_thread.join();
+}
+
+/* Secondaries behind the same relay that are sent an image at the same time
+ * wait for a single upload of it, and try again if it fails. */
+TEST(IpRelay, UploadOnce) {
+  Uptane::IpRelay relay{"localhost", 9050};
+  std::atomic<int> uploads{0};
+  std::atomic<bool> fail{true};
+  const auto upload = [&uploads, &fail]() {
+    ++uploads;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (fail.exchange(false)) {
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "failed");
+    }
+    return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  };
+
+  std::vector<std::thread> secondaries;
+  std::atomic<int> succeeded{0};
+  for (int i = 0; i < 3; ++i) {
+    secondaries.emplace_back([&]() {
+      if (relay.uploadOnce("hash", upload).isSuccess()) {
+        ++succeeded;
+      }
+    });
+  }
+  for (auto& secondary : secondaries) {
+    secondary.join();
+  }
+  // the first upload fails, one of the waiting Secondaries uploads it again
+  EXPECT_EQ(uploads, 2);
+  EXPECT_EQ(succeeded, 2);
+
+  EXPECT_TRUE(relay.uploadOnce("hash", upload).isSuccess());
+  EXPECT_EQ(uploads, 2);
+  relay.forget("hash");
+  EXPECT_TRUE(relay.uploadOnce("hash", upload).isSuccess());
+  EXPECT_EQ(uploads, 3);
+}
+
+TEST(ImageRelay, ParseAddresses) {
+  const std::set<ImageRelay::Address> expected{{"10.0.1.2", 9050}, {"secondary", 9030}};
+  EXPECT_EQ(ImageRelay::parseAddresses("10.0.1.2:9050, secondary:9030"), expected);
+  EXPECT_TRUE(ImageRelay::parseAddresses("").empty());
+  EXPECT_THROW(ImageRelay::parseAddresses("10.0.1.2"), std::invalid_argument);
+  EXPECT_THROW(ImageRelay::parseAddresses("10.0.1.2:"), std::invalid_argument);
+  EXPECT_THROW(ImageRelay::parseAddresses(":9050"), std::invalid_argument);
+  EXPECT_THROW(ImageRelay::parseAddresses("10.0.1.2:65536"), std::invalid_argument);
+  EXPECT_THROW(ImageRelay::parseAddresses("10.0.1.2:90x0"), std::invalid_argument);
+}
+
 TEST(SecondaryTcpServer, TestIpSecondaryIfSecondaryIsNotRunning) {
   in_port_t secondary_port = TestUtils::getFreePortAsInt();
   SecondaryInterface::Ptr ip_secondary;
@@ -693,6 +1188,67 @@ TEST(SecondaryTcpServer, TestIpSecondaryIfSecondaryIsNotRunning) {
   EXPECT_FALSE(ip_secondary->install(target).isSuccess());
 }
 
+/* Connections handling long-running requests, like relaying an image, do not
+ * keep the Primary from connecting. */
+TEST(SecondaryTcpServer, LongRunningRequests) {
+  std::mutex m;
+  std::condition_variable cv;
+  size_t running = 0;
+  bool release = false;
+
+  MsgDispatcher dispatcher;
+  dispatcher.registerLongRunningHandler(AKIpUptaneMes_PR_relayReq, [&](Asn1Message& in_msg, Asn1Message& out_msg) {
+    (void)in_msg;
+    std::unique_lock<std::mutex> lock(m);
+    ++running;
+    cv.notify_all();
+    cv.wait(lock, [&release]() { return release; });
+    auto r = out_msg.present(AKIpUptaneMes_PR_relayResp).relayResp();
+    r->result = AKInstallationResultCode_ok;
+    SetString(&r->description, "");
+    r->cached = 1;
+    return MsgHandler::kOk;
+  });
+  dispatcher.registerHandler(AKIpUptaneMes_PR_versionReq, [](Asn1Message& in_msg, Asn1Message& out_msg) {
+    (void)in_msg;
+    out_msg.present(AKIpUptaneMes_PR_versionResp).versionResp()->version = 2;
+    return MsgHandler::kOk;
+  });
+  SecondaryTcpServer server{dispatcher, "", 0};
+  std::thread server_thread{[&server]() { server.run(); }};
+  server.wait_until_running();
+  const std::pair<std::string, uint16_t> addr{"127.0.0.1", server.port()};
+
+  std::vector<std::thread> relays;
+  for (size_t i = 0; i < SecondaryTcpServer::kMaxSessions; ++i) {
+    relays.emplace_back([&addr]() {
+      Asn1Message::Ptr req(Asn1Message::Empty());
+      req->present(AKIpUptaneMes_PR_relayReq);
+      EXPECT_EQ(Asn1Rpc(req, addr)->present(), AKIpUptaneMes_PR_relayResp);
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(m);
+    EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(10),
+                            [&running]() { return running == SecondaryTcpServer::kMaxSessions; }));
+  }
+
+  Asn1Message::Ptr req(Asn1Message::Empty());
+  req->present(AKIpUptaneMes_PR_versionReq);
+  EXPECT_EQ(Asn1Rpc(req, addr)->present(), AKIpUptaneMes_PR_versionResp);
+
+  {
+    std::lock_guard<std::mutex> guard(m);
+    release = true;
+    cv.notify_all();
+  }
+  for (auto& relay : relays) {
+    relay.join();
+  }
+  server.stop();
+  server_thread.join();
+}
+
 /* This class returns a positive result for every message. The test cases verify
  * that the implementation can recover from situations where something goes wrong. */
 class SecondaryRpcTestPositive : public ::testing::Test, public MsgHandler {
@@ -734,16 +1290,13 @@ class SecondaryRpcTestPositive : public ::testing::Test, public MsgHandler {
   std::thread secondary_server_thread_;
 };
 
-/* This test fails because the Secondary TCP server implementation is a
- * single-threaded, synchronous and blocking hence it cannot accept any new
- * connections until the current one is closed. Therefore, if a client/Primary
- * does not close its socket for some reason then Secondary becomes
- * "unavailable" */
-// TEST_F(SecondaryRpcTestPositive, primaryNotClosingSocket) {
-//  ConnectionSocket con_sock{"127.0.0.1", secondary_server_.port()};
-//  con_sock.connect();
-//  ASSERT_EQ(sendInstallMsg(), AKIpUptaneMes_PR_installResp);
-//}
+/* A Primary connection that is kept open must not make the Secondary
+ * unavailable for other connections. */
+TEST_F(SecondaryRpcTestPositive, primaryNotClosingSocket) {
+  ConnectionSocket con_sock{"127.0.0.1", secondary_server_.port()};
+  con_sock.connect();
+  ASSERT_EQ(sendInstallMsg(), AKIpUptaneMes_PR_installResp);
+}
 
 TEST_F(SecondaryRpcTestPositive, primaryConnectAndDisconnect) {
   ConnectionSocket{"127.0.0.1", secondary_server_.port()}.connect();
@@ -1,13 +1,16 @@
 #include "secondary_tcp_server.h"
 
 #include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include "AKInstallationResultCode.h"
 #include "AKIpUptaneMes.h"
 #include "asn1/asn1_message.h"
 #include "logging/logging.h"
 #include "msg_handler.h"
-#include "utilities/dequeue_buffer.h"
 
 SecondaryTcpServer::SecondaryTcpServer(MsgHandler &msg_handler, const std::string &primary_ip, in_port_t primary_port,
                                        in_port_t port, bool reboot_after_install)
@@ -60,6 +63,11 @@ void SecondaryTcpServer::run() {
       LOG_INFO << "Socket accept failed, aborting.";
       break;
     }
+    if (!keep_running_.load()) {
+      // woken up by stop()
+      close(con_fd);
+      break;
+    }
 
     if (first_connection) {
       LOG_INFO << "Primary connected.";
@@ -67,13 +75,11 @@ void SecondaryTcpServer::run() {
     } else {
       LOG_DEBUG << "Primary reconnected.";
     }
-    auto continue_running = HandleOneConnection(*Socket(con_fd));
-    if (!continue_running) {
-      keep_running_.store(false);
-    }
-    LOG_DEBUG << "Primary disconnected.";
+    startSession(con_fd);
   }
 
+  reapSessions(true);
+
   {
     std::unique_lock<std::mutex> lock(running_condition_mutex_);
     is_running_ = false;
@@ -83,6 +89,51 @@ void SecondaryTcpServer::run() {
   LOG_INFO << "Secondary TCP server exiting.";
 }
 
+void SecondaryTcpServer::startSession(int socket) {
+  reapSessions(false);
+
+  std::lock_guard<std::mutex> guard(sessions_mutex_);
+  const auto counted = std::count_if(sessions_.cbegin(), sessions_.cend(),
+                                     [](const std::shared_ptr<Session> &s) { return !s->long_running; });
+  if (static_cast<size_t>(counted) >= kMaxSessions) {
+    LOG_WARNING << "Too many concurrent connections from Primary, closing the new one.";
+    close(socket);
+    return;
+  }
+  auto session = std::make_shared<Session>(socket);
+  session->thread = std::thread([this, session]() {
+    if (!HandleOneConnection(session->socket, session.get())) {
+      stop();
+    }
+    LOG_DEBUG << "Primary disconnected.";
+    session->finished = true;
+  });
+  sessions_.push_back(session);
+}
+
+void SecondaryTcpServer::reapSessions(bool all) {
+  std::list<std::shared_ptr<Session>> done;
+  {
+    std::lock_guard<std::mutex> guard(sessions_mutex_);
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+      if (all || (*it)->finished) {
+        if (!(*it)->finished) {
+          // unblock recv() in the session
+          shutdown((*it)->socket, SHUT_RDWR);
+        }
+        done.push_back(*it);
+        it = sessions_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto &session : done) {
+    session->thread.join();
+    close(session->socket);
+  }
+}
+
 void SecondaryTcpServer::stop() {
   LOG_DEBUG << "Stopping Secondary TCP server...";
   keep_running_.store(false);
@@ -90,58 +141,47 @@ void SecondaryTcpServer::stop() {
   ConnectionSocket("localhost", listen_socket_.port()).connect();
 }
 
+constexpr size_t SecondaryTcpServer::kMaxSessions;
+
 in_port_t SecondaryTcpServer::port() const { return listen_socket_.port(); }
-SecondaryTcpServer::ExitReason SecondaryTcpServer::exit_reason() const { return exit_reason_; }
+SecondaryTcpServer::ExitReason SecondaryTcpServer::exit_reason() const { return exit_reason_.load(); }
 
 static bool sendResponseMessage(int socket_fd, const Asn1Message::Ptr &resp_msg);
 
-bool SecondaryTcpServer::HandleOneConnection(int socket) {
-  // Outside the message loop, because one recv() may have parts of 2 messages
-  // Note that one recv() call returning 2+ messages doesn't work at the
-  // moment. This shouldn't be a problem until we have messages that aren't
-  // strictly request/response
-  DequeueBuffer buffer;
+bool SecondaryTcpServer::HandleOneConnection(int socket, Session *session) {
   bool keep_running_server = true;
   bool keep_running_current_session = true;
 
+  // Responses are written in one go, so there is nothing for Nagle's algorithm
+  // to coalesce; it would only delay the end of the response.
+  int optval = 1;
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
+
   while (keep_running_current_session) {  // Keep reading until we get an error
-    // Read an incomming message
-    AKIpUptaneMes_t *m = nullptr;
-    asn_dec_rval_t res;
-    asn_codec_ctx_s context{};
-    ssize_t received;
-
-    do {
-      received = recv(socket, buffer.Tail(), buffer.TailSpace(), 0);
-      buffer.HaveEnqueued(static_cast<size_t>(received));
-      res = ber_decode(&context, &asn_DEF_AKIpUptaneMes, reinterpret_cast<void **>(&m), buffer.Head(), buffer.Size());
-      buffer.Consume(res.consumed);
-    } while (res.code == RC_WMORE && received > 0);
-    // Note that ber_decode allocates *m even on failure, so this must always be done
-    Asn1Message::Ptr request_msg = Asn1Message::FromRaw(&m);
-
-    if (received == 0) {
+    Asn1Message::Ptr request_msg = Asn1ReceiveMessage(socket);
+    if (request_msg == nullptr) {
       LOG_TRACE << "Primary has closed a connection socket";
       break;
     }
-
-    if (received < 0) {
-      LOG_ERROR << "Error while reading message data from a socket: " << strerror(errno);
-      break;
-    }
-
-    if (res.code != RC_OK) {
-      LOG_ERROR << "Failed to decode a message received from Primary";
+    if (request_msg->present() == AKIpUptaneMes_PR_NOTHING) {
+      LOG_ERROR << "Failed to receive a message from Primary";
       break;
     }
 
     LOG_DEBUG << "Received a request from Primary: " << request_msg->toStr();
     Asn1Message::Ptr response_msg = Asn1Message::Empty();
+    const bool long_running = session != nullptr && msg_handler_.isLongRunning(*request_msg);
+    if (long_running) {
+      session->long_running = true;
+    }
     MsgHandler::ReturnCode handle_status_code = msg_handler_.handleMsg(request_msg, response_msg);
+    if (long_running) {
+      session->long_running = false;
+    }
 
     switch (handle_status_code) {
       case MsgHandler::ReturnCode::kRebootRequired: {
-        exit_reason_ = ExitReason::kRebootNeeded;
+        exit_reason_.store(ExitReason::kRebootNeeded);
         keep_running_current_session = sendResponseMessage(socket, response_msg);
         if (reboot_after_install_) {
           keep_running_server = keep_running_current_session = false;
@@ -175,17 +215,5 @@ void SecondaryTcpServer::wait_until_running(int timeout) {
 
 bool sendResponseMessage(int socket_fd, const Asn1Message::Ptr &resp_msg) {
   LOG_DEBUG << "Encoding and sending response message";
-
-  int optval = 0;
-  setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
-  asn_enc_rval_t encode_result = der_encode(&asn_DEF_AKIpUptaneMes, &resp_msg->msg_, Asn1SocketWriteCallback,
-                                            reinterpret_cast<void *>(&socket_fd));
-  if (encode_result.encoded == -1) {
-    LOG_ERROR << "Failed to encode a response message";
-    return false;  // write error
-  }
-  optval = 1;
-  setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
-
-  return true;
+  return Asn1SendMessage(socket_fd, resp_msg);
 }
@@ -3,7 +3,10 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 #include "utilities/utils.h"
 
@@ -12,6 +15,12 @@ class MsgHandler;
 /**
  * Listens on a socket, decodes calls (ASN.1) and forwards them to an Uptane Secondary
  * implementation
+ *
+ * Each connection is served by its own thread, up to kMaxSessions at a time, so
+ * that a Primary connection that is stuck or waiting for a long request does not
+ * block others. Whether requests may be handled concurrently is up to the
+ * MsgHandler. Connections handling a request the MsgHandler reports as
+ * long-running do not count against kMaxSessions meanwhile.
  */
 class SecondaryTcpServer {
  public:
@@ -24,6 +33,8 @@ class SecondaryTcpServer {
   SecondaryTcpServer(MsgHandler& msg_handler, const std::string& primary_ip, in_port_t primary_port, in_port_t port = 0,
                      bool reboot_after_install = false);
 
+  static constexpr size_t kMaxSessions = 4;
+
   SecondaryTcpServer(const SecondaryTcpServer&) = delete;
   SecondaryTcpServer& operator=(const SecondaryTcpServer&) = delete;
 
@@ -40,14 +51,28 @@ class SecondaryTcpServer {
   ExitReason exit_reason() const;
 
  private:
-  bool HandleOneConnection(int socket);
+  struct Session {
+    explicit Session(int socket_in) : socket(socket_in) {}
+    // only closed once the thread has been joined
+    int socket;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> long_running{false};
+  };
+
+  bool HandleOneConnection(int socket, Session* session = nullptr);
+  void startSession(int socket);
+  void reapSessions(bool all);
 
  private:
   MsgHandler& msg_handler_;
   ListenSocket listen_socket_;
   std::atomic<bool> keep_running_;
   bool reboot_after_install_;
-  ExitReason exit_reason_{ExitReason::kNotApplicable};
+  std::atomic<ExitReason> exit_reason_{ExitReason::kNotApplicable};
+
+  std::mutex sessions_mutex_;
+  std::list<std::shared_ptr<Session>> sessions_;
 
   bool is_running_;
   std::mutex running_condition_mutex_;
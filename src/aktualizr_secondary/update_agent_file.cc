@@ -1,5 +1,15 @@
 #include "update_agent_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <vector>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
 #include "crypto/crypto.h"
 #include "logging/logging.h"
 #include "uptane/manifest.h"
@@ -9,12 +19,28 @@
 bool FileUpdateAgent::isTargetSupported(const Uptane::Target& target) const { return target.type() != "OSTREE"; }
 
 bool FileUpdateAgent::getInstalledImageInfo(Uptane::InstalledImageInfo& installed_image_info) const {
-  if (boost::filesystem::exists(target_filepath_)) {
-    auto file_content = Utils::readFile(target_filepath_);
+  struct stat st {};
+  if (stat(target_filepath_.c_str(), &st) == 0) {
+    const FileStamp stamp = FileStamp::fromStat(st);
+
+    std::lock_guard<std::mutex> guard(image_info_mutex_);
+    // the image is only re-hashed if the file has been changed by something
+    // other than install()
+    if ((!image_info_valid_ || image_info_stamp_ != stamp) && !loadImageInfo(stamp)) {
+      LOG_INFO << "Calculating the hash of the installed image " << target_filepath_;
+      std::ifstream file(target_filepath_.c_str(), std::ios::binary);
+      auto hasher = MultiPartHasher::create(Hash::Type::kSha256);
+      std::vector<char> buffer(64 * 1024);
+      while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hasher->update(reinterpret_cast<const unsigned char*>(buffer.data()), static_cast<uint64_t>(file.gcount()));
+      }
+      storeImageInfo(stamp, hasher->getHexDigest());
+    }
 
     installed_image_info.name = current_target_name_;
-    installed_image_info.len = file_content.size();
-    installed_image_info.hash = Uptane::ManifestIssuer::generateVersionHashStr(file_content);
+    installed_image_info.len = static_cast<uint64_t>(st.st_size);
+    installed_image_info.hash = image_info_hash_;
   } else {
     // mimic the Primary's fake package manager behavior
     auto unknown_target = Uptane::Target::Unknown();
@@ -26,7 +52,95 @@ bool FileUpdateAgent::getInstalledImageInfo(Uptane::InstalledImageInfo& installe
   return true;
 }
 
+FileUpdateAgent::FileStamp FileUpdateAgent::FileStamp::fromStat(const struct stat& st) {
+  FileStamp stamp;
+  stamp.dev = st.st_dev;
+  stamp.ino = st.st_ino;
+  stamp.size = st.st_size;
+  stamp.mtime_sec = st.st_mtim.tv_sec;
+  stamp.mtime_nsec = st.st_mtim.tv_nsec;
+  return stamp;
+}
+
+bool FileUpdateAgent::FileStamp::operator==(const FileStamp& other) const {
+  return dev == other.dev && ino == other.ino && size == other.size && mtime_sec == other.mtime_sec &&
+         mtime_nsec == other.mtime_nsec;
+}
+
+void FileUpdateAgent::storeImageInfo(const FileStamp& stamp, const std::string& hash) const {
+  image_info_valid_ = true;
+  image_info_stamp_ = stamp;
+  image_info_hash_ = boost::algorithm::to_lower_copy(hash);
+
+  Json::Value info;
+  info["sha256"] = image_info_hash_;
+  info["dev"] = Json::UInt64(stamp.dev);
+  info["ino"] = Json::UInt64(stamp.ino);
+  info["size"] = Json::Int64(stamp.size);
+  info["mtime_sec"] = Json::Int64(stamp.mtime_sec);
+  info["mtime_nsec"] = Json::Int64(stamp.mtime_nsec);
+  try {
+    Utils::writeFile(image_info_filepath_, info);
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Unable to store the installed image info: " << e.what();
+  }
+}
+
+bool FileUpdateAgent::loadImageInfo(const FileStamp& stamp) const {
+  if (image_info_valid_ || !boost::filesystem::exists(image_info_filepath_)) {
+    // only consulted after a restart, the cached info is never older
+    return false;
+  }
+  try {
+    const Json::Value info = Utils::parseJSONFile(image_info_filepath_);
+    FileStamp stored;
+    stored.dev = static_cast<dev_t>(info["dev"].asUInt64());
+    stored.ino = static_cast<ino_t>(info["ino"].asUInt64());
+    stored.size = static_cast<off_t>(info["size"].asInt64());
+    stored.mtime_sec = info["mtime_sec"].asInt64();
+    stored.mtime_nsec = info["mtime_nsec"].asInt64();
+    if (stored != stamp || info["sha256"].asString().empty()) {
+      return false;
+    }
+    image_info_valid_ = true;
+    image_info_stamp_ = stored;
+    image_info_hash_ = info["sha256"].asString();
+    return true;
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Unable to load the installed image info: " << e.what();
+    return false;
+  }
+}
+
 data::InstallationResult FileUpdateAgent::install(const Uptane::Target& target) {
+  if (multicast_session_) {
+    auto result = finishMulticast();
+    if (!result.isSuccess()) {
+      return result;
+    }
+  }
+  if (receive_session_) {
+#ifdef BUILD_ZSTD_DELTA
+    const bool is_delta = receive_session_->encoding() == Encoding::kZstdDelta;
+#endif
+    try {
+      receive_session_->finish();
+    } catch (const std::exception& e) {
+      LOG_ERROR << e.what();
+      receive_session_.reset();
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, e.what());
+    }
+    receive_session_.reset();
+#ifdef BUILD_ZSTD_DELTA
+    if (is_delta) {
+      auto result = applyDelta(target);
+      if (!result.isSuccess()) {
+        return result;
+      }
+    }
+#endif
+  }
+
   if (!boost::filesystem::exists(new_target_filepath_)) {
     LOG_ERROR << "The target image has not been received";
     return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
@@ -44,13 +158,15 @@ data::InstallationResult FileUpdateAgent::install(const Uptane::Target& target)
                                         " != " + std::to_string(target.length()));
   }
 
-  if (!target.MatchHash(new_target_hasher_->getHash())) {
-    LOG_ERROR << "The received image's hash does not match the hash specified in Target metadata: "
-              << new_target_hasher_->getHash() << " != " << getTargetHash(target).HashString();
+  // the digest can only be finalized once
+  const Hash received_hash = multicast_hash_ ? *multicast_hash_ : new_target_hasher_->getHash();
+  multicast_hash_ = boost::none;
+  if (!target.MatchHash(received_hash)) {
+    LOG_ERROR << "The received image's hash does not match the hash specified in Target metadata: " << received_hash
+              << " != " << getTargetHash(target).HashString();
     return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
                                     "The received image's hash does not match the hash specified in Target metadata: " +
-                                        new_target_hasher_->getHash().HashString() +
-                                        " != " + getTargetHash(target).HashString());
+                                        received_hash.HashString() + " != " + getTargetHash(target).HashString());
   }
 
   boost::filesystem::rename(new_target_filepath_, target_filepath_);
@@ -66,6 +182,13 @@ data::InstallationResult FileUpdateAgent::install(const Uptane::Target& target)
   }
 
   current_target_name_ = target.filename();
+
+  // the image has just been hashed while it was received
+  struct stat st {};
+  if (received_hash.type() == Hash::Type::kSha256 && stat(target_filepath_.c_str(), &st) == 0) {
+    std::lock_guard<std::mutex> guard(image_info_mutex_);
+    storeImageInfo(FileStamp::fromStat(st), received_hash.HashString());
+  }
   new_target_hasher_.reset();
   return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
 }
@@ -79,62 +202,337 @@ data::InstallationResult FileUpdateAgent::applyPendingInstall(const Uptane::Targ
 }
 
 data::InstallationResult FileUpdateAgent::receiveData(const Uptane::Target& target, const uint8_t* data, size_t size) {
-  std::ofstream target_file(new_target_filepath_.c_str(),
-                            std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+  if (!receive_session_ || !receive_session_->isFor(target, Encoding::kRaw)) {
+    auto result = startReceiving(target, Encoding::kRaw);
+    if (!result.isSuccess()) {
+      return result;
+    }
+  }
+  return storeData(target, data, size);
+}
+
+#ifdef BUILD_ZSTD
+data::InstallationResult FileUpdateAgent::receiveCompressedData(const Uptane::Target& target, const uint8_t* data,
+                                                                size_t size) {
+  if (!receive_session_ || !receive_session_->isFor(target, Encoding::kZstd)) {
+    auto result = startReceiving(target, Encoding::kZstd);
+    if (!result.isSuccess()) {
+      return result;
+    }
+    decompressor_.reset(ZSTD_createDStream());
+    if (!decompressor_ || ZSTD_isError(ZSTD_initDStream(decompressor_.get())) != 0U) {
+      LOG_ERROR << "Failed to set up the decompression of the received data";
+      receive_session_.reset();
+      return data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                      "Failed to set up the decompression of the received data");
+    }
+    decompressed_.resize(ZSTD_DStreamOutSize());
+  }
+
+  ZSTD_inBuffer in{data, size, 0};
+  bool output_full = false;
+  // a full output buffer may mean that more data is pending in the decompressor
+  while (in.pos < in.size || output_full) {
+    ZSTD_outBuffer out{decompressed_.data(), decompressed_.size(), 0};
+    const size_t res = ZSTD_decompressStream(decompressor_.get(), &out, &in);
+    if (ZSTD_isError(res) != 0U) {
+      LOG_ERROR << "Failed to decompress the received data: " << ZSTD_getErrorName(res);
+      receive_session_.reset();
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      std::string("Failed to decompress the received data: ") + ZSTD_getErrorName(res));
+    }
+    if (out.pos > 0) {
+      auto result = storeData(target, decompressed_.data(), out.pos);
+      if (!result.isSuccess()) {
+        return result;
+      }
+    }
+    output_full = out.pos == out.size;
+  }
+
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+data::InstallationResult FileUpdateAgent::receiveDeltaData(const Uptane::Target& target, const std::string& base_hash,
+                                                           const uint8_t* data, size_t size) {
+  if (!receive_session_ || !receive_session_->isFor(target, Encoding::kZstdDelta) || base_hash != delta_base_hash_) {
+    Uptane::InstalledImageInfo installed_image_info;
+    getInstalledImageInfo(installed_image_info);
+    if (Hash(Hash::Type::kSha256, base_hash) != Hash(Hash::Type::kSha256, installed_image_info.hash)) {
+      LOG_ERROR << "The base image of the delta is not installed: " << base_hash;
+      receive_session_.reset();
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "The base image of the delta is not installed: " + base_hash);
+    }
+    auto result = startReceiving(target, Encoding::kZstdDelta);
+    if (!result.isSuccess()) {
+      return result;
+    }
+    delta_base_hash_ = base_hash;
+  }
+  return storeData(target, data, size);
+}
+
+data::InstallationResult FileUpdateAgent::applyDelta(const Uptane::Target& target) {
+  try {
+    // the installed image must not have changed since the delta was received
+    Uptane::InstalledImageInfo installed_image_info;
+    getInstalledImageInfo(installed_image_info);
+    if (Hash(Hash::Type::kSha256, delta_base_hash_) != Hash(Hash::Type::kSha256, installed_image_info.hash)) {
+      throw std::runtime_error("the installed image has changed");
+    }
 
-  if (!target_file.good()) {
-    LOG_ERROR << "Failed to open a new target image file";
+    const MappedFile base(target_filepath_);
+    const MappedFile delta(delta_filepath_);
+    MappedFile image(new_target_filepath_, target.length());
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    // the window of a delta covers the whole base image
+    if (dctx == nullptr ||
+        ZSTD_isError(ZSTD_DCtx_setParameter(dctx.get(), ZSTD_d_windowLogMax,
+                                            ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound)) != 0U ||
+        ZSTD_isError(ZSTD_DCtx_refPrefix(dctx.get(), base.data(), base.size())) != 0U) {
+      throw std::runtime_error("unable to set up the decompression");
+    }
+    // decompressing in one go into the mapped file needs no window buffer
+    const size_t res = ZSTD_decompressDCtx(dctx.get(), image.data(), image.size(), delta.data(), delta.size());
+    if (ZSTD_isError(res) != 0U) {
+      throw std::runtime_error(ZSTD_getErrorName(res));
+    }
+    if (res != image.size()) {
+      throw std::runtime_error("the image is " + std::to_string(res) + " bytes instead of " +
+                               std::to_string(image.size()));
+    }
+    new_target_hasher_->update(image.data(), image.size());
+    image.sync();
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to apply the delta: " << e.what();
+    boost::filesystem::remove(delta_filepath_);
+    boost::filesystem::remove(new_target_filepath_);
     return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
-                                    "Failed to open a new target image file");
+                                    std::string("Failed to apply the delta: ") + e.what());
   }
+  boost::filesystem::remove(delta_filepath_);
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+#endif
 
-  auto current_new_image_size = target_file.tellp();
-  if (-1 == current_new_image_size) {
-    LOG_ERROR << "Failed to obtain a size of the new target image that is being uploaded";
-    target_file.close();
+data::InstallationResult FileUpdateAgent::startMulticast(const Uptane::Target& target, const std::string& group,
+                                                         uint16_t port, uint32_t session) {
+  receive_session_.reset();
+  multicast_session_.reset();
+  multicast_hash_ = boost::none;
+  if (target.length() == 0) {
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Empty images are not received over multicast");
+  }
+  try {
+    multicast_session_ =
+        std_::make_unique<MulticastSession>(new_target_filepath_, target, group, port, session);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to start receiving the target image over multicast: " << e.what();
     return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
-                                    "Failed to obtain a size of the new target image that is being uploaded");
+                                    std::string("Failed to start receiving the target image over multicast: ") +
+                                        e.what());
   }
+  boost::filesystem::remove(delta_filepath_);
+  new_target_hasher_ = MultiPartHasher::create(getTargetHash(target).type());
+  LOG_INFO << "Receiving the target image from multicast group " << group << ":" << port;
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
 
-  if (static_cast<uint64_t>(current_new_image_size) >= target.length()) {
+data::InstallationResult FileUpdateAgent::multicastStatus(uint32_t* missing) {
+  if (multicast_session_) {
+    *missing = multicast_session_->receiver.missing();
+    if (multicast_session_->receiver.timedOut()) {
+      multicast_session_.reset();
+      boost::filesystem::remove(new_target_filepath_);
+      return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "Stopped receiving the target image over multicast; " +
+                                          std::to_string(*missing) + " blocks are missing");
+    }
+    if (*missing > 0) {
+      return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+    }
+    return finishMulticast();
+  }
+  if (multicast_hash_) {
+    *missing = 0;
+    return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  }
+  return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                  "The target image is not being received over multicast");
+}
+
+data::InstallationResult FileUpdateAgent::finishMulticast() {
+  const uint32_t missing = multicast_session_->receiver.missing();
+  if (missing != 0) {
+    LOG_ERROR << "The target image has not been received over multicast; " << missing << " blocks are missing";
+    multicast_session_.reset();
+    boost::filesystem::remove(new_target_filepath_);
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "The target image has not been received over multicast; " +
+                                        std::to_string(missing) + " blocks are missing");
+  }
+  try {
+    const MappedFile& image = multicast_session_->image;
+    new_target_hasher_->update(image.data(), image.size());
+    image.sync();
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to store the target image: " << e.what();
+    multicast_session_.reset();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    std::string("Failed to store the target image: ") + e.what());
+  }
+  const Uptane::Target target = multicast_session_->target;
+  multicast_session_.reset();
+
+  // the digest can only be finalized once
+  const Hash received_hash = new_target_hasher_->getHash();
+  if (!target.MatchHash(received_hash)) {
+    LOG_ERROR << "The image received over multicast does not match the hash specified in Target metadata: "
+              << received_hash << " != " << getTargetHash(target).HashString();
+    boost::filesystem::remove(new_target_filepath_);
+    return data::InstallationResult(
+        data::ResultCode::Numeric::kDownloadFailed,
+        "The image received over multicast does not match the hash specified in Target metadata: " +
+            received_hash.HashString() + " != " + getTargetHash(target).HashString());
+  }
+  multicast_hash_ = received_hash;
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
+data::InstallationResult FileUpdateAgent::startReceiving(const Uptane::Target& target, Encoding encoding) {
+  const bool is_delta = encoding == Encoding::kZstdDelta;
+  // an upload over TCP replaces a multicast one
+  multicast_session_.reset();
+  multicast_hash_ = boost::none;
+  try {
+    receive_session_ =
+        std_::make_unique<ReceiveSession>(is_delta ? delta_filepath_ : new_target_filepath_, target, encoding);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to open a new target image file: " << e.what();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    "Failed to open a new target image file");
+  }
+  if (!is_delta) {
+    // left behind by a delta upload that was given up on
+    boost::filesystem::remove(delta_filepath_);
+  }
+  new_target_hasher_ = MultiPartHasher::create(getTargetHash(target).type());
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
+data::InstallationResult FileUpdateAgent::storeData(const Uptane::Target& target, const uint8_t* data, size_t size) {
+  const uint64_t current_new_image_size = receive_session_->size();
+  if (current_new_image_size >= target.length()) {
     LOG_ERROR << "The size of the received image data exceeds the expected Target image size: "
               << current_new_image_size << " != " << target.length();
-    target_file.close();
     return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
                                     "The size of the received image data exceeds the expected Target image size: " +
                                         std::to_string(current_new_image_size) +
                                         " != " + std::to_string(target.length()));
   }
 
-  if (current_new_image_size == 0) {
-    new_target_hasher_ = MultiPartHasher::create(getTargetHash(target).type());
+  try {
+    receive_session_->write(data, size);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to store the received data: " << e.what();
+    receive_session_.reset();
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                    std::string("Failed to store the received data: ") + e.what());
   }
 
-  target_file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
-  auto written_data_size = target_file.tellp() - current_new_image_size;
+  const uint64_t total_size = receive_session_->size();
+  LOG_RATE_LIMITED(debug, 1) << "Received and stored data of a new target image."
+                                " Received in this request (bytes): "
+                             << size << "; total received so far: " << total_size
+                             << "; expected total: " << target.length();
+  if (total_size == target.length()) {
+    LOG_INFO << "Successfully received and stored new target image of " << total_size << " bytes.";
+  }
 
-  if (written_data_size < 0 || static_cast<size_t>(written_data_size) != size) {
-    LOG_ERROR << "The size of data written is not equal to the received data size: " << written_data_size
-              << " != " << size;
-    target_file.close();
-    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
-                                    "The size of data written is not equal to the received data size: " +
-                                        std::to_string(written_data_size) + " != " + std::to_string(size));
+  // a delta is only hashed once the image has been reconstructed
+  if (receive_session_->encoding() != Encoding::kZstdDelta) {
+    new_target_hasher_->update(data, size);
   }
 
-  target_file.close();
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
 
-  auto total_size = current_new_image_size + written_data_size;
-  LOG_DEBUG << "Received and stored data of a new target image."
-               " Received in this request (bytes): "
-            << size << "; total received so far: " << total_size << "; expected total: " << target.length();
-  if (static_cast<uint64_t>(total_size) == target.length()) {
-    LOG_INFO << "Successfully received and stored new target image of " << total_size << " bytes.";
+constexpr size_t FileUpdateAgent::ReceiveSession::kBufferSize;
+
+FileUpdateAgent::ReceiveSession::ReceiveSession(const boost::filesystem::path& path, const Uptane::Target& target,
+                                                Encoding encoding)
+    : path_{path}, target_{target}, encoding_{encoding} {
+  // a previous, interrupted upload is started over
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd_ < 0) {
+    throw std::runtime_error(path_.string() + ": " + std::strerror(errno));
+  }
+  // Reserve the space up front: this fails early if the image does not fit and
+  // avoids extending the file on every write.
+  const int err = Utils::reserveFileSpace(fd_, target_.length());
+  if (err == ENOSPC || err == EFBIG) {
+    close(fd_);
+    throw std::runtime_error("Not enough space for an image of " + std::to_string(target_.length()) + " bytes");
+  }
+  if (err != 0) {
+    LOG_DEBUG << "Could not preallocate " << target_.length() << " bytes for " << path_ << ": " << std::strerror(err);
   }
+  buffer_.reserve(kBufferSize);
+}
 
-  new_target_hasher_->update(data, size);
+FileUpdateAgent::ReceiveSession::~ReceiveSession() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
 
-  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+void FileUpdateAgent::ReceiveSession::write(const uint8_t* data, size_t size) {
+  if (buffer_.size() + size > kBufferSize) {
+    flush();
+  }
+  if (size >= kBufferSize) {
+    writeAll(data, size);
+  } else {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    buffer_.insert(buffer_.end(), data, data + size);
+  }
+  size_ += size;
+}
+
+void FileUpdateAgent::ReceiveSession::flush() {
+  writeAll(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void FileUpdateAgent::ReceiveSession::writeAll(const uint8_t* data, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const ssize_t res = ::write(fd_, data + written, size - written);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(path_.string() + ": " + std::strerror(errno));
+    }
+    written += static_cast<size_t>(res);
+  }
+}
+
+void FileUpdateAgent::ReceiveSession::finish() {
+  flush();
+  if (ftruncate(fd_, static_cast<off_t>(size_)) != 0 || fsync(fd_) != 0) {
+    throw std::runtime_error(path_.string() + ": " + std::strerror(errno));
+  }
+  const int fd = fd_;
+  fd_ = -1;
+  if (close(fd) != 0) {
+    throw std::runtime_error(path_.string() + ": " + std::strerror(errno));
+  }
 }
 
 Hash FileUpdateAgent::getTargetHash(const Uptane::Target& target) {
@@ -1,6 +1,19 @@
 #ifndef AKTUALIZR_SECONDARY_UPDATE_AGENT_FILE_H
 #define AKTUALIZR_SECONDARY_UPDATE_AGENT_FILE_H
 
+#include <sys/stat.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#ifdef BUILD_ZSTD
+#include <zstd.h>
+#endif
+
+#include "multicast.h"
 #include "update_agent.h"
 
 class FileUpdateAgent : public UpdateAgent {
@@ -8,6 +21,8 @@ class FileUpdateAgent : public UpdateAgent {
   FileUpdateAgent(boost::filesystem::path target_filepath, std::string target_name)
       : target_filepath_{std::move(target_filepath)},
         new_target_filepath_{target_filepath_.string() + ".newtarget"},
+        delta_filepath_{target_filepath_.string() + ".delta"},
+        image_info_filepath_{target_filepath_.string() + ".imageinfo"},
         current_target_name_{std::move(target_name)} {}
 
  public:
@@ -15,19 +30,134 @@ class FileUpdateAgent : public UpdateAgent {
   bool getInstalledImageInfo(Uptane::InstalledImageInfo& installed_image_info) const override;
 
   virtual data::InstallationResult receiveData(const Uptane::Target& target, const uint8_t* data, size_t size);
+#ifdef BUILD_ZSTD
+  // Receives a piece of an image compressed as a single zstd stream. The
+  // decompressed image is checked just like one received by receiveData().
+  virtual data::InstallationResult receiveCompressedData(const Uptane::Target& target, const uint8_t* data,
+                                                         size_t size);
+#endif
+#ifdef BUILD_ZSTD_DELTA
+  // Receives a piece of a zstd delta of the image against the installed image,
+  // which must have the given sha256 hash. The image is reconstructed and
+  // checked by install().
+  virtual data::InstallationResult receiveDeltaData(const Uptane::Target& target, const std::string& base_hash,
+                                                    const uint8_t* data, size_t size);
+#endif
+  // Starts receiving the image from a multicast session in the background.
+  // A new session or an upload over TCP aborts it, and so does receiving
+  // nothing for multicast::kReceiveTimeout.
+  virtual data::InstallationResult startMulticast(const Uptane::Target& target, const std::string& group,
+                                                  uint16_t port, uint32_t session);
+  // Number of blocks of the image that have not been received over multicast.
+  // The image is checked once it is complete, and a failure is returned if it
+  // does not match the Target, so that the Primary can upload it over TCP.
+  virtual data::InstallationResult multicastStatus(uint32_t* missing);
   data::InstallationResult install(const Uptane::Target& target) override;
 
   void completeInstall() override;
   data::InstallationResult applyPendingInstall(const Uptane::Target& target) override;
 
  private:
+  // How the data of a new image is received.
+  enum class Encoding { kRaw, kZstd, kZstdDelta };
+
+  // A new image being received. The file is kept open between uploaded
+  // chunks and written through a buffer; it is only synced to disk once the
+  // whole image has been received.
+  class ReceiveSession {
+   public:
+    ReceiveSession(const boost::filesystem::path& path, const Uptane::Target& target, Encoding encoding);
+    ~ReceiveSession();
+    ReceiveSession(const ReceiveSession&) = delete;
+    ReceiveSession& operator=(const ReceiveSession&) = delete;
+
+    bool isFor(const Uptane::Target& target, Encoding encoding) const {
+      return encoding_ == encoding && target_.MatchTarget(target);
+    }
+    Encoding encoding() const { return encoding_; }
+    uint64_t size() const { return size_; }
+    void write(const uint8_t* data, size_t size);
+    // Writes out the buffer, trims the preallocated space and syncs the file.
+    void finish();
+
+   private:
+    void flush();
+    void writeAll(const uint8_t* data, size_t size);
+
+    static constexpr size_t kBufferSize = 256 * 1024;
+
+    const boost::filesystem::path path_;
+    const Uptane::Target target_;
+    const Encoding encoding_;
+    int fd_{-1};
+    uint64_t size_{0};
+    std::vector<uint8_t> buffer_;
+  };
+
+  // A new image being received over multicast, straight into the mapped file.
+  struct MulticastSession {
+    MulticastSession(const boost::filesystem::path& path, const Uptane::Target& image_target, const std::string& group,
+                     uint16_t port, uint32_t session)
+        : target{image_target},
+          image{path, image_target.length()},
+          receiver{group, port, session, image.data(), image.size()} {}
+
+    const Uptane::Target target;
+    // declared before the receiver, so that the receiver stops before it is
+    // unmapped
+    MappedFile image;
+    multicast::Receiver receiver;
+  };
+
+  // Identifies a version of the installed image file without reading it.
+  struct FileStamp {
+    dev_t dev{0};
+    ino_t ino{0};
+    off_t size{0};
+    int64_t mtime_sec{0};
+    int64_t mtime_nsec{0};
+
+    static FileStamp fromStat(const struct stat& st);
+    bool operator==(const FileStamp& other) const;
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+  };
+
+  data::InstallationResult startReceiving(const Uptane::Target& target, Encoding encoding);
+  data::InstallationResult storeData(const Uptane::Target& target, const uint8_t* data, size_t size);
+#ifdef BUILD_ZSTD_DELTA
+  // Reconstructs the new image from the received delta and the installed image.
+  data::InstallationResult applyDelta(const Uptane::Target& target);
+#endif
+  data::InstallationResult finishMulticast();
   static Hash getTargetHash(const Uptane::Target& target);
+  void storeImageInfo(const FileStamp& stamp, const std::string& hash) const;
+  bool loadImageInfo(const FileStamp& stamp) const;
 
  private:
   const boost::filesystem::path target_filepath_;
   const boost::filesystem::path new_target_filepath_;
+  const boost::filesystem::path delta_filepath_;
+  // Length and hash of the installed image, along with the stamp of the file
+  // they were computed for, so they survive restarts.
+  const boost::filesystem::path image_info_filepath_;
   std::string current_target_name_;
   std::shared_ptr<MultiPartHasher> new_target_hasher_;
+  std::unique_ptr<ReceiveSession> receive_session_;
+  std::unique_ptr<MulticastSession> multicast_session_;
+  // hash of the image received over multicast, once it has been checked
+  boost::optional<Hash> multicast_hash_;
+#ifdef BUILD_ZSTD
+  std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> decompressor_{nullptr, ZSTD_freeDStream};
+  std::vector<uint8_t> decompressed_;
+#endif
+#ifdef BUILD_ZSTD_DELTA
+  std::string delta_base_hash_;
+#endif
+
+  mutable std::mutex image_info_mutex_;
+  mutable bool image_info_valid_{false};
+  mutable FileStamp image_info_stamp_;
+  mutable std::string image_info_hash_;
 };
 
 #endif  // AKTUALIZR_SECONDARY_UPDATE_AGENT_FILE_H
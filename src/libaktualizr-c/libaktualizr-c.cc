@@ -67,6 +67,77 @@ int Aktualizr_set_signal_handler(Aktualizr *a, void (*handler)(const char *event
   return 0;
 }
 
+static Json::Value metrics_to_json(const result::MetadataMetrics &metrics) {
+  Json::Value json;
+  json["fetch_ms"] = static_cast<Json::Int64>(metrics.fetch_time.count());
+  json["verify_ms"] = static_cast<Json::Int64>(metrics.verify_time.count());
+  json["files"] = metrics.files;
+  json["bytes"] = static_cast<Json::UInt64>(metrics.bytes);
+  return json;
+}
+
+static Json::Value metrics_to_json(const std::map<std::string, result::DownloadMetrics> &metrics) {
+  Json::Value json(Json::objectValue);
+  for (const auto &m : metrics) {
+    Json::Value &target = json[m.first];
+    target["bytes"] = static_cast<Json::UInt64>(m.second.bytes);
+    target["total_ms"] = static_cast<Json::Int64>(m.second.total_time.count());
+    target["first_byte_ms"] = static_cast<Json::Int64>(m.second.time_to_first_byte.count());
+    target["hash_ms"] = static_cast<Json::Int64>(m.second.hash_time.count());
+    target["retries"] = m.second.retries;
+    target["bytes_per_second"] = m.second.throughput();
+  }
+  return json;
+}
+
+static Json::Value metrics_to_json(const std::vector<result::Install::EcuReport> &reports) {
+  Json::Value json(Json::objectValue);
+  for (const auto &r : reports) {
+    Json::Value &ecu = json[r.serial.ToString()];
+    ecu["target"] = r.update.filename();
+    ecu["send_ms"] = static_cast<Json::Int64>(r.send_time.count());
+    ecu["install_ms"] = static_cast<Json::Int64>(r.install_time.count());
+  }
+  return json;
+}
+
+static void metrics_handler_wrapper(const std::shared_ptr<event::BaseEvent> &event,
+                                    void (*handler)(const char *, const char *)) {
+  std::string phase;
+  Json::Value metrics;
+  if (event->isTypeOf<event::UpdateCheckComplete>()) {
+    phase = "check";
+    metrics = metrics_to_json(dynamic_cast<event::UpdateCheckComplete *>(event.get())->result.metrics);
+  } else if (event->isTypeOf<event::AllDownloadsComplete>()) {
+    phase = "download";
+    metrics = metrics_to_json(dynamic_cast<event::AllDownloadsComplete *>(event.get())->result.metrics);
+  } else if (event->isTypeOf<event::AllInstallsComplete>()) {
+    phase = "install";
+    metrics = metrics_to_json(dynamic_cast<event::AllInstallsComplete *>(event.get())->result.ecu_reports);
+  } else {
+    return;
+  }
+
+  if (handler == nullptr) {
+    std::cerr << "metrics_handler_wrapper error: no external handler" << std::endl;
+    return;
+  }
+  const std::string json = Utils::jsonToCanonicalStr(metrics);
+  (*handler)(phase.c_str(), json.c_str());
+}
+
+int Aktualizr_set_metrics_handler(Aktualizr *a, void (*handler)(const char *phase, const char *metrics_json)) {
+  try {
+    auto functor = std::bind(metrics_handler_wrapper, std::placeholders::_1, handler);
+    a->SetSignalHandler(functor);
+
+  } catch (const std::exception &e) {
+    std::cerr << "Aktualizr_set_metrics_handler exception: " << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
 Campaign *Aktualizr_campaigns_check(Aktualizr *a) {
   try {
     auto r = a->CampaignCheck().get();
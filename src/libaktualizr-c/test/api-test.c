@@ -34,6 +34,25 @@ static void signal_handler(const char *event_name) {
   }
 }
 
+struct MetricsCounts {
+  int CheckCount;
+  int DownloadCount;
+  int InstallCount;
+} metrics_counts;
+
+static void metrics_handler(const char *phase, const char *metrics_json) {
+  if (metrics_json == NULL || metrics_json[0] != '{') {
+    return;
+  }
+  if (strcmp(phase, "check") == 0) {
+    ++metrics_counts.CheckCount;
+  } else if (strcmp(phase, "download") == 0) {
+    ++metrics_counts.DownloadCount;
+  } else if (strcmp(phase, "install") == 0) {
+    ++metrics_counts.InstallCount;
+  }
+}
+
 int main(int argc, char **argv) {
   Aktualizr *a;
   Campaign *c;
@@ -76,6 +95,15 @@ int main(int argc, char **argv) {
     CLEANUP_AND_RETURN_FAILED;
   }
 
+  metrics_counts.CheckCount = 0;
+  metrics_counts.DownloadCount = 0;
+  metrics_counts.InstallCount = 0;
+  err = Aktualizr_set_metrics_handler(a, &metrics_handler);
+  if (err) {
+    printf("Aktualizr_set_metrics_handler failed\n");
+    CLEANUP_AND_RETURN_FAILED;
+  }
+
   c = Aktualizr_campaigns_check(a);
   if (c == NULL) {
     printf("Aktualizr_campaigns_check returned NULL\n");
@@ -218,5 +246,10 @@ int main(int argc, char **argv) {
         counts.UpdateCheckCompleteCount, counts.DownloadProgressReportCount, counts.OtherCount);
     return EXIT_FAILURE;
   }
+  if (metrics_counts.CheckCount == 0 || metrics_counts.DownloadCount == 0 || metrics_counts.InstallCount == 0) {
+    printf("Aktualizr_set_metrics_handler failed\nCheckCount = %i\nDownloadCount = %i\nInstallCount = %i\n",
+           metrics_counts.CheckCount, metrics_counts.DownloadCount, metrics_counts.InstallCount);
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
@@ -2,10 +2,16 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <climits>
+#include <vector>
 
 #include "asn1_message.h"
 #include "logging/logging.h"
-#include "utilities/dequeue_buffer.h"
+#include "telemetry/metrics.h"
+#include "telemetry/tracing.h"
 #include "utilities/utils.h"
 
 #ifndef MSG_NOSIGNAL
@@ -18,30 +24,216 @@ int Asn1StringAppendCallback(const void* buffer, size_t size, void* priv) {
   return 0;
 }
 
+namespace {
+
 /**
- * Adaptor to write output of der_encode to a socket
- * priv is a SocketHandle
+ * Collects the output of der_encode for a single sendmsg(). asn1c hands
+ * primitive values to the callback straight from the message, so large ones
+ * can be referenced in place until the message has been sent; everything else
+ * comes from small scratch buffers and is copied.
  */
-int Asn1SocketWriteCallback(const void* buffer, size_t size, void* priv) {
-  auto sock = reinterpret_cast<int*>(priv);  // NOLINT
-  assert(sock != nullptr);
-  assert(-1 < *sock);
+class GatherWriter {
+ public:
+  static int append(const void* buffer, size_t size, void* priv) {
+    auto* writer = static_cast<GatherWriter*>(priv);
+    const auto* data = static_cast<const char*>(buffer);
+    if (size >= kReferenceThreshold) {
+      writer->pieces_.push_back(Piece{data, 0, size});
+    } else if (size > 0) {
+      if (writer->pieces_.empty() || writer->pieces_.back().external != nullptr) {
+        writer->pieces_.push_back(Piece{nullptr, writer->copied_.size(), 0});
+      }
+      writer->copied_.append(data, size);
+      writer->pieces_.back().size += size;
+    }
+    return 0;
+  }
+
+  bool send(int fd) const {
+    std::vector<iovec> iov;
+    iov.reserve(pieces_.size());
+    for (const auto& piece : pieces_) {
+      iovec vec{};
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      vec.iov_base = const_cast<char*>(piece.external != nullptr ? piece.external : copied_.data() + piece.offset);
+      vec.iov_len = piece.size;
+      iov.push_back(vec);
+    }
+
+    size_t first = 0;
+    while (first < iov.size()) {
+      msghdr header{};
+      header.msg_iov = &iov[first];
+      header.msg_iovlen = std::min(iov.size() - first, static_cast<size_t>(IOV_MAX));
+      const ssize_t written = sendmsg(fd, &header, MSG_NOSIGNAL);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG_ERROR << "write: " << std::strerror(errno);
+        return false;
+      }
+      // skip what has been sent, possibly in the middle of a piece
+      auto left = static_cast<size_t>(written);
+      while (left > 0 && left >= iov[first].iov_len) {
+        left -= iov[first].iov_len;
+        ++first;
+      }
+      if (left > 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+        iov[first].iov_len -= left;
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Tag and length scratch buffers in asn1c are much smaller than this.
+  static constexpr size_t kReferenceThreshold = 256;
 
-  const auto* b = static_cast<const char*>(buffer);
-  size_t len = size;
-  size_t pos = 0;
+  struct Piece {
+    // either points into the message, or is nullptr for data in copied_
+    const char* external;
+    size_t offset;
+    size_t size;
+  };
 
-  while (len > 0) {
+  std::string copied_;
+  std::vector<Piece> pieces_;
+};
+
+// Returns the number of bytes received, which is less than size only if the
+// peer closed the connection, or -1 on errors.
+ssize_t recvAll(int fd, char* buffer, size_t size) {
+  size_t received = 0;
+  while (received < size) {
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    ssize_t written = send(*sock, b + pos, len, MSG_NOSIGNAL);
-    if (written < 0) {
-      LOG_ERROR << "write: " << std::strerror(errno);
-      return 1;
+    const ssize_t res = recv(fd, buffer + received, size - received, 0);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (res == 0) {
+      break;
     }
-    len -= static_cast<size_t>(written);
-    pos += static_cast<size_t>(written);
+    received += static_cast<size_t>(res);
   }
-  return 0;
+  return static_cast<ssize_t>(received);
+}
+
+}  // namespace
+
+bool Asn1SendMessage(int fd, const Asn1Message::Ptr& msg) {
+  GatherWriter writer;
+  const asn_enc_rval_t res = der_encode(&asn_DEF_AKIpUptaneMes, &msg->msg_, GatherWriter::append, &writer);
+  if (res.encoded == -1) {
+    LOG_ERROR << "Failed to encode a message";
+    return false;
+  }
+  return writer.send(fd);
+}
+
+Asn1Message::Ptr Asn1ReceiveMessage(int fd) {
+  // Long enough for any tag we use, and lengths of up to 4 bytes.
+  constexpr size_t kMaxTagSize = 4;
+  constexpr size_t kMaxLengthSize = 4;
+  // The content is received in steps of this size, so that a bogus length
+  // does not make us allocate it all up front.
+  constexpr size_t kReceiveStep = 1024 * 1024;
+
+  std::vector<char> buffer;
+  bool closed = false;
+  auto read_more = [&](size_t size) {
+    const size_t old_size = buffer.size();
+    buffer.resize(old_size + size);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const ssize_t res = recvAll(fd, buffer.data() + old_size, size);
+    if (res < 0) {
+      LOG_ERROR << "Failed to read data from a connection socket: " << std::strerror(errno);
+      return false;
+    }
+    buffer.resize(old_size + static_cast<size_t>(res));
+    closed = static_cast<size_t>(res) < size;
+    return !closed;
+  };
+  auto byte_at = [&buffer](size_t pos) { return static_cast<uint8_t>(buffer[pos]); };
+  auto failure = [](const char* reason) {
+    LOG_ERROR << reason;
+    return Asn1Message::Empty();
+  };
+
+  // identifier and (first) length octet
+  if (!read_more(2)) {
+    if (closed && buffer.empty()) {
+      return nullptr;
+    }
+    return failure("Failed to receive an ASN.1 message header");
+  }
+  size_t pos = 1;
+  if ((byte_at(0) & 0x1FU) == 0x1FU) {
+    // high tag number form, continued while bit 8 is set
+    while ((byte_at(pos) & 0x80U) != 0) {
+      if (pos >= kMaxTagSize || !read_more(1)) {
+        return failure("Failed to receive an ASN.1 message tag");
+      }
+      ++pos;
+    }
+    ++pos;
+    if (!read_more(1)) {
+      return failure("Failed to receive an ASN.1 message length");
+    }
+  }
+  size_t length = byte_at(pos);
+  if ((length & 0x80U) != 0) {
+    const size_t length_size = length & 0x7FU;
+    // DER does not allow the indefinite form (0)
+    if (length_size == 0 || length_size > kMaxLengthSize || !read_more(length_size)) {
+      return failure("Failed to receive an ASN.1 message length");
+    }
+    length = 0;
+    for (size_t i = 1; i <= length_size; ++i) {
+      length = (length << 8U) | byte_at(pos + i);
+    }
+  }
+  if (length > kMaxAsn1MessageSize) {
+    return failure("Refusing to receive an ASN.1 message of more than 16 MiB");
+  }
+
+  buffer.reserve(buffer.size() + std::min(length, kReceiveStep));
+  for (size_t remaining = length; remaining > 0;) {
+    const size_t step = std::min(remaining, kReceiveStep);
+    if (!read_more(step)) {
+      return failure("Failed to receive an ASN.1 message");
+    }
+    remaining -= step;
+  }
+  LOG_RATE_LIMITED(trace, 10) << "Received ASN.1 message " << Utils::toBase64(std::string(buffer.begin(), buffer.end()));
+
+  AKIpUptaneMes_t* m = nullptr;
+  asn_codec_ctx_s context{};
+  const asn_dec_rval_t res =
+      ber_decode(&context, &asn_DEF_AKIpUptaneMes, reinterpret_cast<void**>(&m), buffer.data(), buffer.size());
+  // Note that ber_decode allocates *m even on failure, so this must always be done
+  Asn1Message::Ptr msg = Asn1Message::FromRaw(&m);
+  if (res.code != RC_OK || res.consumed != buffer.size()) {
+    LOG_ERROR << "Failed to decode an ASN.1 message";
+    msg->present(AKIpUptaneMes_PR_NOTHING);
+  }
+  return msg;
+}
+
+Asn1StringView::Asn1StringView(OCTET_STRING_t* dest, const uint8_t* data, size_t size) : dest_(dest) {
+  ASN_STRUCT_FREE_CONTENTS_ONLY(asn_DEF_OCTET_STRING, dest_);
+  dest_->buf = const_cast<uint8_t*>(data);
+  dest_->size = static_cast<int>(size);
+}
+
+Asn1StringView::~Asn1StringView() {
+  dest_->buf = nullptr;
+  dest_->size = 0;
 }
 
 std::string ToString(const OCTET_STRING_t& octet_str) {
@@ -52,38 +244,32 @@ void SetString(OCTET_STRING_t* dest, const std::string& str) {
   OCTET_STRING_fromBuf(dest, str.c_str(), static_cast<int>(str.size()));
 }
 
-Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd) {
-  der_encode(&asn_DEF_AKIpUptaneMes, &tx->msg_, Asn1SocketWriteCallback, &con_fd);
+// Name of the CHOICE alternative, e.g. "getInfoReq", for the metrics labels
+static std::string messageName(AKIpUptaneMes_PR present) {
+  const auto index = static_cast<size_t>(present);
+  if (index == 0 || index > static_cast<size_t>(asn_DEF_AKIpUptaneMes.elements_count)) {
+    return "unknown";
+  }
+  return asn_DEF_AKIpUptaneMes.elements[index - 1].name;
+}
 
-  // Bounce TCP_NODELAY to flush the TCP send buffer
+Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd) {
+  TRACE_SPAN("Asn1Rpc");
+  metrics::ScopedTimer timer("aktualizr_secondary_rpc_duration_seconds",
+                             {{"method", messageName(tx->present())}, {"result", "ok"}});
+  // Messages are written in one go, so there is nothing for Nagle's algorithm
+  // to coalesce; it would only delay the end of the message.
   int no_delay = 1;
   setsockopt(con_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
-  no_delay = 0;
-  setsockopt(con_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
 
-  AKIpUptaneMes_t* m = nullptr;
-  asn_dec_rval_t res;
-  asn_codec_ctx_s context{};
-  DequeueBuffer buffer;
-  ssize_t received;
-  do {
-    res.code = RC_FAIL;
-    received = recv(con_fd, buffer.Tail(), buffer.TailSpace(), 0);
-    if (received < 0) {
-      LOG_ERROR << "Failed to read data from a coonnection socket: " << strerror(errno);
-      break;
-    }
-    LOG_TRACE << "Asn1Rpc read " << Utils::toBase64(std::string(buffer.Tail(), static_cast<size_t>(received)));
-    buffer.HaveEnqueued(static_cast<size_t>(received));
-    res = ber_decode(&context, &asn_DEF_AKIpUptaneMes, reinterpret_cast<void**>(&m), buffer.Head(), buffer.Size());
-    buffer.Consume(res.consumed);
-  } while (res.code == RC_WMORE && received > 0);
-  // Note that ber_decode allocates *m even on failure, so this must always be done
-  Asn1Message::Ptr msg = Asn1Message::FromRaw(&m);
-
-  if (res.code != RC_OK) {
-    LOG_DEBUG << "Asn1Rpc decoding failed";
-    msg->present(AKIpUptaneMes_PR_NOTHING);
+  Asn1Message::Ptr msg;
+  if (Asn1SendMessage(con_fd, tx)) {
+    msg = Asn1ReceiveMessage(con_fd);
+  }
+  if (msg == nullptr || msg->present() == AKIpUptaneMes_PR_NOTHING) {
+    LOG_DEBUG << "Asn1Rpc failed";
+    timer.setLabel("result", "error");
+    msg = Asn1Message::Empty();
   }
 
   return msg;
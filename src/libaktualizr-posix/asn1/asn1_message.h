@@ -91,6 +91,14 @@ class Asn1Message {
   ASN1_MESSAGE_DEFINE_ACCESSOR(AKInstallResp2Mes_t, installResp2);
   ASN1_MESSAGE_DEFINE_ACCESSOR(AKVersionReqMes_t, versionReq);
   ASN1_MESSAGE_DEFINE_ACCESSOR(AKVersionRespMes_t, versionResp);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKUploadDataReqMes_t, uploadZstdDataReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKUploadDeltaDataReqMes_t, uploadDeltaDataReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKMulticastStartReqMes_t, multicastStartReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKMulticastStatusReqMes_t, multicastStatusReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKMulticastStatusRespMes_t, multicastStatusResp);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKRelayDataReqMes_t, relayDataReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKRelayReqMes_t, relayReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKRelayRespMes_t, relayResp);
 
 #define ASN1_MESSAGE_DEFINE_STR_NAME(MessageID) \
   case MessageID:                               \
@@ -120,6 +128,14 @@ class Asn1Message {
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_installResp2);
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_versionReq);
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_versionResp);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_uploadZstdDataReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_uploadDeltaDataReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_multicastStartReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_multicastStatusReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_multicastStatusResp);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_relayDataReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_relayReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_relayResp);
     }
     return "Unknown";
   };
@@ -151,10 +167,45 @@ class Asn1Message {
 int Asn1StringAppendCallback(const void* buffer, size_t size, void* priv);
 
 /**
- * Adaptor to write output of der_encode to a socket
- * priv is a pointer to an int holding the fd
+ * Write a message to a socket with a single sendmsg() call in the common case.
+ * Small fragments of the DER encoding (tags, lengths, short fields) are
+ * gathered into one buffer, while large payloads are sent from where they are
+ * in the message without being copied.
  */
-int Asn1SocketWriteCallback(const void* buffer, size_t size, void* priv);
+bool Asn1SendMessage(int fd, const Asn1Message::Ptr& msg);
+
+/**
+ * Largest message accepted by Asn1ReceiveMessage. Images are sent in chunks of
+ * 64 KiB, so the largest messages are those carrying metadata: the Image repo
+ * Targets alone may take up to 8 MiB (kMaxImageTargetsSize).
+ */
+constexpr size_t kMaxAsn1MessageSize = 16 * 1024 * 1024;
+
+/**
+ * Read exactly one DER encoded message from a socket. The length in its header
+ * is used to receive the whole message before decoding it in one go.
+ * Returns nullptr if the peer closed the connection before sending anything,
+ * and a message without content (AKIpUptaneMes_PR_NOTHING) on errors,
+ * including lengths above kMaxAsn1MessageSize.
+ */
+Asn1Message::Ptr Asn1ReceiveMessage(int fd);
+
+/**
+ * Point an OCTET_STRING_t at a buffer owned by the caller instead of copying
+ * it, for payloads that are only encoded and sent. The string is detached
+ * again on destruction, which must happen before the message holding it is
+ * freed.
+ */
+class Asn1StringView {
+ public:
+  Asn1StringView(OCTET_STRING_t* dest, const uint8_t* data, size_t size);
+  ~Asn1StringView();
+  Asn1StringView(const Asn1StringView&) = delete;
+  Asn1StringView& operator=(const Asn1StringView&) = delete;
+
+ private:
+  OCTET_STRING_t* dest_;
+};
 
 /**
  * Convert OCTET_STRING_t into std::string
@@ -4,8 +4,13 @@
 
 #include <gtest/gtest.h>
 
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "libaktualizr/config.h"
 
@@ -269,6 +274,94 @@ TEST(asn1_common, Asn1MessageFromRawNull) {
   Asn1Message::FromRaw(&m);
 }
 
+// Joins a thread sending to a socket pair even if a check fails first. The
+// receiving end is shut down then, so that the thread cannot block on a full
+// socket buffer.
+class SenderGuard {
+ public:
+  SenderGuard(std::thread& sender, int receiver_fd) : sender_(sender), receiver_fd_(receiver_fd) {}
+  ~SenderGuard() {
+    if (sender_.joinable()) {
+      shutdown(receiver_fd_, SHUT_RDWR);
+      sender_.join();
+    }
+  }
+  SenderGuard(const SenderGuard&) = delete;
+  SenderGuard& operator=(const SenderGuard&) = delete;
+
+ private:
+  std::thread& sender_;
+  int receiver_fd_;
+};
+
+static void sendUploadData(int fd, const std::vector<uint8_t>& payload) {
+  Asn1Message::Ptr req(Asn1Message::Empty());
+  req->present(AKIpUptaneMes_PR_uploadDataReq);
+  auto m = req->uploadDataReq();
+  Asn1StringView data_view(&m->data, payload.data(), payload.size());
+  Asn1SendMessage(fd, req);
+}
+
+/* Send and receive messages larger than the socket buffers, one after the
+ * other on the same connection. */
+TEST(asn1_common, SendAndReceiveMessage) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  const std::vector<uint8_t> payload(3 * 1024 * 1024 + 7, 'x');
+  std::thread sender([&fds, &payload]() {
+    for (int i = 0; i < 2; ++i) {
+      sendUploadData(fds[0], payload);
+    }
+    close(fds[0]);
+  });
+  {
+    SenderGuard guard(sender, fds[1]);
+    for (int i = 0; i < 2; ++i) {
+      Asn1Message::Ptr msg = Asn1ReceiveMessage(fds[1]);
+      ASSERT_TRUE(msg != nullptr);
+      ASSERT_EQ(msg->present(), AKIpUptaneMes_PR_uploadDataReq);
+      EXPECT_EQ(ToString(msg->uploadDataReq()->data), std::string(payload.begin(), payload.end()));
+    }
+    sender.join();
+  }
+  // connection closed between messages
+  EXPECT_TRUE(Asn1ReceiveMessage(fds[1]) == nullptr);
+  close(fds[1]);
+}
+
+/* Refuse messages longer than kMaxAsn1MessageSize without receiving them. */
+TEST(asn1_common, ReceiveOversizeMessage) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  const std::vector<uint8_t> payload(kMaxAsn1MessageSize, 'x');
+  std::thread sender([&fds, &payload]() { sendUploadData(fds[0], payload); });
+  {
+    SenderGuard guard(sender, fds[1]);
+    Asn1Message::Ptr msg = Asn1ReceiveMessage(fds[1]);
+    ASSERT_TRUE(msg != nullptr);
+    EXPECT_EQ(msg->present(), AKIpUptaneMes_PR_NOTHING);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/* Reject messages that are cut short or cannot be decoded. */
+TEST(asn1_common, ReceiveBrokenMessage) {
+  for (const std::string &data : {std::string("\x30\x99\x02\x01", 4), std::string("\xa6\x09\x30\x07", 4),
+                                  std::string("\x30\x02\x05\x00", 4), std::string("some garbage message")}) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(write(fds[0], data.data(), data.size()), static_cast<ssize_t>(data.size()));
+    close(fds[0]);
+    Asn1Message::Ptr msg = Asn1ReceiveMessage(fds[1]);
+    ASSERT_TRUE(msg != nullptr);
+    EXPECT_EQ(msg->present(), AKIpUptaneMes_PR_NOTHING);
+    close(fds[1]);
+  }
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
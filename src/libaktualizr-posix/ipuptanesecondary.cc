@@ -1,14 +1,26 @@
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <sys/socket.h>
 
-#include <array>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef BUILD_ZSTD
+#include <zstd.h>
+#endif
 
 #include "asn1/asn1_message.h"
+#include "crypto/crypto.h"
 #include "der_encoder.h"
 #include "ipuptanesecondary.h"
 #include "logging/logging.h"
+#include "multicast.h"
 #include "storage/invstorage.h"
+#include "utilities/shared_file.h"
+#include "utilities/utils.h"
 
 namespace Uptane {
 
@@ -102,7 +114,15 @@ IpUptaneSecondary::IpUptaneSecondary(const std::string& address, unsigned short
  * installation. */
 void IpUptaneSecondary::getSecondaryVersion() const {
   LOG_DEBUG << "Negotiating the protocol version with Secondary " << getSerial();
+#if defined(BUILD_ZSTD_DELTA)
+  // Version 4 adds delta uploads to version 3.
+  const uint32_t latest_version = 4;
+#elif defined(BUILD_ZSTD)
+  // Version 3 only adds compressed image uploads to version 2.
+  const uint32_t latest_version = 3;
+#else
   const uint32_t latest_version = 2;
+#endif
   Asn1Message::Ptr req(Asn1Message::Empty());
   req->present(AKIpUptaneMes_PR_versionReq);
   auto m = req->versionReq();
@@ -145,7 +165,7 @@ data::InstallationResult IpUptaneSecondary::putMetadata(const Target& target) {
 
   LOG_INFO << "Sending Uptane metadata to the Secondary";
   data::InstallationResult put_result;
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     put_result = putMetadata_v2(meta_bundle);
   } else if (protocol_version == 1) {
     put_result = putMetadata_v1(meta_bundle);
@@ -273,14 +293,27 @@ bool IpUptaneSecondary::ping() const {
 
   auto m = req->getInfoReq();
 
-  auto resp = Asn1Rpc(req, getAddr());
+  // a Secondary that accepts but never answers must not stall the wait for
+  // it; on Linux the send timeout also bounds connect()
+  timeval timeout{3, 0};
+  const auto& addr = getAddr();
+  ConnectionSocket connection(addr.first, addr.second);
+  setsockopt(*connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(*connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  if (connection.connect() < 0) {
+    LOG_DEBUG << "Failed to connect to the Secondary ( " << addr.first << ":" << addr.second
+              << "): " << std::strerror(errno);
+    return false;
+  }
+
+  auto resp = Asn1Rpc(req, *connection);
 
   return resp->present() == AKIpUptaneMes_PR_getInfoResp;
 }
 
 data::InstallationResult IpUptaneSecondary::sendFirmware(const Uptane::Target& target) {
   data::InstallationResult send_result;
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     send_result = sendFirmware_v2(target);
   } else if (protocol_version == 1) {
     send_result = sendFirmware_v1(target);
@@ -338,7 +371,7 @@ data::InstallationResult IpUptaneSecondary::sendFirmware_v2(const Uptane::Target
 
 data::InstallationResult IpUptaneSecondary::install(const Uptane::Target& target) {
   data::InstallationResult install_result;
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     install_result = install_v2(target);
   } else if (protocol_version == 1) {
     install_result = install_v1(target);
@@ -408,20 +441,46 @@ data::InstallationResult IpUptaneSecondary::uploadFirmware(const Uptane::Target&
   LOG_INFO << "Uploading the target image (" << target.filename() << ") "
            << "to the Secondary (" << getSerial() << ")";
 
+  data::InstallationResult multicast_result;
+  if (!multicast_.group.empty() && uploadMulticast(target, &multicast_result)) {
+    return multicast_result;
+  }
+  data::InstallationResult relay_result;
+  if (relay_ && uploadRelayed(target, &relay_result)) {
+    return relay_result;
+  }
+#ifdef BUILD_ZSTD_DELTA
+  data::InstallationResult delta_result;
+  if (protocol_version >= 4 && uploadDelta(target, &delta_result)) {
+    return delta_result;
+  }
+#endif
+#ifdef BUILD_ZSTD
+  if (protocol_version >= 3) {
+    return uploadCompressedFirmware(target);
+  }
+#endif
+
   auto upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "");
 
-  auto image_reader = secondary_provider_->getTargetFileHandle(target);
+  // Secondaries receiving the same Target at the same time share the reads.
+  auto image_reader = secondary_provider_->getTargetFileReader(target);
 
   uint64_t image_size = target.length();
-  const size_t size = 1024;
+  // Larger chunks mean fewer round trips; older Secondaries decode messages
+  // of any size incrementally, so this does not affect compatibility.
+  const size_t size = 64 * 1024;
   size_t total_send_data = 0;
-  std::array<uint8_t, size> buf{};
+  std::vector<uint8_t> buf(size);
   auto upload_data_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
 
   while (total_send_data < image_size && upload_data_result.isSuccess()) {
-    image_reader.read(reinterpret_cast<char*>(buf.data()), buf.size());
-    upload_data_result = uploadFirmwareData(buf.data(), static_cast<size_t>(image_reader.gcount()));
-    total_send_data += static_cast<size_t>(image_reader.gcount());
+    const size_t read_size = image_reader->read(buf.data(), buf.size());
+    if (read_size == 0) {
+      break;
+    }
+    upload_data_result = uploadFirmwareData(buf.data(), read_size);
+    total_send_data += read_size;
   }
   if (upload_data_result.isSuccess() && total_send_data == image_size) {
     upload_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
@@ -430,35 +489,479 @@ data::InstallationResult IpUptaneSecondary::uploadFirmware(const Uptane::Target&
   } else {
     upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
   }
-  image_reader.close();
   return upload_result;
 }
 
-data::InstallationResult IpUptaneSecondary::uploadFirmwareData(const uint8_t* data, size_t size) {
+#ifdef BUILD_ZSTD
+data::InstallationResult IpUptaneSecondary::uploadCompressedFirmware(const Uptane::Target& target) {
+  // zstd's default level compresses far faster than the link between the ECUs
+  const int compression_level = 3;
+  std::unique_ptr<ZSTD_CStream, size_t (*)(ZSTD_CStream*)> stream(ZSTD_createCStream(), ZSTD_freeCStream);
+  if (stream == nullptr || ZSTD_isError(ZSTD_initCStream(stream.get(), compression_level)) != 0U) {
+    LOG_ERROR << "Failed to set up the compression of the target image";
+    return data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                    "Failed to set up the compression of the target image");
+  }
+
+  auto image_reader = secondary_provider_->getTargetFileReader(target);
+
+  const uint64_t image_size = target.length();
+  const size_t size = 64 * 1024;
+  uint64_t total_read_data = 0;
+  uint64_t total_send_data = 0;
+  std::vector<uint8_t> in_buf(size);
+  std::vector<uint8_t> out_buf(size);
+  ZSTD_outBuffer out{out_buf.data(), out_buf.size(), 0};
+  auto upload_data_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  bool compression_failed = false;
+
+  // Compressed data is only sent in full chunks, except for the last one.
+  auto send_output = [&](bool last) {
+    if (out.pos == out.size || (last && out.pos > 0)) {
+      upload_data_result = uploadFirmwareData(out_buf.data(), out.pos, true);
+      total_send_data += out.pos;
+      out.pos = 0;
+    }
+  };
+
+  while (total_read_data < image_size && upload_data_result.isSuccess() && !compression_failed) {
+    const size_t read_size = image_reader->read(in_buf.data(), in_buf.size());
+    if (read_size == 0) {
+      break;
+    }
+    total_read_data += read_size;
+    ZSTD_inBuffer in{in_buf.data(), read_size, 0};
+    while (in.pos < in.size && upload_data_result.isSuccess()) {
+      if (ZSTD_isError(ZSTD_compressStream(stream.get(), &out, &in)) != 0U) {
+        compression_failed = true;
+        break;
+      }
+      send_output(false);
+    }
+  }
+
+  if (upload_data_result.isSuccess() && !compression_failed && total_read_data == image_size) {
+    size_t remaining = 0;
+    do {
+      remaining = ZSTD_endStream(stream.get(), &out);
+      if (ZSTD_isError(remaining) != 0U) {
+        compression_failed = true;
+        break;
+      }
+      send_output(remaining == 0);
+    } while (remaining != 0 && upload_data_result.isSuccess());
+  }
+
+  if (compression_failed) {
+    LOG_ERROR << "Failed to compress the target image";
+    return data::InstallationResult(data::ResultCode::Numeric::kInternalError, "Failed to compress the target image");
+  }
+  if (!upload_data_result.isSuccess()) {
+    return upload_data_result;
+  }
+  if (total_read_data != image_size) {
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
+  }
+  LOG_INFO << "Uploaded " << image_size << " bytes compressed to " << total_send_data << " bytes to the Secondary ("
+           << getSerial() << ")";
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+#endif
+
+#ifdef BUILD_ZSTD_DELTA
+/* Whether compressing the data as for compressed uploads takes more than
+ * `limit` bytes. The compression stops as soon as it does. */
+static bool compressesBeyond(const uint8_t* data, size_t size, size_t limit) {
+  // same level as full compressed uploads
+  const int compression_level = 3;
+  std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+  if (cctx == nullptr ||
+      ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, compression_level)) != 0U) {
+    return true;
+  }
+  std::vector<uint8_t> out_buf(64 * 1024);
+  ZSTD_inBuffer in{data, size, 0};
+  size_t total_size = 0;
+  size_t remaining = 0;
+  do {
+    ZSTD_outBuffer out{out_buf.data(), out_buf.size(), 0};
+    remaining = ZSTD_compressStream2(cctx.get(), &out, &in, ZSTD_e_end);
+    if (ZSTD_isError(remaining) != 0U) {
+      return true;
+    }
+    total_size += out.pos;
+    if (total_size > limit) {
+      return true;
+    }
+  } while (remaining != 0);
+  return false;
+}
+
+/* Send the image as a zstd delta against the image installed on the
+ * Secondary, if the Primary still has a copy of the latter and the delta is
+ * smaller than the compressed image. Returns false if the image should be
+ * uploaded in full instead; nothing has been sent to the Secondary in that
+ * case. */
+bool IpUptaneSecondary::uploadDelta(const Uptane::Target& target, data::InstallationResult* result) {
+  const Manifest manifest = getManifest();
+  if (manifest.empty() || manifest.filepath().empty()) {
+    return false;
+  }
+
+  try {
+    const Hash base_hash = manifest.installedImageHash();
+    const uint64_t base_length = manifest["signed"]["installed_image"]["fileinfo"]["length"].asUInt64();
+    const Uptane::Target base_target(manifest.filepath(), Uptane::EcuMap{}, {base_hash}, base_length);
+    const auto base_path = secondary_provider_->getTargetFilePath(base_target);
+    const auto image_path = secondary_provider_->getTargetFilePath(target);
+    if (!base_path || !image_path || base_length == 0 || target.length() == 0) {
+      LOG_DEBUG << "No base image for a delta upload to the Secondary (" << getSerial() << ")";
+      return false;
+    }
+
+    const MappedFile base(*base_path);
+    const MappedFile image(*image_path);
+    if (base.size() != base_length || image.size() != target.length()) {
+      return false;
+    }
+    // the Secondary checks the hash of its base image as well, but this falls
+    // back to a full upload instead of failing it
+    auto hasher = MultiPartHasher::create(Hash::Type::kSha256);
+    hasher->update(base.data(), base.size());
+    if (hasher->getHash() != base_hash) {
+      LOG_DEBUG << "The stored copy of " << manifest.filepath() << " does not match the Secondary's image";
+      return false;
+    }
+
+    // The window has to reach from the end of the image back to the start of
+    // the base image for the latter to be used at all.
+    int window_log = 10;
+    while (window_log < 32 && (uint64_t{1} << window_log) < base.size() + image.size()) {
+      ++window_log;
+    }
+    if (window_log > ZSTD_cParam_getBounds(ZSTD_c_windowLog).upperBound) {
+      LOG_DEBUG << "The target image is too large for a delta upload";
+      return false;
+    }
+
+    // same level as full compressed uploads
+    const int compression_level = 3;
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    if (cctx == nullptr ||
+        ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, compression_level)) != 0U ||
+        ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_enableLongDistanceMatching, 1)) != 0U ||
+        ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_windowLog, window_log)) != 0U ||
+        ZSTD_isError(ZSTD_CCtx_refPrefix(cctx.get(), base.data(), base.size())) != 0U) {
+      LOG_ERROR << "Failed to set up the delta compression of the target image";
+      return false;
+    }
+
+    // The whole delta is computed before anything is sent, so that the full
+    // image can still be uploaded instead. It is not kept beyond the size of
+    // the image, which the Secondary would not accept anyway.
+    const size_t size = 64 * 1024;
+    std::vector<uint8_t> delta;
+    ZSTD_inBuffer in{image.data(), image.size(), 0};
+    size_t remaining = 0;
+    do {
+      const size_t delta_size = delta.size();
+      if (delta_size >= image.size()) {
+        LOG_DEBUG << "The delta is not smaller than the target image";
+        return false;
+      }
+      delta.resize(std::min(delta_size + size, image.size()));
+      ZSTD_outBuffer out{delta.data() + delta_size, delta.size() - delta_size, 0};
+      remaining = ZSTD_compressStream2(cctx.get(), &out, &in, ZSTD_e_end);
+      if (ZSTD_isError(remaining) != 0U) {
+        LOG_ERROR << "Failed to compute a delta of the target image: " << ZSTD_getErrorName(remaining);
+        return false;
+      }
+      delta.resize(delta_size + out.pos);
+    } while (remaining != 0);
+    cctx.reset();
+    if (delta.size() >= image.size() || !compressesBeyond(image.data(), image.size(), delta.size())) {
+      LOG_DEBUG << "The delta is not smaller than the compressed target image";
+      return false;
+    }
+
+    uint64_t total_send_data = 0;
+    auto upload_data_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+    while (total_send_data < delta.size() && upload_data_result.isSuccess()) {
+      const size_t chunk_size = std::min(size, delta.size() - static_cast<size_t>(total_send_data));
+      upload_data_result = uploadDeltaData(base_hash.HashString(), delta.data() + total_send_data, chunk_size);
+      if (total_send_data == 0 && !upload_data_result.isSuccess()) {
+        // most likely the Secondary's image has changed since its manifest
+        LOG_INFO << "The Secondary (" << getSerial() << ") rejected a delta upload: "
+                 << upload_data_result.description << "; uploading the full image";
+        return false;
+      }
+      total_send_data += chunk_size;
+    }
+
+    *result = upload_data_result;
+    if (upload_data_result.isSuccess()) {
+      LOG_INFO << "Uploaded " << image.size() << " bytes as a delta of " << total_send_data
+               << " bytes to the Secondary (" << getSerial() << ")";
+    }
+    return true;
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to upload a delta of the target image: " << e.what();
+    return false;
+  }
+}
+#endif
+
+static bool multicastStatus(const Asn1Message::Ptr& resp, const EcuSerial& serial, uint32_t* missing) {
+  if (resp->present() != AKIpUptaneMes_PR_multicastStatusResp) {
+    // older Secondaries drop the connection on unknown requests
+    LOG_DEBUG << "Secondary " << serial << " does not support receiving images over multicast";
+    return false;
+  }
+  auto r = resp->multicastStatusResp();
+  if (static_cast<data::ResultCode::Numeric>(r->result) != data::ResultCode::Numeric::kOk) {
+    LOG_WARNING << "Secondary " << serial
+                << " failed to receive the image over multicast: " << ToString(r->description);
+    return false;
+  }
+  *missing = static_cast<uint32_t>(r->missing);
+  return true;
+}
+
+/* Send the image to the multicast group, along with the other Secondaries
+ * receiving it from the same group at the same time. Returns false if the
+ * image should be uploaded over TCP instead, e.g. because the Secondary does
+ * not support multicast, stopped making progress or received an image that
+ * does not match its hash; the Secondary drops what it has received when the
+ * upload starts. */
+bool IpUptaneSecondary::uploadMulticast(const Uptane::Target& target, data::InstallationResult* result) {
+  const auto poll_interval = std::chrono::milliseconds(500);
+
+  const auto image_path = secondary_provider_->getTargetFilePath(target);
+  if (!image_path || target.length() == 0) {
+    return false;
+  }
+
+  // Nothing is sent to the group before the Secondary is ready to receive it.
+  const uint32_t session = multicast::Sender::session(multicast_, *image_path);
   Asn1Message::Ptr req(Asn1Message::Empty());
-  req->present(AKIpUptaneMes_PR_uploadDataReq);
+  req->present(AKIpUptaneMes_PR_multicastStartReq);
+  auto m = req->multicastStartReq();
+  SetString(&m->group, multicast_.group);
+  m->port = multicast_.port;
+  m->session = session;
+
+  uint32_t missing = 0;
+  if (!multicastStatus(Asn1Rpc(req, getAddr()), getSerial(), &missing)) {
+    return false;
+  }
+  std::shared_ptr<multicast::Sender> sender;
+  try {
+    sender = multicast::Sender::join(multicast_, *image_path, session);
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Unable to send the target image over multicast: " << e.what();
+    return false;
+  }
+  LOG_INFO << "Sending the target image to the Secondary (" << getSerial() << ") over multicast group "
+           << multicast_.group << ":" << multicast_.port;
+
+  auto last_progress = std::chrono::steady_clock::now();
+  while (missing > 0) {
+    std::this_thread::sleep_for(poll_interval);
+    Asn1Message::Ptr status_req(Asn1Message::Empty());
+    status_req->present(AKIpUptaneMes_PR_multicastStatusReq);
+    uint32_t now_missing = 0;
+    if (!multicastStatus(Asn1Rpc(status_req, getAddr()), getSerial(), &now_missing)) {
+      return false;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now_missing < missing) {
+      last_progress = now;
+    } else if (now - last_progress > multicast_.timeout) {
+      LOG_WARNING << "The Secondary (" << getSerial() << ") stopped receiving the target image over multicast with "
+                  << now_missing << " blocks missing; uploading it directly";
+      return false;
+    }
+    missing = now_missing;
+  }
 
-  auto m = req->uploadDataReq();
-  OCTET_STRING_fromBuf(&m->data, reinterpret_cast<const char*>(data), static_cast<int>(size));
-  auto resp = Asn1Rpc(req, getAddr());
+  LOG_INFO << "The Secondary (" << getSerial() << ") received the target image over multicast";
+  *result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  return true;
+}
 
+static data::InstallationResult uploadDataResult(const Asn1Message::Ptr& resp, const EcuSerial& serial) {
   if (resp->present() == AKIpUptaneMes_PR_NOTHING) {
-    LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive firmware data.";
+    LOG_ERROR << "Secondary " << serial << " failed to respond to a request to receive firmware data.";
     return data::InstallationResult(
         data::ResultCode::Numeric::kUnknown,
-        "Secondary " + getSerial().ToString() + " failed to respond to a request to receive firmware data.");
+        "Secondary " + serial.ToString() + " failed to respond to a request to receive firmware data.");
   }
   if (resp->present() != AKIpUptaneMes_PR_uploadDataResp) {
-    LOG_ERROR << "Secondary " << getSerial() << " returned an invalid response to a request to receive firmware data.";
+    LOG_ERROR << "Secondary " << serial << " returned an invalid response to a request to receive firmware data.";
     return data::InstallationResult(
         data::ResultCode::Numeric::kInternalError,
-        "Secondary " + getSerial().ToString() + " returned an invalid reponse to a request to receive firmware data.");
+        "Secondary " + serial.ToString() + " returned an invalid reponse to a request to receive firmware data.");
   }
 
   auto r = resp->uploadDataResp();
   return data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result), ToString(r->description));
 }
 
+data::InstallationResult IpUptaneSecondary::uploadFirmwareData(const uint8_t* data, size_t size, bool compressed) {
+  Asn1Message::Ptr req(Asn1Message::Empty());
+  req->present(compressed ? AKIpUptaneMes_PR_uploadZstdDataReq : AKIpUptaneMes_PR_uploadDataReq);
+
+  auto m = compressed ? req->uploadZstdDataReq() : req->uploadDataReq();
+  Asn1StringView data_view(&m->data, data, size);
+  return uploadDataResult(Asn1Rpc(req, getAddr()), getSerial());
+}
+
+#ifdef BUILD_ZSTD_DELTA
+data::InstallationResult IpUptaneSecondary::uploadDeltaData(const std::string& base_hash, const uint8_t* data,
+                                                            size_t size) {
+  Asn1Message::Ptr req(Asn1Message::Empty());
+  req->present(AKIpUptaneMes_PR_uploadDeltaDataReq);
+
+  auto m = req->uploadDeltaDataReq();
+  SetString(&m->baseHash, base_hash);
+  Asn1StringView data_view(&m->data, data, size);
+  return uploadDataResult(Asn1Rpc(req, getAddr()), getSerial());
+}
+#endif
+
+data::InstallationResult IpRelay::uploadOnce(const std::string& hash,
+                                            const std::function<data::InstallationResult()>& upload) {
+  {
+    std::unique_lock<std::mutex> lock(m_);
+    cv_.wait(lock, [this, &hash]() {
+      auto it = uploads_.find(hash);
+      return it == uploads_.end() || it->second;
+    });
+    if (uploads_.count(hash) != 0) {
+      return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+    }
+    uploads_[hash] = false;
+  }
+
+  data::InstallationResult result;
+  try {
+    result = upload();
+  } catch (const std::exception& e) {
+    result = data::InstallationResult(data::ResultCode::Numeric::kUnknown, e.what());
+  }
+
+  std::lock_guard<std::mutex> guard(m_);
+  if (result.isSuccess()) {
+    uploads_[hash] = true;
+  } else {
+    uploads_.erase(hash);
+  }
+  cv_.notify_all();
+  return result;
+}
+
+void IpRelay::forget(const std::string& hash) {
+  std::lock_guard<std::mutex> guard(m_);
+  auto it = uploads_.find(hash);
+  // an upload that is still running is not forgotten
+  if (it != uploads_.end() && it->second) {
+    uploads_.erase(it);
+  }
+}
+
+/* Have the relay upload the image to this Secondary, after uploading the image
+ * to the relay if it does not have it yet. The image then only crosses the
+ * Primary's link once for all Secondaries behind the same relay. Returns false
+ * if the image should be uploaded directly instead; nothing has been sent to
+ * this Secondary in that case. */
+bool IpUptaneSecondary::uploadRelayed(const Uptane::Target& target, data::InstallationResult* result) {
+  if (target.sha256Hash().empty() || target.length() == 0) {
+    return false;
+  }
+  const auto& relay_addr = relay_->getAddr();
+
+  bool cached = false;
+  *result = relayImage(target, &cached);
+  if (cached) {
+    return true;
+  }
+  if (result->result_code.num_code != data::ResultCode::Numeric::kDownloadFailed) {
+    // not just missing the image, e.g. it does not relay to this Secondary
+    LOG_WARNING << "The relay at " << relay_addr.first << ":" << relay_addr.second
+                << " cannot relay the target image: " << result->description << "; uploading it directly";
+    return false;
+  }
+  // Secondaries behind the same relay that are sent the image at the same
+  // time wait for a single upload.
+  const auto upload_result = relay_->uploadOnce(target.sha256Hash(), [this, &target]() { return uploadToRelay(target); });
+  if (!upload_result.isSuccess()) {
+    LOG_WARNING << "Unable to upload the target image to the relay at " << relay_addr.first << ":"
+                << relay_addr.second << ": " << upload_result.description << "; uploading it directly";
+    return false;
+  }
+  *result = relayImage(target, &cached);
+  if (!cached) {
+    // the relay has dropped the image since
+    relay_->forget(target.sha256Hash());
+    LOG_WARNING << "The relay at " << relay_addr.first << ":" << relay_addr.second
+                << " does not have the target image; uploading it directly";
+    return false;
+  }
+  return true;
+}
+
+data::InstallationResult IpUptaneSecondary::relayImage(const Uptane::Target& target, bool* cached) {
+  Asn1Message::Ptr req(Asn1Message::Empty());
+  req->present(AKIpUptaneMes_PR_relayReq);
+  auto m = req->relayReq();
+  SetString(&m->hash, target.sha256Hash());
+  m->length = static_cast<int64_t>(target.length());
+  SetString(&m->host, getAddr().first);
+  m->port = getAddr().second;
+
+  auto resp = Asn1Rpc(req, relay_->getAddr());
+  if (resp->present() != AKIpUptaneMes_PR_relayResp) {
+    // also the case for Secondaries that are not configured as relays
+    LOG_DEBUG << "The relay at " << relay_->getAddr().first << ":" << relay_->getAddr().second
+              << " failed to respond to a relay request";
+    *cached = false;
+    return data::InstallationResult(data::ResultCode::Numeric::kUnknown, "The relay failed to respond");
+  }
+  auto r = resp->relayResp();
+  *cached = r->cached != 0;
+  return data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result), ToString(r->description));
+}
+
+data::InstallationResult IpUptaneSecondary::uploadToRelay(const Uptane::Target& target) {
+  LOG_INFO << "Uploading the target image (" << target.filename() << ") to the relay at " << relay_->getAddr().first
+           << ":" << relay_->getAddr().second;
+  auto image_reader = secondary_provider_->getTargetFileReader(target);
+  std::vector<uint8_t> buf(64 * 1024);
+  uint64_t total_send_data = 0;
+  while (total_send_data < target.length()) {
+    const size_t read_size = image_reader->read(buf.data(), buf.size());
+    if (read_size == 0) {
+      break;
+    }
+    Asn1Message::Ptr req(Asn1Message::Empty());
+    req->present(AKIpUptaneMes_PR_relayDataReq);
+    auto m = req->relayDataReq();
+    SetString(&m->hash, target.sha256Hash());
+    m->length = static_cast<int64_t>(target.length());
+    m->offset = static_cast<int64_t>(total_send_data);
+    Asn1StringView data_view(&m->data, buf.data(), read_size);
+    auto upload_result = uploadDataResult(Asn1Rpc(req, relay_->getAddr()), getSerial());
+    if (!upload_result.isSuccess()) {
+      return upload_result;
+    }
+    total_send_data += read_size;
+  }
+  if (total_send_data != target.length()) {
+    return data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
+  }
+  return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+}
+
 data::InstallationResult IpUptaneSecondary::invokeInstallOnSecondary(const Uptane::Target& target) {
   Asn1Message::Ptr req(Asn1Message::Empty());
   req->present(AKIpUptaneMes_PR_installReq);
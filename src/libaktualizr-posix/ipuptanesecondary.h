@@ -1,13 +1,44 @@
 #ifndef UPTANE_IPUPTANESECONDARY_H_
 #define UPTANE_IPUPTANESECONDARY_H_
 
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+
 #include "libaktualizr/secondaryinterface.h"
+#include "multicast.h"
 
 struct AKMetaCollection;
 typedef struct AKMetaCollection AKMetaCollection_t;
 
 namespace Uptane {
 
+// An aktualizr-secondary that uploads images to the Secondaries behind it,
+// shared by these Secondaries. It keeps track of the images uploaded to it.
+class IpRelay {
+ public:
+  IpRelay(std::string address, uint16_t port) : addr_{std::move(address), port} {}
+  IpRelay(const IpRelay&) = delete;
+  IpRelay& operator=(const IpRelay&) = delete;
+
+  const std::pair<std::string, uint16_t>& getAddr() const { return addr_; }
+  // Calls `upload` unless the image has been uploaded already. If another
+  // caller is uploading it, waits for that upload instead, and tries again
+  // if it fails.
+  data::InstallationResult uploadOnce(const std::string& hash,
+                                      const std::function<data::InstallationResult()>& upload);
+  // The relay no longer has the image, it is uploaded again next time.
+  void forget(const std::string& hash);
+
+ private:
+  const std::pair<std::string, uint16_t> addr_;
+  std::mutex m_;
+  std::condition_variable cv_;
+  // image hash => whether the upload has finished
+  std::map<std::string, bool> uploads_;
+};
+
 class IpUptaneSecondary : public SecondaryInterface {
  public:
   static SecondaryInterface::Ptr connectAndCreate(const std::string& address, unsigned short port);
@@ -23,6 +54,12 @@ class IpUptaneSecondary : public SecondaryInterface {
   EcuSerial getSerial() const override { return serial_; };
   Uptane::HardwareIdentifier getHwId() const override { return hw_id_; }
   PublicKey getPublicKey() const override { return pub_key_; }
+  // Images are sent to this multicast group if the Secondary supports it, and
+  // uploaded over TCP otherwise.
+  void setMulticast(multicast::Options options) { multicast_ = std::move(options); }
+  // Images are uploaded to this relay, which keeps them and uploads them to
+  // this Secondary.
+  void setRelay(std::shared_ptr<IpRelay> relay) { relay_ = std::move(relay); }
 
   void init(std::shared_ptr<SecondaryProvider> secondary_provider_in) override {
     secondary_provider_ = std::move(secondary_provider_in);
@@ -52,13 +89,26 @@ class IpUptaneSecondary : public SecondaryInterface {
   data::InstallationResult invokeInstallOnSecondary(const Uptane::Target& target);
   data::InstallationResult downloadOstreeRev(const Uptane::Target& target);
   data::InstallationResult uploadFirmware(const Uptane::Target& target);
-  data::InstallationResult uploadFirmwareData(const uint8_t* data, size_t size);
+  bool uploadMulticast(const Uptane::Target& target, data::InstallationResult* result);
+  bool uploadRelayed(const Uptane::Target& target, data::InstallationResult* result);
+  data::InstallationResult relayImage(const Uptane::Target& target, bool* cached);
+  data::InstallationResult uploadToRelay(const Uptane::Target& target);
+#ifdef BUILD_ZSTD
+  data::InstallationResult uploadCompressedFirmware(const Uptane::Target& target);
+#endif
+#ifdef BUILD_ZSTD_DELTA
+  bool uploadDelta(const Uptane::Target& target, data::InstallationResult* result);
+  data::InstallationResult uploadDeltaData(const std::string& base_hash, const uint8_t* data, size_t size);
+#endif
+  data::InstallationResult uploadFirmwareData(const uint8_t* data, size_t size, bool compressed = false);
 
   std::shared_ptr<SecondaryProvider> secondary_provider_;
   std::pair<std::string, uint16_t> addr_;
   const EcuSerial serial_;
   const HardwareIdentifier hw_id_;
   const PublicKey pub_key_;
+  multicast::Options multicast_;
+  std::shared_ptr<IpRelay> relay_;
   mutable uint32_t protocol_version{0};
 };
 
@@ -0,0 +1,368 @@
+#include "multicast.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+#include "logging/logging.h"
+
+namespace multicast {
+
+static constexpr uint32_t kMagic = 0x414b4d43;  // "AKMC"
+
+// magic, session, index of the block or of the group of a parity block, blocks
+using Header = std::array<uint32_t, 4>;
+static_assert(sizeof(Header) == kHeaderSize, "unexpected header size");
+
+static void putHeader(uint8_t *packet, uint32_t session, uint32_t index, uint32_t blocks) {
+  const Header header{htonl(kMagic), htonl(session), htonl(index), htonl(blocks)};
+  std::memcpy(packet, header.data(), kHeaderSize);
+}
+
+static Header getHeader(const uint8_t *packet) {
+  Header header{};
+  std::memcpy(header.data(), packet, kHeaderSize);
+  for (auto &field : header) {
+    field = ntohl(field);
+  }
+  return header;
+}
+
+static uint32_t newSession() {
+  std::random_device random;
+  // the ASN.1 INTEGER carrying it may only be 32 bits wide
+  return std::uniform_int_distribution<uint32_t>(1, INT32_MAX)(random);
+}
+
+static uint32_t blockCount(uint64_t size) {
+  const uint64_t blocks = (size + kBlockSize - 1) / kBlockSize;
+  if (blocks > UINT32_MAX) {
+    throw std::runtime_error("Image too large for multicast: " + std::to_string(size) + " bytes");
+  }
+  return static_cast<uint32_t>(blocks);
+}
+
+static in_addr parseGroup(const std::string &group) {
+  in_addr addr{};
+  if (inet_pton(AF_INET, group.c_str(), &addr) != 1 || !IN_MULTICAST(ntohl(addr.s_addr))) {
+    throw std::runtime_error("Not an IPv4 multicast address: " + group);
+  }
+  return addr;
+}
+
+static in_addr parseInterface(const std::string &interface) {
+  in_addr addr{};
+  if (inet_pton(AF_INET, interface.c_str(), &addr) != 1) {
+    throw std::runtime_error("Not the IPv4 address of an interface: " + interface);
+  }
+  return addr;
+}
+
+Encoder::Encoder(uint32_t session, const uint8_t *data, uint64_t size)
+    : session_{session}, data_{data}, size_{size}, blocks_{blockCount(size)} {}
+
+size_t Encoder::blockSize(uint32_t index) const {
+  return static_cast<size_t>(std::min<uint64_t>(kBlockSize, size_ - uint64_t{index} * kBlockSize));
+}
+
+size_t Encoder::block(uint32_t index, uint8_t *packet) const {
+  putHeader(packet, session_, index, blocks_);
+  const size_t size = blockSize(index);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  std::memcpy(packet + kHeaderSize, data_ + uint64_t{index} * kBlockSize, size);
+  return kHeaderSize + size;
+}
+
+size_t Encoder::parity(uint32_t group, uint8_t *packet) const {
+  putHeader(packet, session_, blocks_ + group, blocks_);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  uint8_t *payload = packet + kHeaderSize;
+  std::memset(payload, 0, kBlockSize);
+  const uint32_t end = std::min(blocks_, (group + 1) * kGroupBlocks);
+  for (uint32_t index = group * kGroupBlocks; index < end; ++index) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const uint8_t *block = data_ + uint64_t{index} * kBlockSize;
+    const size_t size = blockSize(index);
+    for (size_t i = 0; i < size; ++i) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      payload[i] ^= block[i];
+    }
+  }
+  return kHeaderSize + kBlockSize;
+}
+
+Decoder::Decoder(uint32_t session, uint8_t *data, uint64_t size)
+    : session_{session},
+      data_{data},
+      size_{size},
+      blocks_{blockCount(size)},
+      missing_{blocks_},
+      received_(blocks_, false),
+      group_missing_((blocks_ + kGroupBlocks - 1) / kGroupBlocks, kGroupBlocks) {
+  if (!group_missing_.empty() && blocks_ % kGroupBlocks != 0) {
+    group_missing_.back() = static_cast<uint8_t>(blocks_ % kGroupBlocks);
+  }
+}
+
+size_t Decoder::blockSize(uint32_t index) const {
+  return static_cast<size_t>(std::min<uint64_t>(kBlockSize, size_ - uint64_t{index} * kBlockSize));
+}
+
+bool Decoder::handle(const uint8_t *packet, size_t size) {
+  if (size < kHeaderSize) {
+    return false;
+  }
+  const Header header = getHeader(packet);
+  if (header[0] != kMagic || header[1] != session_ || header[3] != blocks_) {
+    return false;
+  }
+  const uint32_t index = header[2];
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  const uint8_t *payload = packet + kHeaderSize;
+  const size_t payload_size = size - kHeaderSize;
+
+  if (index < blocks_) {
+    if (payload_size != blockSize(index)) {
+      return false;
+    }
+    storeBlock(index, payload);
+    return true;
+  }
+  const uint32_t group = index - blocks_;
+  if (group >= group_missing_.size() || payload_size != kBlockSize) {
+    return false;
+  }
+  recoverBlock(group, payload);
+  return true;
+}
+
+void Decoder::storeBlock(uint32_t index, const uint8_t *payload) {
+  if (received_[index]) {
+    return;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  std::memcpy(data_ + uint64_t{index} * kBlockSize, payload, blockSize(index));
+  received_[index] = true;
+  --group_missing_[index / kGroupBlocks];
+  --missing_;
+}
+
+void Decoder::recoverBlock(uint32_t group, const uint8_t *parity) {
+  // the parity only helps if exactly one block of the group is missing
+  if (group_missing_[group] != 1) {
+    return;
+  }
+  std::array<uint8_t, kBlockSize> block{};
+  std::memcpy(block.data(), parity, kBlockSize);
+  uint32_t lost = 0;
+  const uint32_t end = std::min(blocks_, (group + 1) * kGroupBlocks);
+  for (uint32_t index = group * kGroupBlocks; index < end; ++index) {
+    if (!received_[index]) {
+      lost = index;
+      continue;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const uint8_t *other = data_ + uint64_t{index} * kBlockSize;
+    const size_t size = blockSize(index);
+    for (size_t i = 0; i < size; ++i) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      block[i] ^= other[i];
+    }
+  }
+  storeBlock(lost, block.data());
+}
+
+namespace {
+// A session handed out by Sender::session() and its Sender, once started.
+struct SenderEntry {
+  uint32_t session;
+  std::weak_ptr<Sender> sender;
+  bool started;
+};
+
+// by options and file
+std::mutex senders_mutex;
+std::map<std::string, SenderEntry> senders;
+
+std::string senderKey(const Options &options, const boost::filesystem::path &path) {
+  return options.group + ":" + std::to_string(options.port) + ":" + options.interface + ":" +
+         std::to_string(options.ttl) + ":" + std::to_string(options.bytes_per_second) + ":" + path.string();
+}
+}  // namespace
+
+uint32_t Sender::session(const Options &options, const boost::filesystem::path &path) {
+  std::lock_guard<std::mutex> guard(senders_mutex);
+  for (auto it = senders.begin(); it != senders.end();) {
+    it = it->second.started && it->second.sender.expired() ? senders.erase(it) : std::next(it);
+  }
+  auto entry = senders.find(senderKey(options, path));
+  if (entry == senders.end()) {
+    entry = senders.emplace(senderKey(options, path), SenderEntry{newSession(), {}, false}).first;
+  }
+  return entry->second.session;
+}
+
+std::shared_ptr<Sender> Sender::join(const Options &options, const boost::filesystem::path &path, uint32_t session) {
+  std::lock_guard<std::mutex> guard(senders_mutex);
+  auto entry = senders.find(senderKey(options, path));
+  if (entry == senders.end() || entry->second.session != session) {
+    // the session ended before this receiver was ready for it
+    return std::make_shared<Sender>(options, path, session);
+  }
+  auto sender = entry->second.sender.lock();
+  if (!sender) {
+    sender = std::make_shared<Sender>(options, path, session);
+    entry->second.sender = sender;
+    entry->second.started = true;
+  }
+  return sender;
+}
+
+Sender::Sender(const Options &options, const boost::filesystem::path &path, uint32_t session)
+    : image_{path},
+      session_{session},
+      encoder_{session_, image_.data(), image_.size()},
+      bytes_per_second_{options.bytes_per_second} {
+  if (image_.size() == 0) {
+    throw std::runtime_error("Empty images are not sent over multicast");
+  }
+  if (bytes_per_second_ == 0 || options.ttl < 1 || options.ttl > UINT8_MAX) {
+    throw std::runtime_error("Invalid multicast rate or TTL");
+  }
+  addr_.sin_family = AF_INET;
+  addr_.sin_port = htons(options.port);
+  addr_.sin_addr = parseGroup(options.group);
+  in_addr interface{};
+  if (!options.interface.empty()) {
+    interface = parseInterface(options.interface);
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("Unable to create a multicast socket: ") + std::strerror(errno));
+  }
+  const auto ttl = static_cast<unsigned char>(options.ttl);
+  if (setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+      (!options.interface.empty() && setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) != 0)) {
+    const int err = errno;
+    close(fd_);
+    throw std::runtime_error(std::string("Unable to set up a multicast socket: ") + std::strerror(err));
+  }
+
+  LOG_INFO << "Sending " << path << " to multicast group " << options.group << ":" << options.port << " at "
+           << bytes_per_second_ << " bytes/s in session " << session_;
+  thread_ = std::thread(&Sender::run, this);
+}
+
+Sender::~Sender() {
+  stop_ = true;
+  thread_.join();
+  close(fd_);
+}
+
+void Sender::run() {
+  std::array<uint8_t, kMaxPacketSize> packet{};
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t sent = 0;
+  uint64_t packets = 0;
+
+  auto send = [&](size_t size) {
+    if (sendto(fd_, packet.data(), size, 0, reinterpret_cast<const sockaddr *>(&addr_), sizeof(addr_)) < 0) {
+      // lost like any other datagram, the next round sends it again
+      LOG_RATE_LIMITED(warning, 1) << "Unable to send a multicast datagram: " << std::strerror(errno);
+    }
+    sent += size;
+    if (++packets % 16 == 0) {
+      std::this_thread::sleep_until(start + std::chrono::microseconds(sent * 1000000 / bytes_per_second_));
+    }
+  };
+
+  while (!stop_) {
+    for (uint32_t group = 0; group < encoder_.groups() && !stop_; ++group) {
+      const uint32_t end = std::min(encoder_.blocks(), (group + 1) * kGroupBlocks);
+      for (uint32_t index = group * kGroupBlocks; index < end; ++index) {
+        send(encoder_.block(index, packet.data()));
+      }
+      send(encoder_.parity(group, packet.data()));
+    }
+  }
+}
+
+Receiver::Receiver(const std::string &group, uint16_t port, uint32_t session, uint8_t *data, uint64_t size,
+                   std::chrono::milliseconds timeout)
+    : decoder_{session, data, size}, timeout_{timeout} {
+  const in_addr group_addr = parseGroup(group);
+
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("Unable to create a multicast socket: ") + std::strerror(errno));
+  }
+  const int reuse = 1;
+  // a large buffer rides out the time the receiving thread is not scheduled
+  const int rcvbuf = 4 * 1024 * 1024;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr = group_addr;
+  ip_mreq mreq{};
+  mreq.imr_multiaddr = group_addr;
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+    const int err = errno;
+    close(fd_);
+    throw std::runtime_error("Unable to join multicast group " + group + ": " + std::strerror(err));
+  }
+  static_cast<void>(setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)));
+
+  thread_ = std::thread(&Receiver::run, this);
+}
+
+Receiver::~Receiver() {
+  stop_ = true;
+  thread_.join();
+  close(fd_);
+}
+
+uint32_t Receiver::missing() const {
+  std::lock_guard<std::mutex> guard(m_);
+  return decoder_.missing();
+}
+
+void Receiver::run() {
+  std::array<uint8_t, kMaxPacketSize> packet{};
+  auto last_received = std::chrono::steady_clock::now();
+  while (!stop_ && missing() > 0) {
+    if (std::chrono::steady_clock::now() - last_received > timeout_) {
+      LOG_WARNING << "Nothing received over multicast for " << timeout_.count() << " ms; giving up with " << missing()
+                  << " blocks missing";
+      timed_out_ = true;
+      break;
+    }
+    pollfd pfd{fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    const ssize_t size = recv(fd_, packet.data(), packet.size(), 0);
+    if (size < 0) {
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(m_);
+    if (decoder_.handle(packet.data(), static_cast<size_t>(size))) {
+      last_received = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+}  // namespace multicast
@@ -0,0 +1,157 @@
+#ifndef UPTANE_MULTICAST_H_
+#define UPTANE_MULTICAST_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <boost/filesystem.hpp>
+
+#include "utilities/utils.h"
+
+/**
+ * Sending an image once to several Secondaries over UDP multicast.
+ *
+ * The Primary repeats the image in a carousel for as long as a Secondary is
+ * still receiving it, so a Secondary can join at any time and picks up the
+ * datagrams it lost on the next round. Every group of kGroupBlocks blocks is
+ * followed by their XOR, from which a single lost block of the group is
+ * recovered right away. Datagrams carry a random session number and those of
+ * other sessions are ignored. The received image is checked against the
+ * Target metadata on installation like one received over TCP.
+ */
+namespace multicast {
+
+constexpr size_t kBlockSize = 1024;
+constexpr uint32_t kGroupBlocks = 8;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kMaxPacketSize = kHeaderSize + kBlockSize;
+// A Receiver gives up after receiving nothing of its session for this long,
+// e.g. because the Primary stopped sending to it.
+constexpr std::chrono::milliseconds kReceiveTimeout{30000};
+
+// Builds the datagrams of an image.
+class Encoder {
+ public:
+  Encoder(uint32_t session, const uint8_t *data, uint64_t size);
+
+  uint32_t blocks() const { return blocks_; }
+  uint32_t groups() const { return (blocks_ + kGroupBlocks - 1) / kGroupBlocks; }
+  // Both write a datagram of at most kMaxPacketSize bytes to `packet` and
+  // return its size.
+  size_t block(uint32_t index, uint8_t *packet) const;
+  size_t parity(uint32_t group, uint8_t *packet) const;
+
+ private:
+  size_t blockSize(uint32_t index) const;
+
+  const uint32_t session_;
+  const uint8_t *data_;
+  const uint64_t size_;
+  const uint32_t blocks_;
+};
+
+// Puts an image together from datagrams received in any order.
+class Decoder {
+ public:
+  Decoder(uint32_t session, uint8_t *data, uint64_t size);
+
+  // Returns false if the datagram does not belong to the image.
+  bool handle(const uint8_t *packet, size_t size);
+  uint32_t missing() const { return missing_; }
+
+ private:
+  size_t blockSize(uint32_t index) const;
+  void storeBlock(uint32_t index, const uint8_t *payload);
+  void recoverBlock(uint32_t group, const uint8_t *parity);
+
+  const uint32_t session_;
+  uint8_t *data_;
+  const uint64_t size_;
+  const uint32_t blocks_;
+  uint32_t missing_;
+  std::vector<bool> received_;
+  std::vector<uint8_t> group_missing_;
+};
+
+// Where and how images are sent to a multicast group.
+struct Options {
+  std::string group;
+  uint16_t port{0};
+  // the links between ECUs are usually slower than the Primary's disk
+  uint64_t bytes_per_second{8 * 1024 * 1024};
+  // IPv4 address of the interface to send from; the routing table picks one
+  // if empty
+  std::string interface;
+  // 1 keeps the datagrams in the local network
+  int ttl{1};
+  // a Secondary that makes no progress for this long gets the image over TCP
+  std::chrono::milliseconds timeout{10000};
+};
+
+// Sends an image to a multicast group in a background thread.
+class Sender {
+ public:
+  // The session to announce to a receiver of the file. Receivers that are
+  // announced the file at about the same time share a session.
+  static uint32_t session(const Options &options, const boost::filesystem::path &path);
+  // Starts sending the file in a session from session(), or joins the Sender
+  // that already sends it. It stops when the last reference is dropped.
+  static std::shared_ptr<Sender> join(const Options &options, const boost::filesystem::path &path, uint32_t session);
+
+  Sender(const Options &options, const boost::filesystem::path &path, uint32_t session);
+  ~Sender();
+  Sender(const Sender &) = delete;
+  Sender &operator=(const Sender &) = delete;
+
+  uint32_t session() const { return session_; }
+
+ private:
+  void run();
+
+  const MappedFile image_;
+  const uint32_t session_;
+  const Encoder encoder_;
+  const uint64_t bytes_per_second_;
+  int fd_{-1};
+  sockaddr_in addr_{};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+// Receives an image from a multicast group in a background thread, until it
+// is complete or nothing has been received for `timeout`.
+class Receiver {
+ public:
+  Receiver(const std::string &group, uint16_t port, uint32_t session, uint8_t *data, uint64_t size,
+           std::chrono::milliseconds timeout = kReceiveTimeout);
+  ~Receiver();
+  Receiver(const Receiver &) = delete;
+  Receiver &operator=(const Receiver &) = delete;
+
+  uint32_t missing() const;
+  // Whether it gave up before the image was complete.
+  bool timedOut() const { return timed_out_; }
+
+ private:
+  void run();
+
+  mutable std::mutex m_;
+  Decoder decoder_;
+  const std::chrono::milliseconds timeout_;
+  int fd_{-1};
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> timed_out_{false};
+  std::thread thread_;
+};
+
+}  // namespace multicast
+
+#endif  // UPTANE_MULTICAST_H_
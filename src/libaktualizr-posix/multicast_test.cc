@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "multicast.h"
+
+static std::vector<uint8_t> testImage(size_t size) {
+  std::vector<uint8_t> image(size);
+  for (size_t i = 0; i < size; ++i) {
+    image[i] = static_cast<uint8_t>(i * 7 + i / 1000);
+  }
+  return image;
+}
+
+/*
+ * Sends one carousel round, dropping the datagrams for which `drop` returns
+ * true. Returns the number of datagrams sent.
+ */
+template <typename Drop>
+static uint32_t sendRound(const multicast::Encoder &encoder, multicast::Decoder &decoder, Drop drop) {
+  std::array<uint8_t, multicast::kMaxPacketSize> packet{};
+  uint32_t sent = 0;
+  for (uint32_t group = 0; group < encoder.groups(); ++group) {
+    const uint32_t end = std::min(encoder.blocks(), (group + 1) * multicast::kGroupBlocks);
+    for (uint32_t index = group * multicast::kGroupBlocks; index < end; ++index) {
+      const size_t size = encoder.block(index, packet.data());
+      if (!drop(sent++)) {
+        EXPECT_TRUE(decoder.handle(packet.data(), size));
+      }
+    }
+    const size_t size = encoder.parity(group, packet.data());
+    if (!drop(sent++)) {
+      EXPECT_TRUE(decoder.handle(packet.data(), size));
+    }
+  }
+  return sent;
+}
+
+/*
+ * Put an image together from one round without losses.
+ */
+TEST(Multicast, NoLoss) {
+  const auto image = testImage(100 * multicast::kBlockSize + 17);
+  std::vector<uint8_t> received(image.size());
+  multicast::Encoder encoder(42, image.data(), image.size());
+  multicast::Decoder decoder(42, received.data(), received.size());
+  EXPECT_EQ(encoder.blocks(), 101U);
+  EXPECT_EQ(decoder.missing(), 101U);
+
+  sendRound(encoder, decoder, [](uint32_t) { return false; });
+  EXPECT_EQ(decoder.missing(), 0U);
+  EXPECT_EQ(received, image);
+}
+
+/*
+ * Recover a single lost block per group from the parity right away, including
+ * the short last block, and the others from the next round.
+ */
+TEST(Multicast, Loss) {
+  const auto image = testImage(100 * multicast::kBlockSize + 17);
+  std::vector<uint8_t> received(image.size());
+  multicast::Encoder encoder(42, image.data(), image.size());
+
+  {
+    multicast::Decoder decoder(42, received.data(), received.size());
+    // datagrams 0-8 are the first group and its parity, 108 is the last block
+    sendRound(encoder, decoder, [](uint32_t i) { return i == 3 || i == 108; });
+    EXPECT_EQ(decoder.missing(), 0U);
+    EXPECT_EQ(received, image);
+  }
+
+  received.assign(received.size(), 0);
+  {
+    multicast::Decoder decoder(42, received.data(), received.size());
+    // two blocks of a group, and a block and the parity of another
+    sendRound(encoder, decoder, [](uint32_t i) { return i == 3 || i == 4 || i == 10 || i == 17; });
+    EXPECT_EQ(decoder.missing(), 3U);
+    sendRound(encoder, decoder, [](uint32_t i) { return i % 2 == 1; });
+    EXPECT_EQ(decoder.missing(), 0U);
+    EXPECT_EQ(received, image);
+  }
+}
+
+/*
+ * Ignore datagrams of other sessions and malformed ones.
+ */
+TEST(Multicast, ForeignDatagrams) {
+  const auto image = testImage(11 * multicast::kBlockSize);
+  std::vector<uint8_t> received(10 * multicast::kBlockSize);
+  multicast::Encoder other_session(7, image.data(), received.size());
+  multicast::Encoder other_image(42, image.data(), image.size());
+  multicast::Decoder decoder(42, received.data(), received.size());
+
+  std::array<uint8_t, multicast::kMaxPacketSize> packet{};
+  EXPECT_FALSE(decoder.handle(packet.data(), other_session.block(0, packet.data())));
+  EXPECT_FALSE(decoder.handle(packet.data(), other_image.block(0, packet.data())));
+  EXPECT_FALSE(decoder.handle(packet.data(), multicast::kHeaderSize - 1));
+  multicast::Encoder encoder(42, image.data(), received.size());
+  EXPECT_FALSE(decoder.handle(packet.data(), encoder.block(0, packet.data()) - 1));
+  EXPECT_EQ(decoder.missing(), 10U);
+}
+
+/*
+ * Refuse options that datagrams cannot be sent with.
+ */
+TEST(Multicast, InvalidOptions) {
+  TemporaryDirectory temp_dir;
+  const auto image = testImage(10 * multicast::kBlockSize);
+  Utils::writeFile(temp_dir / "image", std::string(image.begin(), image.end()));
+
+  multicast::Options options;
+  options.group = "239.255.0.1";
+  options.port = 9060;
+  options.bytes_per_second = 0;
+  EXPECT_THROW(multicast::Sender(options, temp_dir / "image", 1), std::runtime_error);
+  options.bytes_per_second = 1024;
+  options.ttl = 256;
+  EXPECT_THROW(multicast::Sender(options, temp_dir / "image", 1), std::runtime_error);
+  options.ttl = 1;
+  options.interface = "eth0";
+  EXPECT_THROW(multicast::Sender(options, temp_dir / "image", 1), std::runtime_error);
+  options.interface.clear();
+  options.group = "192.168.1.1";
+  EXPECT_THROW(multicast::Sender(options, temp_dir / "image", 1), std::runtime_error);
+}
+
+/*
+ * Stop receiving once nothing has arrived for the timeout.
+ */
+TEST(Multicast, ReceiveTimeout) {
+  std::vector<uint8_t> received(10 * multicast::kBlockSize);
+  std::unique_ptr<multicast::Receiver> receiver;
+  try {
+    receiver = std_::make_unique<multicast::Receiver>("239.255.0.1", 9060, 42, received.data(), received.size(),
+                                                      std::chrono::milliseconds(200));
+  } catch (const std::runtime_error &e) {
+    // hosts without a multicast route cannot join the group
+    std::cerr << "Not testing the receive timeout: " << e.what() << std::endl;
+    return;
+  }
+  EXPECT_FALSE(receiver->timedOut());
+  for (int i = 0; i < 50 && !receiver->timedOut(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_TRUE(receiver->timedOut());
+  EXPECT_EQ(receiver->missing(), 10U);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
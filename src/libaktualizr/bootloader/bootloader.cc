@@ -5,6 +5,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <boost/filesystem.hpp>
 
 #include "storage/invstorage.h"
@@ -24,23 +30,60 @@ Bootloader::Bootloader(BootloaderConfig config, INvStorage& storage) : config_(s
   reboot_detect_supported_ = true;
 }
 
+using UbootEnv = std::vector<std::pair<std::string, std::string>>;
+
+// Applies all the changes with a single fw_setenv call, so that the (redundant)
+// environment on flash is written once and is never left half-updated.
+// Variables that already have the requested value are skipped, and nothing is
+// written if none changed.
+static void setUbootEnv(const UbootEnv& vars) {
+  std::vector<std::string> printenv_argv{"fw_printenv"};
+  for (const auto& var : vars) {
+    printenv_argv.push_back(var.first);
+  }
+  // Unset variables make fw_printenv fail and print an error instead of
+  // name=value; the variables that are set are still printed.
+  std::string printenv_output;
+  Utils::execute(printenv_argv, &printenv_output, true);
+  std::map<std::string, std::string> current;
+  std::istringstream printenv_stream(printenv_output);
+  std::string line;
+  while (std::getline(printenv_stream, line)) {
+    const auto separator = line.find('=');
+    if (separator != std::string::npos) {
+      current[line.substr(0, separator)] = line.substr(separator + 1);
+    }
+  }
+
+  std::string script;
+  for (const auto& var : vars) {
+    const auto it = current.find(var.first);
+    if (it == current.end() || it->second != var.second) {
+      script += var.first + " " + var.second + "\n";
+    }
+  }
+  if (script.empty()) {
+    LOG_DEBUG << "U-Boot environment already up to date";
+    return;
+  }
+
+  TemporaryFile script_file("fw_setenv-script");
+  script_file.PutContents(script);
+  std::string output;
+  if (Utils::execute({"fw_setenv", "--script", script_file.PathString()}, &output, true) != 0) {
+    LOG_WARNING << "Failed updating the U-Boot environment with:\n" << script << output;
+  }
+}
+
 void Bootloader::setBootOK() const {
-  std::string sink;
   switch (config_.rollback_mode) {
     case RollbackMode::kBootloaderNone:
       break;
     case RollbackMode::kUbootGeneric:
-      if (Utils::shell("fw_setenv bootcount 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting bootcount";
-      }
+      setUbootEnv({{"bootcount", "0"}});
       break;
     case RollbackMode::kUbootMasked:
-      if (Utils::shell("fw_setenv bootcount 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting bootcount";
-      }
-      if (Utils::shell("fw_setenv upgrade_available 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting upgrade_available for u-boot";
-      }
+      setUbootEnv({{"bootcount", "0"}, {"upgrade_available", "0"}});
       break;
     default:
       throw NotImplementedException();
@@ -48,28 +91,14 @@ void Bootloader::setBootOK() const {
 }
 
 void Bootloader::updateNotify() const {
-  std::string sink;
   switch (config_.rollback_mode) {
     case RollbackMode::kBootloaderNone:
       break;
     case RollbackMode::kUbootGeneric:
-      if (Utils::shell("fw_setenv bootcount 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting bootcount";
-      }
-      if (Utils::shell("fw_setenv rollback 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting rollback flag";
-      }
+      setUbootEnv({{"bootcount", "0"}, {"rollback", "0"}});
       break;
     case RollbackMode::kUbootMasked:
-      if (Utils::shell("fw_setenv bootcount 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting bootcount";
-      }
-      if (Utils::shell("fw_setenv upgrade_available 1", &sink) != 0) {
-        LOG_WARNING << "Failed setting upgrade_available for u-boot";
-      }
-      if (Utils::shell("fw_setenv rollback 0", &sink) != 0) {
-        LOG_WARNING << "Failed resetting rollback flag";
-      }
+      setUbootEnv({{"bootcount", "0"}, {"upgrade_available", "1"}, {"rollback", "0"}});
       break;
     default:
       throw NotImplementedException();
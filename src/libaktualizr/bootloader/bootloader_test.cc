@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <cstdlib>
+
 #include "bootloader.h"
 #include "storage/invstorage.h"
+#include "utilities/utils.h"
 
 /* Check that the reboot detection feature works */
 TEST(bootloader, detectReboot) {
@@ -35,6 +38,83 @@ TEST(bootloader, detectReboot) {
   ASSERT_FALSE(bootloader.rebootDetected());
 }
 
+/* Fake fw_printenv and fw_setenv, working on a plain text environment file and
+ * logging the scripts passed to fw_setenv. */
+class FakeUbootEnv {
+ public:
+  FakeUbootEnv() : old_path_(getenv("PATH")) {
+    Utils::writeFile(dir_ / "env", std::string("bootcount=3\nupgrade_available=0\n"));
+    Utils::writeFile(dir_ / "fw_printenv", std::string(R"(#!/bin/sh
+env="$(dirname "$0")/env"
+rc=0
+for name in "$@"; do
+  grep "^$name=" "$env" || { echo "## Error: \"$name\" not defined" >&2; rc=1; }
+done
+exit $rc
+)"));
+    Utils::writeFile(dir_ / "fw_setenv", std::string(R"(#!/bin/sh
+env="$(dirname "$0")/env"
+[ "$1" = --script ] || exit 1
+echo call >> "$(dirname "$0")/log"
+cat "$2" >> "$(dirname "$0")/log"
+while read -r name value; do
+  sed -i "/^$name=/d" "$env"
+  echo "$name=$value" >> "$env"
+done < "$2"
+)"));
+    boost::filesystem::permissions(dir_ / "fw_printenv", boost::filesystem::owner_all);
+    boost::filesystem::permissions(dir_ / "fw_setenv", boost::filesystem::owner_all);
+    setenv("PATH", (dir_.PathString() + ":" + old_path_).c_str(), 1);
+  }
+  ~FakeUbootEnv() { setenv("PATH", old_path_.c_str(), 1); }
+
+  boost::filesystem::path env() const { return dir_ / "env"; }
+  boost::filesystem::path log() const { return dir_ / "log"; }
+  std::string takeLog() const {
+    if (!boost::filesystem::exists(log())) {
+      return "";
+    }
+    std::string contents = Utils::readFile(log());
+    boost::filesystem::remove(log());
+    return contents;
+  }
+
+ private:
+  TemporaryDirectory dir_;
+  std::string old_path_;
+};
+
+/* Apply the U-Boot environment changes in a single fw_setenv call and skip
+ * variables that already have the right value. */
+TEST(bootloader, batchedUbootEnv) {
+  FakeUbootEnv fake_env;
+  TemporaryDirectory temp_dir;
+  StorageConfig storage_config;
+  storage_config.path = temp_dir.Path();
+  std::shared_ptr<INvStorage> storage = INvStorage::newStorage(storage_config);
+
+  BootloaderConfig boot_config;
+  boot_config.rollback_mode = RollbackMode::kUbootMasked;
+  boot_config.reboot_sentinel_dir = temp_dir.Path();
+  Bootloader bootloader(boot_config, *storage);
+
+  // rollback is not set yet
+  bootloader.updateNotify();
+  EXPECT_EQ(fake_env.takeLog(), "call\nbootcount 0\nupgrade_available 1\nrollback 0\n");
+
+  // U-Boot counts the boot
+  Utils::writeFile(fake_env.env(), std::string("bootcount=1\nupgrade_available=1\nrollback=0\n"));
+  bootloader.setBootOK();
+  EXPECT_EQ(fake_env.takeLog(), "call\nbootcount 0\nupgrade_available 0\n");
+
+  // nothing to change
+  bootloader.setBootOK();
+  EXPECT_EQ(fake_env.takeLog(), "");
+
+  bootloader.updateNotify();
+  EXPECT_EQ(fake_env.takeLog(), "call\nupgrade_available 1\n");
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
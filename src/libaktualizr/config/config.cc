@@ -95,6 +95,9 @@ void UptaneConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt)
   CopyFromConfig(force_install_completion, "force_install_completion", pt);
   CopyFromConfig(secondary_config_file, "secondary_config_file", pt);
   CopyFromConfig(secondary_preinstall_wait_sec, "secondary_preinstall_wait_sec", pt);
+  CopyFromConfig(secondary_metadata_concurrency, "secondary_metadata_concurrency", pt);
+  CopyFromConfig(secondary_install_concurrency, "secondary_install_concurrency", pt);
+  CopyFromConfig(secondary_segment_concurrency, "secondary_segment_concurrency", pt);
 }
 
 void UptaneConfig::writeToStream(std::ostream& out_stream) const {
@@ -106,6 +109,9 @@ void UptaneConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, force_install_completion, "force_install_completion");
   writeOption(out_stream, secondary_config_file, "secondary_config_file");
   writeOption(out_stream, secondary_preinstall_wait_sec, "secondary_preinstall_wait_sec");
+  writeOption(out_stream, secondary_metadata_concurrency, "secondary_metadata_concurrency");
+  writeOption(out_stream, secondary_install_concurrency, "secondary_install_concurrency");
+  writeOption(out_stream, secondary_segment_concurrency, "secondary_segment_concurrency");
 }
 
 /**
@@ -218,8 +224,11 @@ void Config::updateFromTomlString(const std::string& contents) {
 
 void Config::updateFromPropertyTree(const boost::property_tree::ptree& pt) {
   // Keep this order the same as in config.h and Config::writeToStream().
-  if (!loglevel_from_cmdline) {
-    CopySubtreeFromConfig(logger, "logger", pt);
+  const int cmdline_loglevel = logger.loglevel;
+  CopySubtreeFromConfig(logger, "logger", pt);
+  if (loglevel_from_cmdline) {
+    logger.loglevel = cmdline_loglevel;
+  } else {
     // If not already set from the commandline, set the loglevel now so that it
     // affects the rest of the config processing.
     logger_set_threshold(logger);
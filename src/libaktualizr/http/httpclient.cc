@@ -3,6 +3,7 @@
 #include <cassert>
 #include <sstream>
 
+#include "telemetry/metrics.h"
 #include "utilities/aktualizr_version.h"
 #include "utilities/utils.h"
 
@@ -176,6 +177,21 @@ HttpResponse HttpClient::put(const std::string& url, const Json::Value& data) {
   return put(url, "application/json", data_str);
 }
 
+static void recordMetrics(CURL* curl_handler, long http_code, CURLcode result) {  // NOLINT(google-runtime-int)
+  metrics::Registry& registry = metrics::Registry::get();
+  if (!registry.enabled()) {
+    return;
+  }
+  char* url = nullptr;
+  double total_time = 0;
+  curl_easy_getinfo(curl_handler, CURLINFO_EFFECTIVE_URL, &url);
+  curl_easy_getinfo(curl_handler, CURLINFO_TOTAL_TIME, &total_time);
+  const std::string endpoint = metrics::httpEndpoint((url != nullptr) ? url : "");
+  const std::string status = (result == CURLE_OK) ? std::to_string(http_code) : "error";
+  registry.increment("aktualizr_http_requests_total", {{"endpoint", endpoint}, {"status", status}});
+  registry.observe("aktualizr_http_request_duration_seconds", {{"endpoint", endpoint}}, total_time);
+}
+
 HttpResponse HttpClient::perform(CURL* curl_handler, int retry_times, int64_t size_limit) {
   if (size_limit >= 0) {
     // it will only take effect if the server declares the size in advance,
@@ -191,6 +207,7 @@ HttpResponse HttpClient::perform(CURL* curl_handler, int retry_times, int64_t si
   CURLcode result = curl_easy_perform(curl_handler);
   long http_code;  // NOLINT(google-runtime-int)
   curl_easy_getinfo(curl_handler, CURLINFO_RESPONSE_CODE, &http_code);
+  recordMetrics(curl_handler, http_code, result);
   HttpResponse response(response_arg.out, http_code, result, (result != CURLE_OK) ? curl_easy_strerror(result) : "");
   if (response.curl_code != CURLE_OK || response.http_status_code >= 500) {
     std::ostringstream error_message;
@@ -246,6 +263,7 @@ std::future<HttpResponse> HttpClient::downloadAsync(const std::string& url, curl
         CURLcode result = curl_easy_perform(curlp.get());
         long http_code;  // NOLINT(google-runtime-int)
         curl_easy_getinfo(curlp.get(), CURLINFO_RESPONSE_CODE, &http_code);
+        recordMetrics(curlp.get(), http_code, result);
         HttpResponse response("", http_code, result, (result != CURLE_OK) ? curl_easy_strerror(result) : "");
         promise.set_value(response);
       },
@@ -1,8 +1,32 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <string>
 
+#include <boost/core/null_deleter.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/drop_on_overflow.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/log/trivial.hpp>
-#include <boost/log/utility/setup/console.hpp>
+#include <boost/make_shared.hpp>
+
+#include "libaktualizr/config.h"
+#include "logging.h"
+
+namespace sinks = boost::log::sinks;
+
+using TextBackend = sinks::text_ostream_backend;
+using SyncSink = sinks::synchronous_sink<TextBackend>;
+// Messages are dropped rather than blocking the logging thread when the queue
+// is full.
+using AsyncSink = sinks::asynchronous_sink<TextBackend, sinks::bounded_fifo_queue<4096, sinks::drop_on_overflow>>;
 
 static void color_fmt(boost::log::record_view const& rec, boost::log::formatting_ostream& strm) {
   auto severity = rec[boost::log::trivial::severity];
@@ -29,14 +53,77 @@ static void color_fmt(boost::log::record_view const& rec, boost::log::formatting
   }
 }
 
+static void plain_fmt(boost::log::record_view const& rec, boost::log::formatting_ostream& strm) {
+  strm << rec[boost::log::expressions::smessage];
+}
+
+static std::mutex sink_mutex;
+static boost::shared_ptr<sinks::sink> current_sink;
+static boost::shared_ptr<AsyncSink> current_async_sink;
+static bool colors_enabled = false;
+
+// Logs to the console if `config` has no log file or the file cannot be
+// opened, in which case `file_error` is set.
+template <typename Sink>
+static boost::shared_ptr<Sink> makeSink(const LoggerConfig* config, std::string* file_error) {
+  auto backend = boost::make_shared<TextBackend>();
+  bool to_file = false;
+  if (config != nullptr && !config->file.empty()) {
+    auto file = boost::make_shared<std::ofstream>(config->file.string(), std::ios::out | std::ios::app);
+    if (file->is_open()) {
+      backend->add_stream(file);
+      to_file = true;
+    } else if (file_error != nullptr) {
+      *file_error = std::strerror(errno);
+    }
+  }
+  if (!to_file) {
+    std::ostream* stream = (getenv("LOG_STDERR") == nullptr) ? &std::cout : &std::cerr;
+    backend->add_stream(boost::shared_ptr<std::ostream>(stream, boost::null_deleter()));
+  }
+  backend->auto_flush(true);
+
+  auto sink = boost::make_shared<Sink>(backend);
+  sink->set_formatter(colors_enabled && !to_file ? &color_fmt : &plain_fmt);
+  return sink;
+}
+
+static void replaceSink(const boost::shared_ptr<sinks::sink>& sink, const boost::shared_ptr<AsyncSink>& async_sink) {
+  auto core = boost::log::core::get();
+  if (current_sink) {
+    core->remove_sink(current_sink);
+  }
+  if (current_async_sink) {
+    current_async_sink->stop();
+    current_async_sink->flush();
+  }
+  core->add_sink(sink);
+  current_sink = sink;
+  current_async_sink = async_sink;
+}
+
 void logger_init_sink(bool use_colors = false) {
-  auto* stream = &std::cerr;
-  if (getenv("LOG_STDERR") == nullptr) {
-    stream = &std::cout;
+  std::lock_guard<std::mutex> guard(sink_mutex);
+  colors_enabled = use_colors;
+  replaceSink(makeSink<SyncSink>(nullptr, nullptr), nullptr);
+}
+
+void logger_configure_sink(const LoggerConfig& lconfig) {
+  std::string file_error;
+  {
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    if (lconfig.async) {
+      static std::once_flag atexit_registered;
+      std::call_once(atexit_registered, []() { std::atexit(logger_flush); });
+      auto sink = makeSink<AsyncSink>(&lconfig, &file_error);
+      replaceSink(sink, sink);
+    } else {
+      replaceSink(makeSink<SyncSink>(&lconfig, &file_error), nullptr);
+    }
   }
-  auto sink = boost::log::add_console_log(*stream, boost::log::keywords::format = "%Message%",
-                                          boost::log::keywords::auto_flush = true);
-  if (use_colors) {
-    sink->set_formatter(&color_fmt);
+  if (!file_error.empty()) {
+    LOG_ERROR << "Unable to open the log file " << lconfig.file << ": " << file_error << "; logging to the console";
   }
 }
+
+void logger_flush() { boost::log::core::get()->flush(); }
@@ -1,25 +1,25 @@
 #include "logging.h"
+
+#include <chrono>
+
 #include "libaktualizr/config.h"
 
 using boost::log::trivial::severity_level;
 
-static severity_level gLoggingThreshold;
+std::atomic<int> gLoggingThreshold{boost::log::trivial::trace};
 
 extern void logger_init_sink(bool use_colors = false);
 
 int64_t get_curlopt_verbose() { return gLoggingThreshold <= boost::log::trivial::trace ? 1L : 0L; }
 
 void logger_init(bool use_colors) {
-  gLoggingThreshold = boost::log::trivial::info;
-
   logger_init_sink(use_colors);
-
-  boost::log::core::get()->set_filter(boost::log::trivial::severity >= gLoggingThreshold);
+  logger_set_threshold(boost::log::trivial::info);
 }
 
 void logger_set_threshold(const severity_level threshold) {
   gLoggingThreshold = threshold;
-  boost::log::core::get()->set_filter(boost::log::trivial::severity >= gLoggingThreshold);
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >= threshold);
 }
 
 void logger_set_threshold(const LoggerConfig& lconfig) {
@@ -37,6 +37,16 @@ void logger_set_threshold(const LoggerConfig& lconfig) {
 
 void logger_set_enable(bool enabled) { boost::log::core::get()->set_logging_enabled(enabled); }
 
-int loggerGetSeverity() { return static_cast<int>(gLoggingThreshold); }
+int loggerGetSeverity() { return gLoggingThreshold; }
+
+bool LogRateLimiter::allow() {
+  const int64_t now =
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  int64_t window = window_.load(std::memory_order_relaxed);
+  if (window != now && window_.compare_exchange_strong(window, now)) {
+    count_ = 0;
+  }
+  return ++count_ <= per_second_;
+}
 
 // vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -1,30 +1,69 @@
 #ifndef SOTA_CLIENT_TOOLS_LOGGING_H_
 #define SOTA_CLIENT_TOOLS_LOGGING_H_
 
+#include <atomic>
+#include <cstdint>
+
 #include <boost/log/core.hpp>
 #include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
 
 struct LoggerConfig;
 
+/* The severity is checked against the threshold before Boost.Log is involved
+ * at all, so that a filtered message costs one relaxed atomic load: neither a
+ * log record is opened nor its arguments are evaluated. */
+extern std::atomic<int> gLoggingThreshold;
+
+#define LOG_SEVERITY_ENABLED(lvl) \
+  (static_cast<int>(boost::log::trivial::lvl) >= gLoggingThreshold.load(std::memory_order_relaxed))
+
+#define LOG_WITH_SEVERITY(lvl)     \
+  if (!LOG_SEVERITY_ENABLED(lvl)) { \
+  } else                           \
+    BOOST_LOG_TRIVIAL(lvl)
+
 /** Log an unrecoverable error */
-#define LOG_FATAL BOOST_LOG_TRIVIAL(fatal)
+#define LOG_FATAL LOG_WITH_SEVERITY(fatal)
 
 /** Log that something has definitely gone wrong */
-#define LOG_ERROR BOOST_LOG_TRIVIAL(error)
+#define LOG_ERROR LOG_WITH_SEVERITY(error)
 
 /** Warn about behaviour that is probably bad, but hasn't yet caused the system
  * to operate out of spec. */
-#define LOG_WARNING BOOST_LOG_TRIVIAL(warning)
+#define LOG_WARNING LOG_WITH_SEVERITY(warning)
 
 /** Report a user-visible message about operation */
-#define LOG_INFO BOOST_LOG_TRIVIAL(info)
+#define LOG_INFO LOG_WITH_SEVERITY(info)
 
 /** Report a message for developer debugging */
-#define LOG_DEBUG BOOST_LOG_TRIVIAL(debug)
+#define LOG_DEBUG LOG_WITH_SEVERITY(debug)
 
 /** Report very-verbose debugging information */
-#define LOG_TRACE BOOST_LOG_TRIVIAL(trace)
+#define LOG_TRACE LOG_WITH_SEVERITY(trace)
+
+/** Allows at most `per_second` messages per second from one call site. */
+class LogRateLimiter {
+ public:
+  explicit LogRateLimiter(uint32_t per_second) : per_second_(per_second) {}
+  bool allow();
+
+ private:
+  const uint32_t per_second_;
+  std::atomic<int64_t> window_{0};
+  std::atomic<uint32_t> count_{0};
+};
+
+/** Log from a hot path, e.g. once per received chunk, at most `per_second`
+ * times per second; the other messages are dropped. Use like:
+ * LOG_RATE_LIMITED(trace, 10) << "Received " << size << " bytes"; */
+#define LOG_RATE_LIMITED(lvl, per_second)                                               \
+  if (!LOG_SEVERITY_ENABLED(lvl) || !([]() -> bool {                                    \
+        static LogRateLimiter limiter(per_second);                                      \
+        return limiter.allow();                                                         \
+      })()) {                                                                           \
+  } else                                                                                \
+    BOOST_LOG_TRIVIAL(lvl)
 
 // Use like:
 // curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, get_curlopt_verbose());
@@ -40,4 +79,11 @@ void logger_set_enable(bool enabled);
 
 int loggerGetSeverity();
 
+// Switches to the sink described by the configuration: the console or a file,
+// written synchronously or from a background thread.
+void logger_configure_sink(const LoggerConfig& lconfig);
+
+// Writes out the messages still queued in an asynchronous sink.
+void logger_flush();
+
 #endif
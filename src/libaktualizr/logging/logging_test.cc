@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "libaktualizr/config.h"
+#include "logging/logging.h"
+#include "utilities/utils.h"
+
+static int evaluated = 0;
+
+static std::string countEvaluation() {
+  ++evaluated;
+  return "evaluated";
+}
+
+/*
+ * Do not evaluate the arguments of filtered messages.
+ */
+TEST(Logging, FilteredArgumentsNotEvaluated) {
+  logger_set_threshold(boost::log::trivial::info);
+  evaluated = 0;
+  LOG_DEBUG << countEvaluation();
+  EXPECT_EQ(evaluated, 0);
+  LOG_INFO << countEvaluation();
+  EXPECT_EQ(evaluated, 1);
+}
+
+/*
+ * Let through at most the given number of messages per second from a call
+ * site, independently of other call sites.
+ */
+TEST(Logging, RateLimited) {
+  logger_set_threshold(boost::log::trivial::info);
+  evaluated = 0;
+  for (int i = 0; i < 100; ++i) {
+    LOG_RATE_LIMITED(info, 5) << countEvaluation();
+  }
+  // the window may have rolled over once during the loop
+  EXPECT_GE(evaluated, 5);
+  EXPECT_LE(evaluated, 10);
+
+  evaluated = 0;
+  LOG_RATE_LIMITED(info, 5) << countEvaluation();
+  EXPECT_EQ(evaluated, 1);
+
+  // filtered messages do not use up the budget
+  evaluated = 0;
+  for (int i = 0; i < 100; ++i) {
+    LOG_RATE_LIMITED(debug, 5) << countEvaluation();
+  }
+  EXPECT_EQ(evaluated, 0);
+}
+
+/*
+ * Write to a file from a background thread.
+ */
+TEST(Logging, AsyncFileSink) {
+  TemporaryDirectory temp_dir;
+  LoggerConfig config;
+  config.async = true;
+  config.file = temp_dir / "aktualizr.log";
+  logger_configure_sink(config);
+  logger_set_threshold(boost::log::trivial::info);
+
+  for (int i = 0; i < 100; ++i) {
+    LOG_INFO << "message " << i;
+  }
+  logger_flush();
+
+  const std::string log = Utils::readFile(config.file);
+  EXPECT_NE(log.find("message 0\n"), std::string::npos);
+  EXPECT_NE(log.find("message 99\n"), std::string::npos);
+
+  logger_configure_sink(LoggerConfig());
+}
+
+/*
+ * Log to the console if the log file cannot be opened.
+ */
+TEST(Logging, FileSinkFallback) {
+  TemporaryDirectory temp_dir;
+  LoggerConfig config;
+  config.file = temp_dir / "missing" / "aktualizr.log";
+  logger_set_threshold(boost::log::trivial::info);
+
+  testing::internal::CaptureStdout();
+  logger_configure_sink(config);
+  LOG_INFO << "still logged";
+  logger_flush();
+  const std::string output = testing::internal::GetCapturedStdout();
+
+  EXPECT_NE(output.find("Unable to open the log file"), std::string::npos);
+  EXPECT_NE(output.find("still logged\n"), std::string::npos);
+  EXPECT_FALSE(boost::filesystem::exists(config.file));
+
+  logger_configure_sink(LoggerConfig());
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  logger_init();
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -202,6 +202,11 @@ data::InstallationResult OstreeManager::install(const Uptane::Target &target) co
     return install_res;
   }
 
+  {
+    std::lock_guard<std::mutex> guard(sysroot_mutex_);
+    sysroot_.reset();
+  }
+
   // set reboot flag to be notified later
   if (bootloader_ != nullptr) {
     bootloader_->rebootFlagSet();
@@ -244,7 +249,7 @@ void OstreeManager::updateNotify() { bootloader_->updateNotify(); }
 OstreeManager::OstreeManager(const PackageConfig &pconfig, const BootloaderConfig &bconfig,
                              const std::shared_ptr<INvStorage> &storage, const std::shared_ptr<HttpInterface> &http)
     : PackageManagerInterface(pconfig, bconfig, storage, http), bootloader_{new Bootloader(bconfig, *storage)} {
-  GObjectUniquePtr<OstreeSysroot> sysroot_smart = OstreeManager::LoadSysroot(config.sysroot);
+  GObjectUniquePtr<OstreeSysroot> sysroot_smart = getSysroot();
   if (sysroot_smart == nullptr) {
     throw std::runtime_error("Could not find OSTree sysroot at: " + config.sysroot.string());
   }
@@ -330,7 +335,7 @@ Json::Value OstreeManager::getInstalledPackages() const {
 }
 
 std::string OstreeManager::getCurrentHash() const {
-  GObjectUniquePtr<OstreeSysroot> sysroot_smart = OstreeManager::LoadSysroot(config.sysroot);
+  GObjectUniquePtr<OstreeSysroot> sysroot_smart = getSysroot();
   OstreeDeployment *booted_deployment = ostree_sysroot_get_booted_deployment(sysroot_smart.get());
   if (booted_deployment == nullptr) {
     throw std::runtime_error("Could not get booted deployment in " + config.sysroot.string());
@@ -372,7 +377,7 @@ Uptane::Target OstreeManager::getCurrent() const {
 
 // used for bootloader rollback
 bool OstreeManager::imageUpdated() {
-  GObjectUniquePtr<OstreeSysroot> sysroot_smart = OstreeManager::LoadSysroot(config.sysroot);
+  GObjectUniquePtr<OstreeSysroot> sysroot_smart = getSysroot();
 
   // image updated if no pending deployment in the list of deployments
   GPtrArray *deployments = ostree_sysroot_get_deployments(sysroot_smart.get());
@@ -394,7 +399,7 @@ bool OstreeManager::imageUpdated() {
 }
 
 GObjectUniquePtr<OstreeDeployment> OstreeManager::getStagedDeployment() const {
-  GObjectUniquePtr<OstreeSysroot> sysroot_smart = OstreeManager::LoadSysroot(config.sysroot);
+  GObjectUniquePtr<OstreeSysroot> sysroot_smart = getSysroot();
 
   GPtrArray *deployments = nullptr;
   OstreeDeployment *res = nullptr;
@@ -412,6 +417,24 @@ GObjectUniquePtr<OstreeDeployment> OstreeManager::getStagedDeployment() const {
   return GObjectUniquePtr<OstreeDeployment>(res);
 }
 
+GObjectUniquePtr<OstreeSysroot> OstreeManager::getSysroot() const {
+  // OSTree bumps the mtime of ostree/deploy whenever it writes deployments,
+  // which is also what ostree_sysroot_load_if_changed() relies on. A changed
+  // sysroot is loaded into a new object rather than reloaded in place, so that
+  // callers still using the previous one are not affected.
+  const boost::filesystem::path root = config.sysroot.empty() ? boost::filesystem::path("/") : config.sysroot;
+  struct stat st {};
+  const bool stat_ok = stat((root / "ostree/deploy").c_str(), &st) == 0;
+
+  std::lock_guard<std::mutex> guard(sysroot_mutex_);
+  if (!stat_ok || sysroot_ == nullptr || st.st_mtim.tv_sec != sysroot_mtime_.tv_sec ||
+      st.st_mtim.tv_nsec != sysroot_mtime_.tv_nsec) {
+    sysroot_ = LoadSysroot(config.sysroot);
+    sysroot_mtime_ = stat_ok ? st.st_mtim : timespec{};
+  }
+  return GObjectUniquePtr<OstreeSysroot>(static_cast<OstreeSysroot *>(g_object_ref(sysroot_.get())));
+}
+
 GObjectUniquePtr<OstreeSysroot> OstreeManager::LoadSysroot(const boost::filesystem::path &path) {
   GObjectUniquePtr<OstreeSysroot> sysroot = nullptr;
 
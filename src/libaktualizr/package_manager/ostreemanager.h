@@ -1,7 +1,10 @@
 #ifndef OSTREE_H_
 #define OSTREE_H_
 
+#include <sys/stat.h>
+
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include <glib/gi18n.h>
@@ -57,6 +60,9 @@ class OstreeManager : public PackageManagerInterface {
   TargetStatus verifyTarget(const Uptane::Target &target) const override;
 
   GObjectUniquePtr<OstreeDeployment> getStagedDeployment() const;
+  // Returns the sysroot loaded by an earlier call, unless its deployments have
+  // changed since.
+  GObjectUniquePtr<OstreeSysroot> getSysroot() const;
   static GObjectUniquePtr<OstreeSysroot> LoadSysroot(const boost::filesystem::path &path);
   static GObjectUniquePtr<OstreeRepo> LoadRepo(OstreeSysroot *sysroot, GError **error);
   static bool addRemote(OstreeRepo *repo, const std::string &url, const KeyManager &keys);
@@ -70,6 +76,9 @@ class OstreeManager : public PackageManagerInterface {
 
  private:
   std::unique_ptr<Bootloader> bootloader_;
+  mutable std::mutex sysroot_mutex_;
+  mutable GObjectUniquePtr<OstreeSysroot> sysroot_;
+  mutable timespec sysroot_mtime_{};
 };
 
 #endif  // OSTREE_H_
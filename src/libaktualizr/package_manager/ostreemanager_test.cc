@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -127,6 +128,26 @@ TEST(OstreeManager, ParseInstalledPackages) {
   EXPECT_EQ(packages[2]["version"].asString(), "1.1");
 }
 
+/* Keep the sysroot loaded until its deployments change. */
+TEST(OstreeManager, SysrootCached) {
+  TemporaryDirectory temp_dir;
+  Config config;
+  config.pacman.type = PACKAGE_MANAGER_OSTREE;
+  config.pacman.sysroot = test_sysroot;
+  config.storage.path = temp_dir.Path();
+
+  std::shared_ptr<INvStorage> storage = INvStorage::newStorage(config.storage);
+  OstreeManager ostree(config.pacman, config.bootloader, storage, nullptr);
+  GObjectUniquePtr<OstreeSysroot> first = ostree.getSysroot();
+  GObjectUniquePtr<OstreeSysroot> second = ostree.getSysroot();
+  EXPECT_EQ(first.get(), second.get());
+
+  // what OSTree does when writing deployments
+  boost::filesystem::last_write_time(test_sysroot / "ostree/deploy", std::time(nullptr) + 10);
+  GObjectUniquePtr<OstreeSysroot> third = ostree.getSysroot();
+  EXPECT_NE(first.get(), third.get());
+}
+
 /* Communicate with a remote OSTree server without credentials. */
 TEST(OstreeManager, AddRemoteNoCreds) {
   TemporaryDirectory temp_dir;
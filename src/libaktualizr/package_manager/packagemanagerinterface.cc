@@ -8,6 +8,7 @@
 #include "http/httpclient.h"
 #include "logging/logging.h"
 #include "storage/invstorage.h"
+#include "telemetry/tracing.h"
 #include "uptane/fetcher.h"
 #include "utilities/apiqueue.h"
 
@@ -38,6 +39,11 @@ struct DownloadMetaStruct {
   FetcherProgressCb progress_cb;
   // each LogProgressInterval msec log dowload progress for big files
   std::chrono::time_point<std::chrono::steady_clock> time_lastreport;
+  // for the download metrics, reset at every request
+  std::chrono::time_point<std::chrono::steady_clock> time_request;
+  std::chrono::time_point<std::chrono::steady_clock> time_first_byte;
+  std::chrono::steady_clock::duration hash_time{0};
+  uint64_t received_length{0};
 
  private:
   MultiPartSHA256Hasher sha256_hasher;
@@ -53,12 +59,37 @@ static size_t DownloadHandler(char* contents, size_t size, size_t nmemb, void* u
     return downloaded + 1;  // curl will abort if return unexpected size;
   }
 
+  if (ds->received_length == 0) {
+    ds->time_first_byte = std::chrono::steady_clock::now();
+  }
   ds->fhandle.write(contents, static_cast<std::streamsize>(downloaded));
+  const auto hash_start = std::chrono::steady_clock::now();
   ds->hasher().update(reinterpret_cast<const unsigned char*>(contents), downloaded);
+  ds->hash_time += std::chrono::steady_clock::now() - hash_start;
   ds->downloaded_length += downloaded;
+  ds->received_length += downloaded;
   return downloaded;
 }
 
+// Downloads of different Targets run on different threads.
+static thread_local result::DownloadMetrics download_metrics;
+
+result::DownloadMetrics PackageManagerInterface::downloadMetrics() { return download_metrics; }
+
+void PackageManagerInterface::resetDownloadMetrics() { download_metrics = result::DownloadMetrics(); }
+
+// Adds what was received by the last request to the metrics.
+static void accountRequest(DownloadMetaStruct& ds, result::DownloadMetrics& metrics) {
+  if (ds.received_length > 0 && metrics.bytes == 0) {
+    metrics.time_to_first_byte =
+        std::chrono::duration_cast<std::chrono::milliseconds>(ds.time_first_byte - ds.time_request);
+  }
+  metrics.bytes += ds.received_length;
+  metrics.hash_time += std::chrono::duration_cast<std::chrono::milliseconds>(ds.hash_time);
+  ds.received_length = 0;
+  ds.hash_time = std::chrono::steady_clock::duration(0);
+}
+
 static constexpr int64_t LogProgressInterval = 15000;
 
 static int ProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
@@ -99,6 +130,7 @@ static void restoreHasherState(MultiPartHasher& hasher, std::ifstream data) {
 bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::Fetcher& fetcher,
                                           const KeyManager& keys, const FetcherProgressCb& progress_cb,
                                           const api::FlowControlToken* token) {
+  TRACE_SPAN("PackageManagerInterface::fetchTarget");
   (void)keys;
   bool result = false;
   try {
@@ -141,8 +173,10 @@ bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::
 
     HttpResponse response;
     for (;;) {
+      ds->time_request = std::chrono::steady_clock::now();
       response = http_->download(target_url, DownloadHandler, ProgressHandler, ds.get(),
                                  static_cast<curl_off_t>(ds->downloaded_length));
+      accountRequest(*ds, download_metrics);
 
       if (response.curl_code == CURLE_RANGE_ERROR) {
         LOG_WARNING << "The image server doesn't support byte range requests,"
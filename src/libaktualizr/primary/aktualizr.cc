@@ -6,6 +6,7 @@
 #include "libaktualizr/events.h"
 
 #include "sotauptaneclient.h"
+#include "telemetry/metrics_server.h"
 #include "utilities/apiqueue.h"
 #include "utilities/timer.h"
 
@@ -28,9 +29,23 @@ Aktualizr::Aktualizr(Config config, std::shared_ptr<INvStorage> storage_in,
   uptane_client_ = std::make_shared<SotaUptaneClient>(config_, storage_, http_in, sig_);
 }
 
-Aktualizr::~Aktualizr() { api_queue_.reset(nullptr); }
+Aktualizr::~Aktualizr() {
+  api_queue_.reset(nullptr);
+  metrics_server_.reset();
+}
 
 void Aktualizr::Initialize() {
+  const TelemetryConfig &telemetry = config_.telemetry;
+  if (!telemetry.metrics_socket.empty() || telemetry.metrics_port != 0) {
+    // Metrics are a monitoring aid, failing to serve them must not stop updates.
+    try {
+      metrics_server_ = std_::make_unique<metrics::MetricsServer>(telemetry.metrics_socket,
+                                                                  static_cast<in_port_t>(telemetry.metrics_port));
+    } catch (const std::exception &e) {
+      LOG_ERROR << "Unable to serve metrics: " << e.what();
+    }
+  }
+
   uptane_client_->initialize();
   api_queue_->run();
 }
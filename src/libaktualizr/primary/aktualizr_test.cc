@@ -266,6 +266,8 @@ TEST(Aktualizr, FullWithUpdates) {
         EXPECT_EQ(targets_event->result.updates[0].filename(), "primary_firmware.txt");
         EXPECT_EQ(targets_event->result.updates[1].filename(), "secondary_firmware.txt");
         EXPECT_EQ(targets_event->result.status, result::UpdateStatus::kUpdatesAvailable);
+        EXPECT_GT(targets_event->result.metrics.files, 0u);
+        EXPECT_GT(targets_event->result.metrics.bytes, 0u);
         break;
       }
       case 1:
@@ -286,6 +288,8 @@ TEST(Aktualizr, FullWithUpdates) {
         EXPECT_TRUE(downloads_complete->result.updates[0].filename() == "secondary_firmware.txt" ||
                     downloads_complete->result.updates[1].filename() == "secondary_firmware.txt");
         EXPECT_EQ(downloads_complete->result.status, result::DownloadStatus::kSuccess);
+        EXPECT_EQ(downloads_complete->result.metrics.size(), 2);
+        EXPECT_EQ(downloads_complete->result.metrics.count("primary_firmware.txt"), 1);
         break;
       }
       case 4: {
@@ -2,6 +2,8 @@
 
 #include <chrono>
 
+#include "telemetry/metrics.h"
+
 ReportQueue::ReportQueue(const Config& config_in, std::shared_ptr<HttpInterface> http_client,
                          std::shared_ptr<INvStorage> storage_in)
     : config(config_in), http(std::move(http_client)), storage(std::move(storage_in)) {
@@ -35,6 +37,7 @@ void ReportQueue::enqueue(std::unique_ptr<ReportEvent> event) {
   {
     std::lock_guard<std::mutex> lock(m_);
     storage->saveReportEvent(event->toJson());
+    metrics::Registry::get().addGauge("aktualizr_report_queue_depth", {}, 1);
   }
   cv_.notify_all();
 }
@@ -64,6 +67,7 @@ void ReportQueue::flushQueue() {
       storage->deleteReportEvents(max_id);
     }
   }
+  metrics::Registry::get().setGauge("aktualizr_report_queue_depth", {}, static_cast<double>(report_array.size()));
 }
 
 void ReportEvent::setEcu(const Uptane::EcuSerial& ecu) { custom["ecu"] = ecu.ToString(); }
@@ -0,0 +1,87 @@
+#include "secondary_install_scheduler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <map>
+#include <mutex>
+
+void SecondaryInstallScheduler::add(std::string segment, int priority, std::function<void()> job) {
+  jobs_.push_back(Job{std::move(segment), priority, std::move(job)});
+}
+
+void SecondaryInstallScheduler::run() {
+  std::stable_sort(jobs_.begin(), jobs_.end(), [](const Job &a, const Job &b) { return a.priority > b.priority; });
+
+  std::mutex m;
+  std::condition_variable cv;
+  uint64_t running = 0;
+  std::map<std::string, uint64_t> running_per_segment;
+  std::vector<bool> started(jobs_.size(), false);
+  size_t not_started = jobs_.size();
+  std::vector<std::future<void>> futures;
+
+  auto can_start = [&](const Job &job) {
+    if (max_parallel_ != 0 && running >= max_parallel_) {
+      return false;
+    }
+    return job.segment.empty() || max_per_segment_ == 0 || running_per_segment[job.segment] < max_per_segment_;
+  };
+
+  std::unique_lock<std::mutex> lock(m);
+  while (not_started > 0) {
+    for (size_t i = 0; i < jobs_.size(); ++i) {
+      if (started[i] || !can_start(jobs_[i])) {
+        continue;
+      }
+      started[i] = true;
+      --not_started;
+      ++running;
+      if (!jobs_[i].segment.empty()) {
+        ++running_per_segment[jobs_[i].segment];
+      }
+
+      const Job &job = jobs_[i];
+      futures.push_back(std::async(std::launch::async, [&m, &cv, &running, &running_per_segment, &job]() {
+        auto release = [&]() {
+          std::lock_guard<std::mutex> guard(m);
+          --running;
+          if (!job.segment.empty()) {
+            --running_per_segment[job.segment];
+          }
+          cv.notify_all();
+        };
+        try {
+          job.fn();
+        } catch (...) {
+          release();
+          throw;
+        }
+        release();
+      }));
+    }
+
+    if (not_started > 0) {
+      // Something must be running, otherwise a job would have been started.
+      const uint64_t running_before = running;
+      cv.wait(lock, [&]() { return running < running_before; });
+    }
+  }
+  lock.unlock();
+
+  std::exception_ptr first_error;
+  for (auto &f : futures) {
+    try {
+      f.get();
+    } catch (...) {
+      if (!first_error) {
+        first_error = std::current_exception();
+      }
+    }
+  }
+  jobs_.clear();
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
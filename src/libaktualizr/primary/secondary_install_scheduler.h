@@ -0,0 +1,37 @@
+#ifndef SECONDARY_INSTALL_SCHEDULER_H_
+#define SECONDARY_INSTALL_SCHEDULER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Runs Secondary installation jobs in parallel while respecting a global limit
+ * and a per-network-segment limit on the number of concurrent jobs. A limit of
+ * 0 means unlimited. Jobs without a segment are only subject to the global
+ * limit. */
+class SecondaryInstallScheduler {
+ public:
+  SecondaryInstallScheduler(uint64_t max_parallel, uint64_t max_per_segment)
+      : max_parallel_(max_parallel), max_per_segment_(max_per_segment) {}
+
+  void add(std::string segment, int priority, std::function<void()> job);
+
+  // Jobs with a higher priority are started first; jobs with the same priority
+  // are started in the order they were added. Blocks until all jobs are done.
+  // If any job throws, the first exception is rethrown once all jobs are done.
+  void run();
+
+ private:
+  struct Job {
+    std::string segment;
+    int priority;
+    std::function<void()> fn;
+  };
+
+  uint64_t max_parallel_;
+  uint64_t max_per_segment_;
+  std::vector<Job> jobs_;
+};
+
+#endif  // SECONDARY_INSTALL_SCHEDULER_H_
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "secondary_install_scheduler.h"
+
+class ConcurrencyTracker {
+ public:
+  void enter(const std::string &segment) {
+    std::lock_guard<std::mutex> guard(m_);
+    ++running_;
+    max_running_ = std::max(max_running_, running_);
+    ++segment_running_[segment];
+    max_segment_running_[segment] = std::max(max_segment_running_[segment], segment_running_[segment]);
+  }
+
+  void leave(const std::string &segment) {
+    std::lock_guard<std::mutex> guard(m_);
+    --running_;
+    --segment_running_[segment];
+  }
+
+  int maxRunning() const { return max_running_; }
+  int maxSegmentRunning(const std::string &segment) { return max_segment_running_[segment]; }
+
+ private:
+  std::mutex m_;
+  int running_{0};
+  int max_running_{0};
+  std::map<std::string, int> segment_running_;
+  std::map<std::string, int> max_segment_running_;
+};
+
+/*
+ * Limit the total number of jobs running at once.
+ */
+TEST(SecondaryInstallScheduler, GlobalLimit) {
+  ConcurrencyTracker tracker;
+  int done = 0;
+  std::mutex done_mutex;
+  SecondaryInstallScheduler scheduler(2, 0);
+  for (int i = 0; i < 6; ++i) {
+    scheduler.add("", 0, [&tracker, &done, &done_mutex]() {
+      tracker.enter("");
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      tracker.leave("");
+      std::lock_guard<std::mutex> guard(done_mutex);
+      ++done;
+    });
+  }
+  scheduler.run();
+  EXPECT_EQ(done, 6);
+  EXPECT_EQ(tracker.maxRunning(), 2);
+}
+
+/*
+ * Limit the number of jobs running at once on each network segment, without
+ * blocking jobs on other segments.
+ */
+TEST(SecondaryInstallScheduler, SegmentLimit) {
+  ConcurrencyTracker tracker;
+  SecondaryInstallScheduler scheduler(0, 1);
+  for (const std::string segment : {"can0", "can0", "can0", "eth0", "eth0", "eth0"}) {
+    scheduler.add(segment, 0, [&tracker, segment]() {
+      tracker.enter(segment);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      tracker.leave(segment);
+    });
+  }
+  scheduler.run();
+  EXPECT_EQ(tracker.maxSegmentRunning("can0"), 1);
+  EXPECT_EQ(tracker.maxSegmentRunning("eth0"), 1);
+  EXPECT_LE(tracker.maxRunning(), 2);
+}
+
+/*
+ * Start jobs with a higher priority first and keep the order of jobs with the
+ * same priority.
+ */
+TEST(SecondaryInstallScheduler, Priority) {
+  std::vector<int> order;
+  std::mutex order_mutex;
+  SecondaryInstallScheduler scheduler(1, 0);
+  const std::vector<std::pair<int, int>> jobs{{1, 0}, {2, 5}, {3, 0}, {4, 10}, {5, 5}};
+  for (const auto &job : jobs) {
+    const int id = job.first;
+    scheduler.add("", job.second, [&order, &order_mutex, id]() {
+      std::lock_guard<std::mutex> guard(order_mutex);
+      order.push_back(id);
+    });
+  }
+  scheduler.run();
+  EXPECT_EQ(order, std::vector<int>({4, 2, 5, 1, 3}));
+}
+
+/*
+ * Run all the jobs even if one of them fails, then report the failure.
+ */
+TEST(SecondaryInstallScheduler, JobThrows) {
+  int done = 0;
+  std::mutex done_mutex;
+  SecondaryInstallScheduler scheduler(1, 0);
+  scheduler.add("", 0, []() { throw std::runtime_error("failed"); });
+  for (int i = 0; i < 3; ++i) {
+    scheduler.add("", 0, [&done, &done_mutex]() {
+      std::lock_guard<std::mutex> guard(done_mutex);
+      ++done;
+    });
+  }
+  EXPECT_THROW(scheduler.run(), std::runtime_error);
+  EXPECT_EQ(done, 3);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
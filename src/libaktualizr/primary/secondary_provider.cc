@@ -2,6 +2,8 @@
 #include "logging/logging.h"
 #include "storage/invstorage.h"
 #include "uptane/tuf.h"
+#include "utilities/shared_file.h"
+#include "utilities/utils.h"
 
 bool SecondaryProvider::getMetadata(Uptane::MetaBundle* meta_bundle, const Uptane::Target& target) const {
   std::string root;
@@ -95,3 +97,19 @@ std::string SecondaryProvider::getTreehubCredentials() const {
 std::ifstream SecondaryProvider::getTargetFileHandle(const Uptane::Target& target) const {
   return package_manager_->openTargetFile(target);
 }
+
+std::unique_ptr<SharedFileReader> SecondaryProvider::getTargetFileReader(const Uptane::Target& target) const {
+  auto file = package_manager_->checkTargetFile(target);
+  if (!file) {
+    throw std::runtime_error("File doesn't exist for target " + target.filename());
+  }
+  return std_::make_unique<SharedFileReader>(SharedFile::open(file->second));
+}
+
+boost::optional<boost::filesystem::path> SecondaryProvider::getTargetFilePath(const Uptane::Target& target) const {
+  auto file = package_manager_->checkTargetFile(target);
+  if (!file) {
+    return boost::none;
+  }
+  return boost::filesystem::path(file->second);
+}
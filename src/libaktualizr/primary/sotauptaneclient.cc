@@ -1,8 +1,15 @@
 #include "sotauptaneclient.h"
 
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <utility>
 
 #include "crypto/crypto.h"
@@ -10,6 +17,8 @@
 #include "initializer.h"
 #include "libaktualizr/campaign.h"
 #include "logging/logging.h"
+#include "secondary_install_scheduler.h"
+#include "telemetry/tracing.h"
 #include "uptane/exceptions.h"
 
 #include "utilities/fault_injection.h"
@@ -24,6 +33,10 @@ static void report_progress_cb(event::Channel *channel, const Uptane::Target &ta
   (*channel)(event);
 }
 
+static std::chrono::milliseconds elapsedSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
 void SotaUptaneClient::addSecondary(const std::shared_ptr<SecondaryInterface> &sec) {
   Uptane::EcuSerial serial = sec->getSerial();
 
@@ -85,18 +98,17 @@ void SotaUptaneClient::finalizeAfterReboot() {
     return;
   }
 
-  storage->saveEcuInstallationResult(primary_ecu_serial, install_res);
+  storage->runInTransaction([this, &primary_ecu_serial, &install_res, &pending_target]() {
+    storage->saveEcuInstallationResult(primary_ecu_serial, install_res);
+    // if finalize failed, unset pending flag so that the rest of the Uptane process can go forward again
+    storage->saveInstalledVersion(
+        primary_ecu_serial.ToString(), *pending_target,
+        install_res.success ? InstalledVersionUpdateMode::kCurrent : InstalledVersionUpdateMode::kNone);
+  });
 
   const std::string correlation_id = pending_target->correlation_id();
-  if (install_res.success) {
-    storage->saveInstalledVersion(primary_ecu_serial.ToString(), *pending_target, InstalledVersionUpdateMode::kCurrent);
-
-    report_queue->enqueue(std_::make_unique<EcuInstallationCompletedReport>(primary_ecu_serial, correlation_id, true));
-  } else {
-    // finalize failed, unset pending flag so that the rest of the Uptane process can go forward again
-    storage->saveInstalledVersion(primary_ecu_serial.ToString(), *pending_target, InstalledVersionUpdateMode::kNone);
-    report_queue->enqueue(std_::make_unique<EcuInstallationCompletedReport>(primary_ecu_serial, correlation_id, false));
-  }
+  report_queue->enqueue(
+      std_::make_unique<EcuInstallationCompletedReport>(primary_ecu_serial, correlation_id, install_res.success));
 
   director_repo.dropTargets(*storage);  // fix for OTA-2587, listen to backend again after end of install
 
@@ -122,14 +134,16 @@ data::InstallationResult SotaUptaneClient::PackageInstallSetResult(const Uptane:
   storage->saveInstalledVersion(ecu_serial.ToString(), target, InstalledVersionUpdateMode::kNone);
 
   result = PackageInstall(target);
-  if (result.result_code.num_code == data::ResultCode::Numeric::kOk) {
-    // simple case: update already completed
-    storage->saveInstalledVersion(ecu_serial.ToString(), target, InstalledVersionUpdateMode::kCurrent);
-  } else if (result.result_code.num_code == data::ResultCode::Numeric::kNeedCompletion) {
-    // OSTree case: need reboot
-    storage->saveInstalledVersion(ecu_serial.ToString(), target, InstalledVersionUpdateMode::kPending);
-  }
-  storage->saveEcuInstallationResult(ecu_serial, result);
+  storage->runInTransaction([this, &result, &ecu_serial, &target]() {
+    if (result.result_code.num_code == data::ResultCode::Numeric::kOk) {
+      // simple case: update already completed
+      storage->saveInstalledVersion(ecu_serial.ToString(), target, InstalledVersionUpdateMode::kCurrent);
+    } else if (result.result_code.num_code == data::ResultCode::Numeric::kNeedCompletion) {
+      // OSTree case: need reboot
+      storage->saveInstalledVersion(ecu_serial.ToString(), target, InstalledVersionUpdateMode::kPending);
+    }
+    storage->saveEcuInstallationResult(ecu_serial, result);
+  });
   return result;
 }
 
@@ -387,18 +401,22 @@ void SotaUptaneClient::initialize() {
   finalizeAfterReboot();
 }
 
-void SotaUptaneClient::updateDirectorMeta() {
+void SotaUptaneClient::updateDirectorMeta(const Uptane::IMetadataFetcher &fetcher) {
+  TRACE_SPAN("SotaUptaneClient::updateDirectorMeta");
   try {
-    director_repo.updateMeta(*storage, *uptane_fetcher);
+    director_repo.updateMeta(*storage, fetcher);
   } catch (const std::exception &e) {
     LOG_ERROR << "Director metadata update failed: " << e.what();
     throw;
   }
 }
 
-void SotaUptaneClient::updateImageMeta() {
+void SotaUptaneClient::updateImageMeta() { updateImageMeta(*uptane_fetcher); }
+
+void SotaUptaneClient::updateImageMeta(const Uptane::IMetadataFetcher &fetcher) {
+  TRACE_SPAN("SotaUptaneClient::updateImageMeta");
   try {
-    image_repo.updateMeta(*storage, *uptane_fetcher);
+    image_repo.updateMeta(*storage, fetcher);
   } catch (const std::exception &e) {
     LOG_ERROR << "Failed to update Image repo metadata: " << e.what();
     throw;
@@ -656,8 +674,9 @@ result::Download SotaUptaneClient::downloadImages(const std::vector<Uptane::Targ
     return result;
   }
 
+  std::map<std::string, result::DownloadMetrics> metrics;
   for (const auto &target : targets) {
-    auto res = downloadImage(target, token);
+    auto res = downloadImage(target, token, &metrics[target.filename()]);
     if (res.first) {
       downloaded_targets.push_back(res.second);
     }
@@ -677,6 +696,7 @@ result::Download SotaUptaneClient::downloadImages(const std::vector<Uptane::Targ
         data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Target download failed."));
   }
 
+  result.metrics = std::move(metrics);
   sendEvent<event::AllDownloadsComplete>(result);
   return result;
 }
@@ -692,7 +712,8 @@ void SotaUptaneClient::reportResume() {
 }
 
 std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Target &target,
-                                                                const api::FlowControlToken *token) {
+                                                                const api::FlowControlToken *token,
+                                                                result::DownloadMetrics *metrics) {
   const std::string &correlation_id = director_repo.getCorrelationId();
   // send an event for all ECUs that are touched by this target
   for (const auto &ecu : target.ecus()) {
@@ -704,6 +725,9 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
   // downloadImages but aktualizr-lite currently calls this method directly.
 
   bool success = false;
+  const auto download_start = std::chrono::steady_clock::now();
+  unsigned int retries = 0;
+  PackageManagerInterface::resetDownloadMetrics();
   try {
     KeyManager keys(storage, config.keymanagerConfig());
     keys.loadKeys();
@@ -727,6 +751,7 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
         } else if (tries < max_tries - 1) {
           std::this_thread::sleep_for(wait);
           wait *= 2;
+          ++retries;
         }
       }
       if (!success) {
@@ -745,32 +770,57 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
     last_exception = std::current_exception();
   }
 
+  result::DownloadMetrics download_metrics = PackageManagerInterface::downloadMetrics();
+  download_metrics.total_time = elapsedSince(download_start);
+  download_metrics.retries = retries;
+  if (metrics != nullptr) {
+    *metrics = download_metrics;
+  }
+
   // send this asynchronously before `sendEvent`, so that the report timestamp
   // would not be delayed by callbacks on events
   for (const auto &ecu : target.ecus()) {
     report_queue->enqueue(std_::make_unique<EcuDownloadCompletedReport>(ecu.first, correlation_id, success));
   }
 
-  sendEvent<event::DownloadTargetComplete>(target, success);
+  sendEvent<event::DownloadTargetComplete>(target, success, download_metrics);
   return {success, target};
 }
 
-void SotaUptaneClient::uptaneIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count) {
-  updateDirectorMeta();
+/* With `metrics`, the time spent is split into fetching the metadata and
+ * everything else, which is mostly verification. The metrics are filled in
+ * even if the iteration fails. */
+void SotaUptaneClient::uptaneIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count,
+                                       result::MetadataMetrics *metrics) {
+  Uptane::MeasuringFetcher fetcher(*uptane_fetcher);
+  const auto start = std::chrono::steady_clock::now();
+  auto record_metrics = [&]() {
+    if (metrics != nullptr) {
+      *metrics = fetcher.metrics(std::chrono::steady_clock::now() - start);
+    }
+  };
 
   std::vector<Uptane::Target> tmp_targets;
   unsigned int ecus;
   try {
-    getNewTargets(&tmp_targets, &ecus);
-  } catch (const std::exception &e) {
-    LOG_ERROR << "Inconsistency between Director metadata and available ECUs: " << e.what();
-    throw;
-  }
+    updateDirectorMeta(fetcher);
 
-  if (!tmp_targets.empty()) {
-    LOG_INFO << "New updates found in Director metadata. Checking Image repo metadata...";
-    updateImageMeta();
+    try {
+      getNewTargets(&tmp_targets, &ecus);
+    } catch (const std::exception &e) {
+      LOG_ERROR << "Inconsistency between Director metadata and available ECUs: " << e.what();
+      throw;
+    }
+
+    if (!tmp_targets.empty()) {
+      LOG_INFO << "New updates found in Director metadata. Checking Image repo metadata...";
+      updateImageMeta(fetcher);
+    }
+  } catch (...) {
+    record_metrics();
+    throw;
   }
+  record_metrics();
 
   if (targets != nullptr) {
     *targets = std::move(tmp_targets);
@@ -814,6 +864,7 @@ void SotaUptaneClient::sendDeviceData(const Json::Value &custom_hwinfo) {
 }
 
 result::UpdateCheck SotaUptaneClient::fetchMeta() {
+  TRACE_SPAN("SotaUptaneClient::fetchMeta");
   result::UpdateCheck result;
 
   reportNetworkInfo();
@@ -844,20 +895,23 @@ result::UpdateCheck SotaUptaneClient::fetchMeta() {
 
 result::UpdateCheck SotaUptaneClient::checkUpdates() {
   result::UpdateCheck result;
+  result::MetadataMetrics metrics;
 
   std::vector<Uptane::Target> updates;
   unsigned int ecus_count = 0;
   try {
-    uptaneIteration(&updates, &ecus_count);
+    uptaneIteration(&updates, &ecus_count, &metrics);
   } catch (const std::exception &e) {
     last_exception = std::current_exception();
     result = result::UpdateCheck({}, 0, result::UpdateStatus::kError, Json::nullValue, "Could not update metadata.");
+    result.metrics = metrics;
     return result;
   }
 
   std::string director_targets;
   if (!storage->loadNonRoot(&director_targets, Uptane::RepositoryType::Director(), Uptane::Role::Targets())) {
     result = result::UpdateCheck({}, 0, result::UpdateStatus::kError, Json::nullValue, "Could not update metadata.");
+    result.metrics = metrics;
     return result;
   }
 
@@ -865,6 +919,7 @@ result::UpdateCheck SotaUptaneClient::checkUpdates() {
     LOG_DEBUG << "No new updates found in Uptane metadata.";
     result =
         result::UpdateCheck({}, 0, result::UpdateStatus::kNoUpdatesAvailable, Utils::parseJSON(director_targets), "");
+    result.metrics = metrics;
     return result;
   }
 
@@ -893,6 +948,7 @@ result::UpdateCheck SotaUptaneClient::checkUpdates() {
                                  "Target mismatch.");
     storeInstallationFailure(
         data::InstallationResult(data::ResultCode::Numeric::kVerificationFailed, "Metadata verification failed."));
+    result.metrics = metrics;
     return result;
   }
 
@@ -903,6 +959,7 @@ result::UpdateCheck SotaUptaneClient::checkUpdates() {
   } else {
     LOG_INFO << updates.size() << " new updates found in both Director and Image repo metadata.";
   }
+  result.metrics = metrics;
   return result;
 }
 
@@ -1034,7 +1091,9 @@ result::Install SotaUptaneClient::uptaneInstall(const std::vector<Uptane::Target
       // notify the bootloader before installation happens, because installation is not atomic and
       //   a false notification doesn't hurt when rollbacks are implemented
       package_manager_->updateNotify();
+      const auto install_start = std::chrono::steady_clock::now();
       install_res = PackageInstallSetResult(primary_update);
+      const std::chrono::milliseconds install_time = elapsedSince(install_start);
       if (install_res.result_code.num_code == data::ResultCode::Numeric::kNeedCompletion) {
         // update needs a reboot, send distinct EcuInstallationApplied event
         report_queue->enqueue(std_::make_unique<EcuInstallationAppliedReport>(primary_ecu_serial, correlation_id));
@@ -1052,6 +1111,7 @@ result::Install SotaUptaneClient::uptaneInstall(const std::vector<Uptane::Target
         sendEvent<event::InstallTargetComplete>(primary_ecu_serial, false);
       }
       result.ecu_reports.emplace(result.ecu_reports.begin(), primary_update, primary_ecu_serial, install_res);
+      result.ecu_reports.front().install_time = install_time;
     } else {
       LOG_INFO << "No update to install on Primary";
     }
@@ -1155,7 +1215,7 @@ bool SotaUptaneClient::putManifest(const Json::Value &custom) {
 }
 
 bool SotaUptaneClient::waitSecondariesReachable(const std::vector<Uptane::Target> &updates) {
-  std::map<Uptane::EcuSerial, SecondaryInterface *> targeted_secondaries;
+  std::map<Uptane::EcuSerial, SecondaryInterface::Ptr> targeted_secondaries;
   const Uptane::EcuSerial &primary_ecu_serial = primaryEcuSerial();
   for (const auto &t : updates) {
     for (const auto &ecu : t.ecus()) {
@@ -1168,7 +1228,7 @@ bool SotaUptaneClient::waitSecondariesReachable(const std::vector<Uptane::Target
         continue;
       }
 
-      targeted_secondaries[ecu.first] = f->second.get();
+      targeted_secondaries[ecu.first] = f->second;
     }
   }
 
@@ -1178,33 +1238,75 @@ bool SotaUptaneClient::waitSecondariesReachable(const std::vector<Uptane::Target
 
   LOG_INFO << "Waiting for Secondaries to connect to start installation...";
 
-  auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(config.uptane.secondary_preinstall_wait_sec);
-  while (std::chrono::system_clock::now() <= deadline) {
-    if (targeted_secondaries.empty()) {
-      return true;
-    }
-
-    for (auto sec_it = targeted_secondaries.begin(); sec_it != targeted_secondaries.end();) {
+  // Every targeted Secondary is watched by its own worker, which pings it
+  // until it answers: again after a short delay, then once per second. The
+  // install path is woken up as soon as the last one is reachable instead of
+  // on a fixed tick. Each Secondary is pinged at least once, however short the
+  // wait, and the workers are joined before returning, so that no ping
+  // overlaps with the requests that follow.
+  std::mutex m;
+  std::condition_variable cv;
+  std::set<Uptane::EcuSerial> reachable;
+  size_t probed = 0;
+  bool stop = false;
+
+  auto monitor = [&](const Uptane::EcuSerial &serial, const SecondaryInterface::Ptr &sec) {
+    auto delay = std::chrono::milliseconds(100);
+    bool first = true;
+    std::unique_lock<std::mutex> lock(m);
+    while (!stop) {
+      lock.unlock();
       bool connected = false;
       try {
-        connected = sec_it->second->ping();
+        connected = sec->ping();
       } catch (const std::exception &ex) {
-        LOG_DEBUG << "Failed to ping Secondary with serial " << sec_it->first << ": " << ex.what();
+        LOG_DEBUG << "Failed to ping Secondary with serial " << serial << ": " << ex.what();
+      }
+      lock.lock();
+      if (first) {
+        ++probed;
+        first = false;
       }
       if (connected) {
-        sec_it = targeted_secondaries.erase(sec_it);
-      } else {
-        sec_it++;
+        reachable.insert(serial);
       }
+      cv.notify_all();
+      if (connected) {
+        return;
+      }
+      cv.wait_for(lock, delay, [&stop]() { return stop; });
+      delay = std::chrono::milliseconds(1000);
     }
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(targeted_secondaries.size());
+  for (const auto &sec : targeted_secondaries) {
+    workers.emplace_back(monitor, sec.first, sec.second);
+  }
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(config.uptane.secondary_preinstall_wait_sec);
+  {
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_until(lock, deadline, [&]() { return reachable.size() == targeted_secondaries.size(); });
+    cv.wait(lock, [&]() { return probed == targeted_secondaries.size(); });
+    stop = true;
+  }
+  cv.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
   }
 
+  bool all_connected = true;
   for (const auto &sec : targeted_secondaries) {
-    LOG_ERROR << "Secondary with serial " << sec.second->getSerial() << " failed to connect!";
+    if (reachable.count(sec.first) == 0) {
+      LOG_ERROR << "Secondary with serial " << sec.second->getSerial() << " failed to connect!";
+      all_connected = false;
+    }
   }
 
-  return false;
+  return all_connected;
 }
 
 void SotaUptaneClient::storeInstallationFailure(const data::InstallationResult &result) {
@@ -1216,6 +1318,29 @@ void SotaUptaneClient::storeInstallationFailure(const data::InstallationResult &
   director_repo.dropTargets(*storage);
 }
 
+/* Root metadata is loaded (or fetched) at most once per version and shared by
+ * all Secondaries that need it, since they may be rotated in parallel. */
+bool SotaUptaneClient::loadRootForSecondaries(std::string *root, Uptane::RepositoryType repo, const int version) {
+  std::lock_guard<std::mutex> guard(secondary_roots_mutex_);
+  const auto key = std::make_pair(static_cast<int>(repo), version);
+  const auto it = secondary_roots_.find(key);
+  if (it != secondary_roots_.end()) {
+    *root = it->second;
+    return true;
+  }
+
+  if (!storage->loadRoot(root, repo, Uptane::Version(version))) {
+    LOG_WARNING << "Couldn't find Root metadata in the storage, trying remote repo";
+    try {
+      uptane_fetcher->fetchRole(root, Uptane::kMaxRootSize, repo, Uptane::Role::Root(), Uptane::Version(version));
+    } catch (const std::exception &e) {
+      return false;
+    }
+  }
+  secondary_roots_.emplace(key, *root);
+  return true;
+}
+
 /* If the Root has been rotated more than once, we need to provide the Secondary
  * with the incremental steps from what it has now. */
 data::InstallationResult SotaUptaneClient::rotateSecondaryRoot(Uptane::RepositoryType repo,
@@ -1232,17 +1357,12 @@ data::InstallationResult SotaUptaneClient::rotateSecondaryRoot(Uptane::Repositor
   if (sec_root_version > 0 && last_root_version - sec_root_version > 1) {
     for (int v = sec_root_version + 1; v <= last_root_version; v++) {
       std::string root;
-      if (!storage->loadRoot(&root, repo, Uptane::Version(v))) {
-        LOG_WARNING << "Couldn't find Root metadata in the storage, trying remote repo";
-        try {
-          uptane_fetcher->fetchRole(&root, Uptane::kMaxRootSize, repo, Uptane::Role::Root(), Uptane::Version(v));
-        } catch (const std::exception &e) {
-          // TODO(OTA-4552): looks problematic, robust procedure needs to be defined
-          LOG_ERROR << "Root metadata could not be fetched, skipping to the next Secondary";
-          result = data::InstallationResult(data::ResultCode::Numeric::kInternalError,
-                                            "Root metadata could not be fetched, skipping to the next Secondary");
-          break;
-        }
+      if (!loadRootForSecondaries(&root, repo, v)) {
+        // TODO(OTA-4552): looks problematic, robust procedure needs to be defined
+        LOG_ERROR << "Root metadata could not be fetched, skipping to the next Secondary";
+        result = data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                          "Root metadata could not be fetched, skipping to the next Secondary");
+        break;
       }
       try {
         result = secondary.putRoot(root, repo == Uptane::RepositoryType::Director());
@@ -1259,46 +1379,94 @@ data::InstallationResult SotaUptaneClient::rotateSecondaryRoot(Uptane::Repositor
   return result;
 }
 
-// TODO: the function blocks until it updates all the Secondaries. Consider non-blocking operation.
+/* Metadata is sent to up to `secondary_metadata_concurrency` Secondaries at
+ * once. All targets for a given Secondary are handled by the same worker, in
+ * order, so that each Secondary only ever sees one request at a time. The
+ * function still blocks until all the Secondaries have been updated. */
 void SotaUptaneClient::sendMetadataToEcus(const std::vector<Uptane::Target> &targets, data::InstallationResult *result,
                                           std::string *raw_installation_report) {
-  data::InstallationResult final_result{data::ResultCode::Numeric::kOk, ""};
-  std::string result_code_err_str;
+  TRACE_SPAN("SotaUptaneClient::sendMetadataToEcus");
+  struct MetadataItem {
+    const Uptane::Target *target;
+    Uptane::HardwareIdentifier hw_id;
+    data::InstallationResult result;
+  };
+  std::vector<MetadataItem> items;
+  // ecu_serial => indices into items
+  std::map<Uptane::EcuSerial, std::vector<size_t>> per_secondary;
   for (const auto &target : targets) {
     for (const auto &ecu : target.ecus()) {
-      const Uptane::EcuSerial ecu_serial = ecu.first;
-      const Uptane::HardwareIdentifier hw_id = ecu.second;
-      auto sec = secondaries.find(ecu_serial);
-      if (sec == secondaries.end()) {
+      if (secondaries.find(ecu.first) == secondaries.end()) {
         continue;
       }
+      per_secondary[ecu.first].push_back(items.size());
+      items.push_back(MetadataItem{&target, ecu.second, data::InstallationResult()});
+    }
+  }
 
-      data::InstallationResult local_result{data::ResultCode::Numeric::kOk, ""};
-      do {
-        /* Root rotation if necessary */
-        local_result = rotateSecondaryRoot(Uptane::RepositoryType::Director(), *(sec->second));
-        if (!local_result.isSuccess()) {
-          final_result = local_result;
-          break;
+  std::vector<std::pair<SecondaryInterface *, const std::vector<size_t> *>> jobs;
+  for (const auto &s : per_secondary) {
+    jobs.emplace_back(secondaries[s.first].get(), &s.second);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(secondary_roots_mutex_);
+    secondary_roots_.clear();
+  }
+
+  std::atomic<size_t> next_job{0};
+  auto worker = [this, &jobs, &items, &next_job]() {
+    for (size_t j = next_job++; j < jobs.size(); j = next_job++) {
+      SecondaryInterface &sec = *jobs[j].first;
+      const std::vector<size_t> &indices = *jobs[j].second;
+
+      /* Root rotation if necessary */
+      data::InstallationResult rotate_result;
+      try {
+        rotate_result = rotateSecondaryRoot(Uptane::RepositoryType::Director(), sec);
+        if (rotate_result.isSuccess()) {
+          rotate_result = rotateSecondaryRoot(Uptane::RepositoryType::Image(), sec);
         }
-        local_result = rotateSecondaryRoot(Uptane::RepositoryType::Image(), *(sec->second));
-        if (!local_result.isSuccess()) {
-          final_result = local_result;
-          break;
+      } catch (const std::exception &ex) {
+        rotate_result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
+      }
+
+      for (const size_t i : indices) {
+        data::InstallationResult local_result = rotate_result;
+        if (local_result.isSuccess()) {
+          try {
+            local_result = sec.putMetadata(*items[i].target);
+          } catch (const std::exception &ex) {
+            local_result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
+          }
         }
-        try {
-          local_result = sec->second->putMetadata(target);
-        } catch (const std::exception &ex) {
-          local_result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
+        if (!local_result.isSuccess()) {
+          LOG_ERROR << "Sending metadata to " << sec.getSerial() << " failed: " << local_result.result_code << " "
+                    << local_result.description;
         }
-      } while (false);
-      if (!local_result.isSuccess()) {
-        LOG_ERROR << "Sending metadata to " << sec->first << " failed: " << local_result.result_code << " "
-                  << local_result.description;
-        const std::string ecu_code_str = hw_id.ToString() + ":" + local_result.result_code.toString();
-        result_code_err_str += (!result_code_err_str.empty() ? "|" : "") + ecu_code_str;
+        items[i].result = local_result;
       }
     }
+  };
+
+  const auto width = static_cast<size_t>(
+      std::max<uint64_t>(1, std::min<uint64_t>(config.uptane.secondary_metadata_concurrency, jobs.size())));
+  std::vector<std::future<void>> workers;
+  for (size_t k = 1; k < width; ++k) {
+    workers.push_back(std::async(std::launch::async, worker));
+  }
+  worker();
+  for (auto &w : workers) {
+    w.get();
+  }
+
+  data::InstallationResult final_result{data::ResultCode::Numeric::kOk, ""};
+  std::string result_code_err_str;
+  for (const auto &item : items) {
+    if (!item.result.isSuccess()) {
+      const std::string ecu_code_str = item.hw_id.ToString() + ":" + item.result.result_code.toString();
+      result_code_err_str += (!result_code_err_str.empty() ? "|" : "") + ecu_code_str;
+    }
   }
 
   if (!result_code_err_str.empty()) {
@@ -1316,45 +1484,85 @@ void SotaUptaneClient::sendMetadataToEcus(const std::vector<Uptane::Target> &tar
   }
 }
 
-std::future<data::InstallationResult> SotaUptaneClient::sendFirmwareAsync(SecondaryInterface &secondary,
-                                                                          const Uptane::Target &target) {
-  auto f = [this, &secondary, target]() {
-    const std::string &correlation_id = director_repo.getCorrelationId();
+data::InstallationResult SotaUptaneClient::sendFirmwareToSecondary(SecondaryInterface &secondary,
+                                                                   const Uptane::Target &target,
+                                                                   result::Install::EcuReport *report) {
+  const std::string &correlation_id = director_repo.getCorrelationId();
 
-    sendEvent<event::InstallStarted>(secondary.getSerial());
-    report_queue->enqueue(std_::make_unique<EcuInstallationStartedReport>(secondary.getSerial(), correlation_id));
+  sendEvent<event::InstallStarted>(secondary.getSerial());
+  report_queue->enqueue(std_::make_unique<EcuInstallationStartedReport>(secondary.getSerial(), correlation_id));
 
-    data::InstallationResult result;
-    try {
-      result = secondary.sendFirmware(target);
-      if (result.isSuccess()) {
-        result = secondary.install(target);
-      }
-    } catch (const std::exception &ex) {
-      result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
+  data::InstallationResult result;
+  try {
+    auto start = std::chrono::steady_clock::now();
+    result = secondary.sendFirmware(target);
+    report->send_time = elapsedSince(start);
+    if (result.isSuccess()) {
+      start = std::chrono::steady_clock::now();
+      result = secondary.install(target);
+      report->install_time = elapsedSince(start);
     }
+  } catch (const std::exception &ex) {
+    result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
+  }
 
-    if (result.result_code == data::ResultCode::Numeric::kNeedCompletion) {
-      report_queue->enqueue(std_::make_unique<EcuInstallationAppliedReport>(secondary.getSerial(), correlation_id));
-    } else {
-      report_queue->enqueue(
-          std_::make_unique<EcuInstallationCompletedReport>(secondary.getSerial(), correlation_id, result.isSuccess()));
-    }
+  if (result.result_code == data::ResultCode::Numeric::kNeedCompletion) {
+    report_queue->enqueue(std_::make_unique<EcuInstallationAppliedReport>(secondary.getSerial(), correlation_id));
+  } else {
+    report_queue->enqueue(
+        std_::make_unique<EcuInstallationCompletedReport>(secondary.getSerial(), correlation_id, result.isSuccess()));
+  }
 
-    sendEvent<event::InstallTargetComplete>(secondary.getSerial(), result.isSuccess());
-    return result;
-  };
+  sendEvent<event::InstallTargetComplete>(secondary.getSerial(), result.isSuccess());
+  return result;
+}
 
-  return std::async(std::launch::async, f);
+/* Ask the kernel to start reading a target image before it is streamed to the
+ * Secondaries, so that all of them are served from the page cache rather than
+ * each one waiting on the disk. This is only a hint; failures are ignored. */
+void SotaUptaneClient::readAheadTargetFile(const Uptane::Target &target) const {
+  if (target.IsOstree()) {
+    return;
+  }
+  try {
+    auto file = package_manager_->checkTargetFile(target);
+    if (!file) {
+      return;
+    }
+    const int fd = ::open(file->second.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) != 0) {
+      LOG_DEBUG << "Unable to read ahead target file " << file->second;
+    }
+    ::close(fd);
+  } catch (const std::exception &ex) {
+    LOG_DEBUG << "Unable to read ahead target " << target.filename() << ": " << ex.what();
+  }
 }
 
+/* Images are sent to the Secondaries in parallel, but no more than
+ * `secondary_install_concurrency` at once overall and no more than
+ * `secondary_segment_concurrency` at once per network segment. The segment of
+ * a Secondary is the "segment" field of the data stored for it with
+ * Aktualizr::SetSecondaryData(), if any. Targets with a higher
+ * `install_priority` value in their custom metadata are started first. */
 std::vector<result::Install::EcuReport> SotaUptaneClient::sendImagesToEcus(const std::vector<Uptane::Target> &targets) {
+  TRACE_SPAN("SotaUptaneClient::sendImagesToEcus");
   std::vector<result::Install::EcuReport> reports;
-  std::vector<std::pair<result::Install::EcuReport, std::future<data::InstallationResult>>> firmwareFutures;
+  std::vector<data::InstallationResult> results;
+  SecondaryInstallScheduler scheduler(config.uptane.secondary_install_concurrency,
+                                      config.uptane.secondary_segment_concurrency);
+  const std::map<Uptane::EcuSerial, std::string> segments = secondarySegments();
 
   const Uptane::EcuSerial &primary_ecu_serial = primaryEcuSerial();
   // target images should already have been downloaded to metadata_path/targets/
   for (auto targets_it = targets.cbegin(); targets_it != targets.cend(); ++targets_it) {
+    const Json::Value priority = targets_it->custom_data()["install_priority"];
+    const int install_priority = priority.isInt() ? priority.asInt() : 0;
+    bool read_ahead = false;
+
     for (auto ecus_it = targets_it->ecus().cbegin(); ecus_it != targets_it->ecus().cend(); ++ecus_it) {
       const Uptane::EcuSerial &ecu_serial = ecus_it->first;
 
@@ -1368,27 +1576,55 @@ std::vector<result::Install::EcuReport> SotaUptaneClient::sendImagesToEcus(const
         continue;
       }
 
+      if (!read_ahead) {
+        readAheadTargetFile(*targets_it);
+        read_ahead = true;
+      }
+
       SecondaryInterface &sec = *f->second;
-      firmwareFutures.emplace_back(result::Install::EcuReport(*targets_it, ecu_serial, data::InstallationResult()),
-                                   sendFirmwareAsync(sec, *targets_it));
+      const size_t slot = reports.size();
+      reports.emplace_back(*targets_it, ecu_serial, data::InstallationResult());
+      results.emplace_back();
+      const auto segment = segments.find(ecu_serial);
+      scheduler.add(segment != segments.end() ? segment->second : "", install_priority,
+                    [this, &sec, &reports, &results, targets_it, slot]() {
+                      results[slot] = sendFirmwareToSecondary(sec, *targets_it, &reports[slot]);
+                    });
     }
   }
 
-  for (auto &f : firmwareFutures) {
-    data::InstallationResult fut_result = f.second.get();
+  scheduler.run();
+
+  storage->runInTransaction([this, &reports, &results]() {
+    for (size_t i = 0; i < reports.size(); ++i) {
+      auto &report = reports[i];
+      const data::InstallationResult &res = results[i];
+
+      if (res.isSuccess() || res.result_code == data::ResultCode::Numeric::kNeedCompletion) {
+        report.update.setCorrelationId(director_repo.getCorrelationId());
+        auto update_mode =
+            res.isSuccess() ? InstalledVersionUpdateMode::kCurrent : InstalledVersionUpdateMode::kPending;
+        storage->saveInstalledVersion(report.serial.ToString(), report.update, update_mode);
+      }
 
-    if (fut_result.isSuccess() || fut_result.result_code == data::ResultCode::Numeric::kNeedCompletion) {
-      f.first.update.setCorrelationId(director_repo.getCorrelationId());
-      auto update_mode =
-          fut_result.isSuccess() ? InstalledVersionUpdateMode::kCurrent : InstalledVersionUpdateMode::kPending;
-      storage->saveInstalledVersion(f.first.serial.ToString(), f.first.update, update_mode);
+      report.install_res = res;
+      storage->saveEcuInstallationResult(report.serial, report.install_res);
     }
+  });
+  return reports;
+}
 
-    f.first.install_res = fut_result;
-    storage->saveEcuInstallationResult(f.first.serial, f.first.install_res);
-    reports.push_back(f.first);
+std::map<Uptane::EcuSerial, std::string> SotaUptaneClient::secondarySegments() const {
+  std::map<Uptane::EcuSerial, std::string> segments;
+  std::vector<SecondaryInfo> secondaries_info;
+  storage->loadSecondariesInfo(&secondaries_info);
+  for (const auto &info : secondaries_info) {
+    const Json::Value data = Utils::parseJSON(info.extra);
+    if (data.isObject() && data["segment"].isString()) {
+      segments.emplace(info.serial, data["segment"].asString());
+    }
   }
-  return reports;
+  return segments;
 }
 
 Uptane::LazyTargetsList SotaUptaneClient::allTargets() const {
@@ -1431,19 +1667,21 @@ void SotaUptaneClient::checkAndUpdatePendingSecondaries() {
       LOG_INFO << "The pending update " << current_ecu_hash << " has been installed on " << pending_ecu.first;
       boost::optional<Uptane::Target> pending_version;
       if (storage->loadInstalledVersions(pending_ecu.first.ToString(), nullptr, &pending_version)) {
-        storage->saveEcuInstallationResult(pending_ecu.first,
-                                           data::InstallationResult(data::ResultCode::Numeric::kOk, ""));
+        storage->runInTransaction([this, &pending_ecu, &pending_version]() {
+          storage->saveEcuInstallationResult(pending_ecu.first,
+                                             data::InstallationResult(data::ResultCode::Numeric::kOk, ""));
+
+          storage->saveInstalledVersion(pending_ecu.first.ToString(), *pending_version,
+                                        InstalledVersionUpdateMode::kCurrent);
 
-        storage->saveInstalledVersion(pending_ecu.first.ToString(), *pending_version,
-                                      InstalledVersionUpdateMode::kCurrent);
+          data::InstallationResult ir;
+          std::string raw_report;
+          computeDeviceInstallationResult(&ir, &raw_report);
+          storage->storeDeviceInstallationResult(ir, raw_report, pending_version->correlation_id());
+        });
 
         report_queue->enqueue(std_::make_unique<EcuInstallationCompletedReport>(
             pending_ecu.first, pending_version->correlation_id(), true));
-
-        data::InstallationResult ir;
-        std::string raw_report;
-        computeDeviceInstallationResult(&ir, &raw_report);
-        storage->storeDeviceInstallationResult(ir, raw_report, pending_version->correlation_id());
       }
     }
   }
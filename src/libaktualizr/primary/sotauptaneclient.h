@@ -62,7 +62,8 @@ class SotaUptaneClient {
   result::Download downloadImages(const std::vector<Uptane::Target> &targets,
                                   const api::FlowControlToken *token = nullptr);
   std::pair<bool, Uptane::Target> downloadImage(const Uptane::Target &target,
-                                                const api::FlowControlToken *token = nullptr);
+                                                const api::FlowControlToken *token = nullptr,
+                                                result::DownloadMetrics *metrics = nullptr);
   void reportPause();
   void reportResume();
   void sendDeviceData(const Json::Value &custom_hwinfo = Json::nullValue);
@@ -127,7 +128,8 @@ class SotaUptaneClient {
   friend class CheckForUpdate;       // for load tests
   friend class ProvisionDeviceTask;  // for load tests
 
-  void uptaneIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count);
+  void uptaneIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count,
+                       result::MetadataMetrics *metrics = nullptr);
   void uptaneOfflineIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count);
   result::UpdateStatus checkUpdatesOffline(const std::vector<Uptane::Target> &targets);
   Json::Value AssembleManifest();
@@ -142,15 +144,20 @@ class SotaUptaneClient {
   void reportAktualizrConfiguration();
   bool waitSecondariesReachable(const std::vector<Uptane::Target> &updates);
   void storeInstallationFailure(const data::InstallationResult &result);
+  bool loadRootForSecondaries(std::string *root, Uptane::RepositoryType repo, int version);
   data::InstallationResult rotateSecondaryRoot(Uptane::RepositoryType repo, SecondaryInterface &secondary);
   void sendMetadataToEcus(const std::vector<Uptane::Target> &targets, data::InstallationResult *result,
                           std::string *raw_installation_report);
-  std::future<data::InstallationResult> sendFirmwareAsync(SecondaryInterface &secondary, const Uptane::Target &target);
+  data::InstallationResult sendFirmwareToSecondary(SecondaryInterface &secondary, const Uptane::Target &target,
+                                                   result::Install::EcuReport *report);
+  void readAheadTargetFile(const Uptane::Target &target) const;
+  std::map<Uptane::EcuSerial, std::string> secondarySegments() const;
   std::vector<result::Install::EcuReport> sendImagesToEcus(const std::vector<Uptane::Target> &targets);
 
   bool putManifestSimple(const Json::Value &custom = Json::nullValue);
   void getNewTargets(std::vector<Uptane::Target> *new_targets, unsigned int *ecus_count = nullptr);
-  void updateDirectorMeta();
+  void updateDirectorMeta(const Uptane::IMetadataFetcher &fetcher);
+  void updateImageMeta(const Uptane::IMetadataFetcher &fetcher);
   void checkDirectorMetaOffline();
   void computeDeviceInstallationResult(data::InstallationResult *result, std::string *raw_installation_report) const;
   std::unique_ptr<Uptane::Target> findTargetInDelegationTree(const Uptane::Target &target, bool offline);
@@ -187,6 +194,9 @@ class SotaUptaneClient {
   // ecu_serial => secondary*
   std::map<Uptane::EcuSerial, SecondaryInterface::Ptr> secondaries;
   std::mutex download_mutex;
+  // (repo, version) => Root metadata, shared by all Secondaries during one install
+  std::map<std::pair<int, int>, std::string> secondary_roots_;
+  std::mutex secondary_roots_mutex_;
   Uptane::EcuSerial primary_ecu_serial_;
   Uptane::HardwareIdentifier primary_ecu_hw_id_;
 };
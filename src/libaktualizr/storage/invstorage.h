@@ -1,6 +1,7 @@
 #ifndef INVSTORAGE_H_
 #define INVSTORAGE_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -145,6 +146,12 @@ class INvStorage {
 
   virtual void cleanUp() = 0;
 
+  // Run `fn` as a single unit of work: all the storage operations it performs
+  // from the calling thread are part of one transaction, committed once `fn`
+  // returns and rolled back if it throws. Other threads are kept waiting in the
+  // meantime, so `fn` must not wait on them.
+  virtual void runInTransaction(const std::function<void()>& fn) = 0;
+
   // Special constructors and utilities
   static std::shared_ptr<INvStorage> newStorage(const StorageConfig& config, bool readonly = false);
   static void FSSToSQLS(FSStorageRead& fs_storage, SQLStorage& sql_storage);
@@ -11,6 +11,7 @@
 #include <sqlite3.h>
 
 #include "logging/logging.h"
+#include "telemetry/metrics.h"
 
 // Unique ownership SQLite3 statement creation
 
@@ -157,12 +158,27 @@ class SQLite3Guard {
   explicit SQLite3Guard(const boost::filesystem::path& path, bool readonly = false,
                         std::shared_ptr<std::mutex> mutex = nullptr)
       : SQLite3Guard(path.c_str(), readonly, std::move(mutex)) {}
-  SQLite3Guard(SQLite3Guard&& guard) noexcept : handle_(std::move(guard.handle_)), rc_(guard.rc_) {}
+  SQLite3Guard(SQLite3Guard&& guard) noexcept
+      : handle_(std::move(guard.handle_)),
+        rc_(guard.rc_),
+        m_(std::move(guard.m_)),
+        borrowed_(guard.borrowed_),
+        savepoint_open_(guard.savepoint_open_) {
+    guard.savepoint_open_ = false;
+  }
   ~SQLite3Guard() {
+    if (savepoint_open_) {
+      exec("ROLLBACK TO SAVEPOINT nested_transaction; RELEASE SAVEPOINT nested_transaction;", nullptr, nullptr);
+    }
     if (m_) {
       m_->unlock();
     }
   }
+
+  // Use a connection owned by an enclosing transaction (see
+  // `SQLStorageBase::runInTransaction()`). The connection is neither locked nor
+  // closed, and transactions started on it are nested as savepoints.
+  static SQLite3Guard borrow(sqlite3* handle) { return SQLite3Guard(handle); }
   SQLite3Guard(const SQLite3Guard& guard) = delete;
   SQLite3Guard operator=(const SQLite3Guard& guard) = delete;
 
@@ -190,6 +206,14 @@ class SQLite3Guard {
   // rolled back
 
   void beginTransaction() {
+    if (borrowed_) {
+      if (exec("SAVEPOINT nested_transaction;", nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR << "Can't begin transaction: " << errmsg();
+        throw SQLInternalException(std::string("Can't begin transaction: ") + errmsg());
+      }
+      savepoint_open_ = true;
+      return;
+    }
     // Note: transaction cannot be nested and this will fail if another
     // transaction was open on the same connection
     if (exec("BEGIN TRANSACTION;", nullptr, nullptr) != SQLITE_OK) {
@@ -199,6 +223,15 @@ class SQLite3Guard {
   }
 
   void commitTransaction() {
+    if (borrowed_) {
+      if (exec("RELEASE SAVEPOINT nested_transaction;", nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR << "Can't commit transaction: " << errmsg();
+        throw SQLInternalException(std::string("Can't commit transaction: ") + errmsg());
+      }
+      savepoint_open_ = false;
+      return;
+    }
+    metrics::ScopedTimer timer("aktualizr_storage_transaction_duration_seconds", {});
     if (exec("COMMIT TRANSACTION;", nullptr, nullptr) != SQLITE_OK) {
       LOG_ERROR << "Can't commit transaction: " << errmsg();
       throw SQLInternalException(std::string("Can't begin transaction: ") + errmsg());
@@ -206,6 +239,15 @@ class SQLite3Guard {
   }
 
   void rollbackTransaction() {
+    if (borrowed_) {
+      if (exec("ROLLBACK TO SAVEPOINT nested_transaction; RELEASE SAVEPOINT nested_transaction;", nullptr,
+               nullptr) != SQLITE_OK) {
+        LOG_ERROR << "Can't rollback transaction: " << errmsg();
+        throw SQLInternalException(std::string("Can't rollback transaction: ") + errmsg());
+      }
+      savepoint_open_ = false;
+      return;
+    }
     if (exec("ROLLBACK TRANSACTION;", nullptr, nullptr) != SQLITE_OK) {
       LOG_ERROR << "Can't rollback transaction: " << errmsg();
       throw SQLInternalException(std::string("Can't begin transaction: ") + errmsg());
@@ -213,9 +255,14 @@ class SQLite3Guard {
   }
 
  private:
+  explicit SQLite3Guard(sqlite3* borrowed)
+      : handle_(borrowed, [](sqlite3*) { return SQLITE_OK; }), rc_(SQLITE_OK), borrowed_(true) {}
+
   std::unique_ptr<sqlite3, int (*)(sqlite3*)> handle_;
   int rc_;
   std::shared_ptr<std::mutex> m_ = nullptr;
+  bool borrowed_{false};
+  bool savepoint_open_{false};
 };
 
 #endif  // SQL_UTILS_H_
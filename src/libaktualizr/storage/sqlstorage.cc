@@ -9,10 +9,12 @@
 
 #include "logging/logging.h"
 #include "sql_utils.h"
+#include "telemetry/tracing.h"
 #include "utilities/utils.h"
 
 // Find metadata with version set to -1 (e.g. after migration) and assign proper version to it.
 void SQLStorage::cleanMetaVersion(Uptane::RepositoryType repo, const Uptane::Role& role) {
+  TRACE_SPAN("SQLStorage::cleanMetaVersion");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -72,6 +74,7 @@ SQLStorage::SQLStorage(const StorageConfig& config, bool readonly)
 }
 
 void SQLStorage::storePrimaryKeys(const std::string& public_key, const std::string& private_key) {
+  TRACE_SPAN("SQLStorage::storePrimaryKeys");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string>(
@@ -83,10 +86,12 @@ void SQLStorage::storePrimaryKeys(const std::string& public_key, const std::stri
 }
 
 bool SQLStorage::loadPrimaryKeys(std::string* public_key, std::string* private_key) const {
+  TRACE_SPAN("SQLStorage::loadPrimaryKeys");
   return loadPrimaryPublic(public_key) && loadPrimaryPrivate(private_key);
 }
 
 bool SQLStorage::loadPrimaryPublic(std::string* public_key) const {
+  TRACE_SPAN("SQLStorage::loadPrimaryPublic");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT public FROM primary_keys LIMIT 1;");
@@ -113,6 +118,7 @@ bool SQLStorage::loadPrimaryPublic(std::string* public_key) const {
 }
 
 bool SQLStorage::loadPrimaryPrivate(std::string* private_key) const {
+  TRACE_SPAN("SQLStorage::loadPrimaryPrivate");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT private FROM primary_keys LIMIT 1;");
@@ -139,6 +145,7 @@ bool SQLStorage::loadPrimaryPrivate(std::string* private_key) const {
 }
 
 void SQLStorage::clearPrimaryKeys() {
+  TRACE_SPAN("SQLStorage::clearPrimaryKeys");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM primary_keys;", nullptr, nullptr) != SQLITE_OK) {
@@ -149,6 +156,7 @@ void SQLStorage::clearPrimaryKeys() {
 
 void SQLStorage::saveSecondaryInfo(const Uptane::EcuSerial& ecu_serial, const std::string& sec_type,
                                    const PublicKey& public_key) {
+  TRACE_SPAN("SQLStorage::saveSecondaryInfo");
   SQLite3Guard db = dbConnection();
 
   std::stringstream key_type_ss;
@@ -184,6 +192,7 @@ void SQLStorage::saveSecondaryInfo(const Uptane::EcuSerial& ecu_serial, const st
 }
 
 void SQLStorage::saveSecondaryData(const Uptane::EcuSerial& ecu_serial, const std::string& data) {
+  TRACE_SPAN("SQLStorage::saveSecondaryData");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -210,6 +219,7 @@ void SQLStorage::saveSecondaryData(const Uptane::EcuSerial& ecu_serial, const st
 }
 
 bool SQLStorage::loadSecondaryInfo(const Uptane::EcuSerial& ecu_serial, SecondaryInfo* secondary) const {
+  TRACE_SPAN("SQLStorage::loadSecondaryInfo");
   SQLite3Guard db = dbConnection();
 
   SecondaryInfo new_sec{};
@@ -253,6 +263,7 @@ bool SQLStorage::loadSecondaryInfo(const Uptane::EcuSerial& ecu_serial, Secondar
 }
 
 bool SQLStorage::loadSecondariesInfo(std::vector<SecondaryInfo>* secondaries) const {
+  TRACE_SPAN("SQLStorage::loadSecondariesInfo");
   SQLite3Guard db = dbConnection();
 
   std::vector<SecondaryInfo> new_secs;
@@ -295,12 +306,14 @@ bool SQLStorage::loadSecondariesInfo(std::vector<SecondaryInfo>* secondaries) co
 }
 
 void SQLStorage::storeTlsCreds(const std::string& ca, const std::string& cert, const std::string& pkey) {
+  TRACE_SPAN("SQLStorage::storeTlsCreds");
   storeTlsCa(ca);
   storeTlsCert(cert);
   storeTlsPkey(pkey);
 }
 
 void SQLStorage::storeTlsCa(const std::string& ca) {
+  TRACE_SPAN("SQLStorage::storeTlsCa");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -328,6 +341,7 @@ void SQLStorage::storeTlsCa(const std::string& ca) {
 }
 
 void SQLStorage::storeTlsCert(const std::string& cert) {
+  TRACE_SPAN("SQLStorage::storeTlsCert");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -355,6 +369,7 @@ void SQLStorage::storeTlsCert(const std::string& cert) {
 }
 
 void SQLStorage::storeTlsPkey(const std::string& pkey) {
+  TRACE_SPAN("SQLStorage::storeTlsPkey");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -382,6 +397,7 @@ void SQLStorage::storeTlsPkey(const std::string& pkey) {
 }
 
 bool SQLStorage::loadTlsCreds(std::string* ca, std::string* cert, std::string* pkey) const {
+  TRACE_SPAN("SQLStorage::loadTlsCreds");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT ca_cert, client_cert, client_pkey FROM tls_creds LIMIT 1;");
@@ -420,6 +436,7 @@ bool SQLStorage::loadTlsCreds(std::string* ca, std::string* cert, std::string* p
 }
 
 void SQLStorage::clearTlsCreds() {
+  TRACE_SPAN("SQLStorage::clearTlsCreds");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM tls_creds;", nullptr, nullptr) != SQLITE_OK) {
@@ -429,6 +446,7 @@ void SQLStorage::clearTlsCreds() {
 }
 
 bool SQLStorage::loadTlsCa(std::string* ca) const {
+  TRACE_SPAN("SQLStorage::loadTlsCa");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT ca_cert FROM tls_creds LIMIT 1;");
@@ -455,6 +473,7 @@ bool SQLStorage::loadTlsCa(std::string* ca) const {
 }
 
 bool SQLStorage::loadTlsCert(std::string* cert) const {
+  TRACE_SPAN("SQLStorage::loadTlsCert");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT client_cert FROM tls_creds LIMIT 1;");
@@ -481,6 +500,7 @@ bool SQLStorage::loadTlsCert(std::string* cert) const {
 }
 
 bool SQLStorage::loadTlsPkey(std::string* pkey) const {
+  TRACE_SPAN("SQLStorage::loadTlsPkey");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT client_pkey FROM tls_creds LIMIT 1;");
@@ -507,6 +527,7 @@ bool SQLStorage::loadTlsPkey(std::string* pkey) const {
 }
 
 void SQLStorage::storeRoot(const std::string& data, Uptane::RepositoryType repo, Uptane::Version version) {
+  TRACE_SPAN("SQLStorage::storeRoot");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -533,6 +554,7 @@ void SQLStorage::storeRoot(const std::string& data, Uptane::RepositoryType repo,
 }
 
 void SQLStorage::storeNonRoot(const std::string& data, Uptane::RepositoryType repo, const Uptane::Role role) {
+  TRACE_SPAN("SQLStorage::storeNonRoot");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -558,6 +580,7 @@ void SQLStorage::storeNonRoot(const std::string& data, Uptane::RepositoryType re
 }
 
 bool SQLStorage::loadRoot(std::string* data, Uptane::RepositoryType repo, Uptane::Version version) const {
+  TRACE_SPAN("SQLStorage::loadRoot");
   SQLite3Guard db = dbConnection();
 
   // version < 0 => latest metadata requested
@@ -607,6 +630,7 @@ bool SQLStorage::loadRoot(std::string* data, Uptane::RepositoryType repo, Uptane
 }
 
 bool SQLStorage::loadNonRoot(std::string* data, Uptane::RepositoryType repo, const Uptane::Role role) const {
+  TRACE_SPAN("SQLStorage::loadNonRoot");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<int, int>(
@@ -629,6 +653,7 @@ bool SQLStorage::loadNonRoot(std::string* data, Uptane::RepositoryType repo, con
 }
 
 void SQLStorage::clearNonRootMeta(Uptane::RepositoryType repo) {
+  TRACE_SPAN("SQLStorage::clearNonRootMeta");
   SQLite3Guard db = dbConnection();
 
   auto del_statement =
@@ -640,6 +665,7 @@ void SQLStorage::clearNonRootMeta(Uptane::RepositoryType repo) {
 }
 
 void SQLStorage::clearMetadata() {
+  TRACE_SPAN("SQLStorage::clearMetadata");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM meta;", nullptr, nullptr) != SQLITE_OK) {
@@ -649,6 +675,7 @@ void SQLStorage::clearMetadata() {
 }
 
 void SQLStorage::storeDelegation(const std::string& data, const Uptane::Role role) {
+  TRACE_SPAN("SQLStorage::storeDelegation");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<SQLBlob, std::string>("INSERT OR REPLACE INTO delegations VALUES (?, ?);",
@@ -660,6 +687,7 @@ void SQLStorage::storeDelegation(const std::string& data, const Uptane::Role rol
 }
 
 bool SQLStorage::loadDelegation(std::string* data, const Uptane::Role role) const {
+  TRACE_SPAN("SQLStorage::loadDelegation");
   SQLite3Guard db = dbConnection();
 
   auto statement =
@@ -681,6 +709,7 @@ bool SQLStorage::loadDelegation(std::string* data, const Uptane::Role role) cons
 }
 
 bool SQLStorage::loadAllDelegations(std::vector<std::pair<Uptane::Role, std::string>>& data) const {
+  TRACE_SPAN("SQLStorage::loadAllDelegations");
   bool result = false;
 
   try {
@@ -716,6 +745,7 @@ bool SQLStorage::loadAllDelegations(std::vector<std::pair<Uptane::Role, std::str
 }
 
 void SQLStorage::deleteDelegation(const Uptane::Role role) {
+  TRACE_SPAN("SQLStorage::deleteDelegation");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string>("DELETE FROM delegations WHERE role_name=?;", role.ToString());
@@ -723,6 +753,7 @@ void SQLStorage::deleteDelegation(const Uptane::Role role) {
 }
 
 void SQLStorage::clearDelegations() {
+  TRACE_SPAN("SQLStorage::clearDelegations");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM delegations;", nullptr, nullptr) != SQLITE_OK) {
@@ -731,6 +762,7 @@ void SQLStorage::clearDelegations() {
 }
 
 void SQLStorage::storeDeviceId(const std::string& device_id) {
+  TRACE_SPAN("SQLStorage::storeDeviceId");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string>(
@@ -742,6 +774,7 @@ void SQLStorage::storeDeviceId(const std::string& device_id) {
 }
 
 bool SQLStorage::loadDeviceId(std::string* device_id) const {
+  TRACE_SPAN("SQLStorage::loadDeviceId");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT device_id FROM device_info LIMIT 1;");
@@ -769,6 +802,7 @@ bool SQLStorage::loadDeviceId(std::string* device_id) const {
 }
 
 void SQLStorage::clearDeviceId() {
+  TRACE_SPAN("SQLStorage::clearDeviceId");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM device_info;", nullptr, nullptr) != SQLITE_OK) {
@@ -778,6 +812,7 @@ void SQLStorage::clearDeviceId() {
 }
 
 void SQLStorage::storeEcuRegistered() {
+  TRACE_SPAN("SQLStorage::storeEcuRegistered");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -800,6 +835,7 @@ void SQLStorage::storeEcuRegistered() {
 }
 
 bool SQLStorage::loadEcuRegistered() const {
+  TRACE_SPAN("SQLStorage::loadEcuRegistered");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT is_registered FROM device_info LIMIT 1;");
@@ -817,6 +853,7 @@ bool SQLStorage::loadEcuRegistered() const {
 }
 
 void SQLStorage::clearEcuRegistered() {
+  TRACE_SPAN("SQLStorage::clearEcuRegistered");
   SQLite3Guard db = dbConnection();
 
   // note: if the table is empty, nothing is done but that's fine
@@ -828,6 +865,7 @@ void SQLStorage::clearEcuRegistered() {
 }
 
 void SQLStorage::storeNeedReboot() {
+  TRACE_SPAN("SQLStorage::storeNeedReboot");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<int>("INSERT OR REPLACE INTO need_reboot(unique_mark,flag) VALUES(0,?);", 1);
@@ -838,6 +876,7 @@ void SQLStorage::storeNeedReboot() {
 }
 
 bool SQLStorage::loadNeedReboot(bool* need_reboot) const {
+  TRACE_SPAN("SQLStorage::loadNeedReboot");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT flag FROM need_reboot LIMIT 1;");
@@ -862,6 +901,7 @@ bool SQLStorage::loadNeedReboot(bool* need_reboot) const {
 }
 
 void SQLStorage::clearNeedReboot() {
+  TRACE_SPAN("SQLStorage::clearNeedReboot");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM need_reboot;", nullptr, nullptr) != SQLITE_OK) {
@@ -871,6 +911,7 @@ void SQLStorage::clearNeedReboot() {
 }
 
 void SQLStorage::storeEcuSerials(const EcuSerials& serials) {
+  TRACE_SPAN("SQLStorage::storeEcuSerials");
   if (!serials.empty()) {
     SQLite3Guard db = dbConnection();
 
@@ -918,6 +959,7 @@ void SQLStorage::storeEcuSerials(const EcuSerials& serials) {
 }
 
 bool SQLStorage::loadEcuSerials(EcuSerials* serials) const {
+  TRACE_SPAN("SQLStorage::loadEcuSerials");
   SQLite3Guard db = dbConnection();
 
   // order by auto-incremented Primary key so that the ECU order is kept constant
@@ -949,6 +991,7 @@ bool SQLStorage::loadEcuSerials(EcuSerials* serials) const {
 }
 
 void SQLStorage::clearEcuSerials() {
+  TRACE_SPAN("SQLStorage::clearEcuSerials");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -967,6 +1010,7 @@ void SQLStorage::clearEcuSerials() {
 }
 
 void SQLStorage::storeCachedEcuManifest(const Uptane::EcuSerial& ecu_serial, const std::string& manifest) {
+  TRACE_SPAN("SQLStorage::storeCachedEcuManifest");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string, std::string>(
@@ -978,6 +1022,7 @@ void SQLStorage::storeCachedEcuManifest(const Uptane::EcuSerial& ecu_serial, con
 }
 
 bool SQLStorage::loadCachedEcuManifest(const Uptane::EcuSerial& ecu_serial, std::string* manifest) const {
+  TRACE_SPAN("SQLStorage::loadCachedEcuManifest");
   SQLite3Guard db = dbConnection();
 
   std::string stmanifest;
@@ -1004,6 +1049,7 @@ bool SQLStorage::loadCachedEcuManifest(const Uptane::EcuSerial& ecu_serial, std:
 }
 
 void SQLStorage::saveMisconfiguredEcu(const MisconfiguredEcu& ecu) {
+  TRACE_SPAN("SQLStorage::saveMisconfiguredEcu");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string, std::string, int>(
@@ -1015,6 +1061,7 @@ void SQLStorage::saveMisconfiguredEcu(const MisconfiguredEcu& ecu) {
 }
 
 bool SQLStorage::loadMisconfiguredEcus(std::vector<MisconfiguredEcu>* ecus) const {
+  TRACE_SPAN("SQLStorage::loadMisconfiguredEcus");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT serial, hardware_id, state FROM misconfigured_ecus;");
@@ -1046,6 +1093,7 @@ bool SQLStorage::loadMisconfiguredEcus(std::vector<MisconfiguredEcu>* ecus) cons
 }
 
 void SQLStorage::clearMisconfiguredEcus() {
+  TRACE_SPAN("SQLStorage::clearMisconfiguredEcus");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM misconfigured_ecus;", nullptr, nullptr) != SQLITE_OK) {
@@ -1056,6 +1104,7 @@ void SQLStorage::clearMisconfiguredEcus() {
 
 void SQLStorage::saveInstalledVersion(const std::string& ecu_serial, const Uptane::Target& target,
                                       InstalledVersionUpdateMode update_mode) {
+  TRACE_SPAN("SQLStorage::saveInstalledVersion");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -1144,38 +1193,58 @@ void SQLStorage::saveInstalledVersion(const std::string& ecu_serial, const Uptan
     }
   }
 
+  // drop the oldest entries beyond the configured limit, but never the
+  // current or pending version
+  if (config_.installation_log_limit > 0) {
+    auto statement = db.prepareStatement<std::string, std::string, int64_t>(
+        "DELETE FROM installed_versions WHERE ecu_serial = ? AND is_current = 0 AND is_pending = 0 AND id NOT IN "
+        "(SELECT id FROM installed_versions WHERE ecu_serial = ? ORDER BY id DESC LIMIT ?);",
+        ecu_serial_real, ecu_serial_real, static_cast<int64_t>(config_.installation_log_limit));
+
+    if (statement.step() != SQLITE_DONE) {
+      LOG_ERROR << "Failed to trim installed versions: " << db.errmsg();
+      return;
+    }
+  }
+
   db.commitTransaction();
 }
 
+// One query either way: the serial is UNIQUE and hence indexed, and there is a
+// single Primary, so neither lookup scans the (small) ecus table.
 static void loadEcuMap(SQLite3Guard& db, std::string& ecu_serial, Uptane::EcuMap& ecu_map) {
   // The Secondary only knows about itself and in its database it is considered
   // a Primary, for better or worse.
   if (ecu_serial.empty()) {
-    auto statement = db.prepareStatement("SELECT serial FROM ecus WHERE is_primary = 1;");
-    if (statement.step() == SQLITE_ROW) {
+    auto statement = db.prepareStatement("SELECT serial, hardware_id FROM ecus WHERE is_primary = 1;");
+    const int result = statement.step();
+    if (result == SQLITE_ROW) {
       ecu_serial = statement.get_result_col_str(0).value();
-    } else if (statement.step() == SQLITE_DONE) {
+      ecu_map.insert(
+          {Uptane::EcuSerial(ecu_serial), Uptane::HardwareIdentifier(statement.get_result_col_str(1).value())});
+    } else if (result == SQLITE_DONE) {
       LOG_DEBUG << "No serial found in database for this ECU, defaulting to empty serial";
     } else {
       LOG_ERROR << "Error getting serial for this ECU, defaulting to empty serial: " << db.errmsg();
     }
+    return;
   }
 
-  if (!ecu_serial.empty()) {
-    auto statement = db.prepareStatement<std::string>("SELECT hardware_id FROM ecus WHERE serial = ?;", ecu_serial);
-    if (statement.step() == SQLITE_ROW) {
-      ecu_map.insert(
-          {Uptane::EcuSerial(ecu_serial), Uptane::HardwareIdentifier(statement.get_result_col_str(0).value())});
-    } else if (statement.step() == SQLITE_DONE) {
-      LOG_DEBUG << "No hardware ID found in database for ECU serial " << ecu_serial;
-    } else {
-      LOG_ERROR << "Error getting hardware ID for ECU serial " << ecu_serial << ": " << db.errmsg();
-    }
+  auto statement = db.prepareStatement<std::string>("SELECT hardware_id FROM ecus WHERE serial = ?;", ecu_serial);
+  const int result = statement.step();
+  if (result == SQLITE_ROW) {
+    ecu_map.insert(
+        {Uptane::EcuSerial(ecu_serial), Uptane::HardwareIdentifier(statement.get_result_col_str(0).value())});
+  } else if (result == SQLITE_DONE) {
+    LOG_DEBUG << "No hardware ID found in database for ECU serial " << ecu_serial;
+  } else {
+    LOG_ERROR << "Error getting hardware ID for ECU serial " << ecu_serial << ": " << db.errmsg();
   }
 }
 
 bool SQLStorage::loadInstallationLog(const std::string& ecu_serial, std::vector<Uptane::Target>* log,
                                      bool only_installed) const {
+  TRACE_SPAN("SQLStorage::loadInstallationLog");
   SQLite3Guard db = dbConnection();
 
   std::string ecu_serial_real = ecu_serial;
@@ -1255,6 +1324,7 @@ bool SQLStorage::loadInstallationLog(const std::string& ecu_serial, std::vector<
 
 bool SQLStorage::loadInstalledVersions(const std::string& ecu_serial, boost::optional<Uptane::Target>* current_version,
                                        boost::optional<Uptane::Target>* pending_version) const {
+  TRACE_SPAN("SQLStorage::loadInstalledVersions");
   SQLite3Guard db = dbConnection();
 
   std::string ecu_serial_real = ecu_serial;
@@ -1336,6 +1406,7 @@ bool SQLStorage::loadInstalledVersions(const std::string& ecu_serial, boost::opt
 }
 
 bool SQLStorage::hasPendingInstall() {
+  TRACE_SPAN("SQLStorage::hasPendingInstall");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT count(*) FROM installed_versions where is_pending = 1");
@@ -1348,6 +1419,7 @@ bool SQLStorage::hasPendingInstall() {
 }
 
 void SQLStorage::getPendingEcus(std::vector<std::pair<Uptane::EcuSerial, Hash>>* pendingEcus) {
+  TRACE_SPAN("SQLStorage::getPendingEcus");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement("SELECT ecu_serial, sha256 FROM installed_versions where is_pending = 1");
@@ -1375,6 +1447,7 @@ void SQLStorage::getPendingEcus(std::vector<std::pair<Uptane::EcuSerial, Hash>>*
 }
 
 void SQLStorage::clearInstalledVersions() {
+  TRACE_SPAN("SQLStorage::clearInstalledVersions");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM installed_versions;", nullptr, nullptr) != SQLITE_OK) {
@@ -1385,6 +1458,7 @@ void SQLStorage::clearInstalledVersions() {
 
 void SQLStorage::saveEcuInstallationResult(const Uptane::EcuSerial& ecu_serial,
                                            const data::InstallationResult& result) {
+  TRACE_SPAN("SQLStorage::saveEcuInstallationResult");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string, int, std::string, std::string>(
@@ -1399,6 +1473,7 @@ void SQLStorage::saveEcuInstallationResult(const Uptane::EcuSerial& ecu_serial,
 
 bool SQLStorage::loadEcuInstallationResults(
     std::vector<std::pair<Uptane::EcuSerial, data::InstallationResult>>* results) const {
+  TRACE_SPAN("SQLStorage::loadEcuInstallationResults");
   SQLite3Guard db = dbConnection();
 
   std::vector<std::pair<Uptane::EcuSerial, data::InstallationResult>> ecu_res;
@@ -1440,6 +1515,7 @@ bool SQLStorage::loadEcuInstallationResults(
 
 void SQLStorage::storeDeviceInstallationResult(const data::InstallationResult& result, const std::string& raw_report,
                                                const std::string& correlation_id) {
+  TRACE_SPAN("SQLStorage::storeDeviceInstallationResult");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<int, std::string, std::string, std::string, std::string>(
@@ -1454,6 +1530,7 @@ void SQLStorage::storeDeviceInstallationResult(const data::InstallationResult& r
 }
 
 bool SQLStorage::storeDeviceInstallationRawReport(const std::string& raw_report) {
+  TRACE_SPAN("SQLStorage::storeDeviceInstallationRawReport");
   SQLite3Guard db = dbConnection();
   auto statement = db.prepareStatement<std::string>("UPDATE device_installation_result SET raw_report=?;", raw_report);
   if (statement.step() != SQLITE_DONE || sqlite3_changes(db.get()) != 1) {
@@ -1465,6 +1542,7 @@ bool SQLStorage::storeDeviceInstallationRawReport(const std::string& raw_report)
 
 bool SQLStorage::loadDeviceInstallationResult(data::InstallationResult* result, std::string* raw_report,
                                               std::string* correlation_id) const {
+  TRACE_SPAN("SQLStorage::loadDeviceInstallationResult");
   SQLite3Guard db = dbConnection();
 
   data::InstallationResult dev_res;
@@ -1510,6 +1588,7 @@ bool SQLStorage::loadDeviceInstallationResult(data::InstallationResult* result,
 }
 
 void SQLStorage::saveEcuReportCounter(const Uptane::EcuSerial& ecu_serial, const int64_t counter) {
+  TRACE_SPAN("SQLStorage::saveEcuReportCounter");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string, int64_t>(
@@ -1523,6 +1602,7 @@ void SQLStorage::saveEcuReportCounter(const Uptane::EcuSerial& ecu_serial, const
 }
 
 bool SQLStorage::loadEcuReportCounter(std::vector<std::pair<Uptane::EcuSerial, int64_t>>* results) const {
+  TRACE_SPAN("SQLStorage::loadEcuReportCounter");
   SQLite3Guard db = dbConnection();
 
   std::vector<std::pair<Uptane::EcuSerial, int64_t>> ecu_cnt;
@@ -1561,6 +1641,7 @@ bool SQLStorage::loadEcuReportCounter(std::vector<std::pair<Uptane::EcuSerial, i
 }
 
 void SQLStorage::saveReportEvent(const Json::Value& json_value) {
+  TRACE_SPAN("SQLStorage::saveReportEvent");
   std::string json_string = Utils::jsonToCanonicalStr(json_value);
   SQLite3Guard db = dbConnection();
   auto statement = db.prepareStatement<std::string>(
@@ -1572,6 +1653,7 @@ void SQLStorage::saveReportEvent(const Json::Value& json_value) {
 }
 
 bool SQLStorage::loadReportEvents(Json::Value* report_array, int64_t* id_max) const {
+  TRACE_SPAN("SQLStorage::loadReportEvents");
   SQLite3Guard db = dbConnection();
   auto statement = db.prepareStatement("SELECT id, json_string FROM report_events;");
   int statement_result = statement.step();
@@ -1606,6 +1688,7 @@ bool SQLStorage::loadReportEvents(Json::Value* report_array, int64_t* id_max) co
 }
 
 void SQLStorage::deleteReportEvents(int64_t id_max) {
+  TRACE_SPAN("SQLStorage::deleteReportEvents");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<int64_t>("DELETE FROM report_events WHERE id <= ?;", id_max);
@@ -1615,6 +1698,7 @@ void SQLStorage::deleteReportEvents(int64_t id_max) {
 }
 
 void SQLStorage::clearInstallationResults() {
+  TRACE_SPAN("SQLStorage::clearInstallationResults");
   SQLite3Guard db = dbConnection();
 
   db.beginTransaction();
@@ -1633,6 +1717,7 @@ void SQLStorage::clearInstallationResults() {
 }
 
 void SQLStorage::storeDeviceDataHash(const std::string& data_type, const std::string& hash) {
+  TRACE_SPAN("SQLStorage::storeDeviceDataHash");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string, std::string>(
@@ -1644,6 +1729,7 @@ void SQLStorage::storeDeviceDataHash(const std::string& data_type, const std::st
 }
 
 bool SQLStorage::loadDeviceDataHash(const std::string& data_type, std::string* hash) const {
+  TRACE_SPAN("SQLStorage::loadDeviceDataHash");
   SQLite3Guard db = dbConnection();
 
   auto statement =
@@ -1666,6 +1752,7 @@ bool SQLStorage::loadDeviceDataHash(const std::string& data_type, std::string* h
 }
 
 void SQLStorage::clearDeviceData() {
+  TRACE_SPAN("SQLStorage::clearDeviceData");
   SQLite3Guard db = dbConnection();
 
   if (db.exec("DELETE FROM device_data;", nullptr, nullptr) != SQLITE_OK) {
@@ -1675,6 +1762,7 @@ void SQLStorage::clearDeviceData() {
 }
 
 void SQLStorage::storeTargetFilename(const std::string& targetname, const std::string& filename) const {
+  TRACE_SPAN("SQLStorage::storeTargetFilename");
   SQLite3Guard db = dbConnection();
   auto statement = db.prepareStatement<std::string, std::string>(
       "INSERT OR REPLACE INTO target_images (targetname, filename) VALUES (?, ?);", targetname, filename);
@@ -1686,6 +1774,7 @@ void SQLStorage::storeTargetFilename(const std::string& targetname, const std::s
 }
 
 std::string SQLStorage::getTargetFilename(const std::string& targetname) const {
+  TRACE_SPAN("SQLStorage::getTargetFilename");
   SQLite3Guard db = dbConnection();
 
   auto statement =
@@ -1702,6 +1791,7 @@ std::string SQLStorage::getTargetFilename(const std::string& targetname) const {
 }
 
 std::vector<std::string> SQLStorage::getAllTargetNames() const {
+  TRACE_SPAN("SQLStorage::getAllTargetNames");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<>("SELECT targetname FROM target_images;");
@@ -1721,6 +1811,7 @@ std::vector<std::string> SQLStorage::getAllTargetNames() const {
 }
 
 void SQLStorage::deleteTargetInfo(const std::string& targetname) const {
+  TRACE_SPAN("SQLStorage::deleteTargetInfo");
   SQLite3Guard db = dbConnection();
 
   auto statement = db.prepareStatement<std::string>("DELETE FROM target_images WHERE targetname=?;", targetname);
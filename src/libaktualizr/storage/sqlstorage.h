@@ -107,6 +107,8 @@ class SQLStorage : public SQLStorageBase, public INvStorage {
   void deleteTargetInfo(const std::string& targetname) const override;
 
   void cleanUp() override;
+
+  void runInTransaction(const std::function<void()>& fn) override { SQLStorageBase::runInTransaction(fn); }
   StorageType type() override { return StorageType::kSqlite; };
 
  private:
@@ -3,6 +3,7 @@
 
 #include <sys/stat.h>
 
+#include "telemetry/metrics.h"
 #include "utilities/utils.h"
 
 boost::filesystem::path SQLStorageBase::dbPath() const { return sqldb_path_; }
@@ -76,7 +77,37 @@ SQLStorageBase::SQLStorageBase(boost::filesystem::path sqldb_path, bool readonly
   }
 }
 
+void SQLStorageBase::runInTransaction(const std::function<void()>& fn) {
+  if (transaction_thread_ == std::this_thread::get_id()) {
+    // already part of a transaction on this thread
+    fn();
+    return;
+  }
+
+  std::unique_ptr<SQLite3Guard> db(new SQLite3Guard(dbConnection()));
+  db->beginTransaction();
+  transaction_db_ = std::move(db);
+  transaction_thread_ = std::this_thread::get_id();
+
+  try {
+    fn();
+  } catch (...) {
+    transaction_thread_ = std::thread::id();
+    // closing the connection rolls the transaction back
+    transaction_db_.reset();
+    throw;
+  }
+
+  transaction_thread_ = std::thread::id();
+  db = std::move(transaction_db_);
+  db->commitTransaction();
+}
+
 SQLite3Guard SQLStorageBase::dbConnection() const {
+  metrics::Registry::get().increment("aktualizr_storage_operations_total");
+  if (transaction_thread_ == std::this_thread::get_id()) {
+    return SQLite3Guard::borrow(transaction_db_->get());
+  }
   SQLite3Guard db(dbPath(), readonly_, mutex_);
   if (db.get_rc() != SQLITE_OK) {
     throw SQLInternalException(std::string("Can't open database: ") + db.errmsg());
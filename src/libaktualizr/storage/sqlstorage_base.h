@@ -1,6 +1,10 @@
 #ifndef SQLSTORAGE_BASE_H_
 #define SQLSTORAGE_BASE_H_
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #include <boost/filesystem.hpp>
 #include <boost/interprocess/sync/file_lock.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
@@ -42,6 +46,7 @@ class SQLStorageBase {
   bool dbMigrate();
   DbVersion getVersion();  // non-negative integer on success or -1 on error
   boost::filesystem::path dbPath() const;
+  void runInTransaction(const std::function<void()> &fn);
 
  protected:
   boost::filesystem::path sqldb_path_;
@@ -55,6 +60,10 @@ class SQLStorageBase {
   const std::string current_schema_;
   const int current_schema_version_;
 
+  // connection and thread of the transaction run by runInTransaction(), if any
+  std::unique_ptr<SQLite3Guard> transaction_db_;
+  std::atomic<std::thread::id> transaction_thread_{std::thread::id()};
+
   SQLite3Guard dbConnection() const;
   bool dbInsertBackMigrations(SQLite3Guard &db, int version_latest);
 };
@@ -16,7 +16,16 @@ typedef boost::tokenizer<boost::char_separator<char> > sql_tokenizer;
 static std::map<std::string, std::string> parseSchema() {
   std::map<std::string, std::string> result;
   std::vector<std::string> tokens;
-  enum { STATE_INIT, STATE_CREATE, STATE_INSERT, STATE_TABLE, STATE_NAME, STATE_TRIGGER, STATE_TRIGGER_END };
+  enum {
+    STATE_INIT,
+    STATE_CREATE,
+    STATE_INSERT,
+    STATE_INDEX,
+    STATE_TABLE,
+    STATE_NAME,
+    STATE_TRIGGER,
+    STATE_TRIGGER_END
+  };
   boost::char_separator<char> sep(" \"\t\r\n", "(),;");
   std::string schema(libaktualizr_current_schema);
   sql_tokenizer tok(schema, sep);
@@ -46,11 +55,14 @@ static std::map<std::string, std::string> parseSchema() {
           parsing_state = STATE_TABLE;
         } else if (token == "TRIGGER") {
           parsing_state = STATE_TRIGGER;
+        } else if (token == "INDEX") {
+          parsing_state = STATE_INDEX;
         } else {
           return {};
         }
         break;
       case STATE_INSERT:
+      case STATE_INDEX:
         // do not take these into account
         if (token == ";") {
           key.clear();
@@ -224,6 +236,24 @@ TEST(sqlstorage, MigrationVersionCheck) {
   EXPECT_EQ(static_cast<int32_t>(storage.getVersion()), libaktualizr_schema_migrations.size() - 1);
 }
 
+/* Installed versions are looked up per ECU through indexes. */
+TEST(sqlstorage, InstalledVersionsIndexes) {
+  TemporaryDirectory temp_dir;
+  StorageConfig config;
+  config.path = temp_dir.Path();
+  SQLStorage storage(config, false);
+
+  SQLite3Guard db(config.sqldb_path.get(config.path).c_str());
+  auto statement = db.prepareStatement(
+      "SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='installed_versions' ORDER BY name;");
+  std::vector<std::string> indexes;
+  while (statement.step() == SQLITE_ROW) {
+    indexes.push_back(statement.get_result_col_str(0).value());
+  }
+  EXPECT_EQ(indexes, std::vector<std::string>({"installed_versions_current", "installed_versions_ecu_serial",
+                                               "installed_versions_pending"}));
+}
+
 /* Reject invalid SQL databases. */
 TEST(sqlstorage, WrongDatabaseCheck) {
   TemporaryDirectory temp_dir;
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <future>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -418,6 +421,130 @@ TEST(StorageCommon, LoadStoreInstalledVersions) {
   }
 }
 
+/* Limit the number of installed versions kept per ECU. */
+TEST(StorageCommon, InstallationLogLimit) {
+  TemporaryDirectory temp_dir;
+  StorageConfig storage_config;
+  storage_config.type = current_storage_type;
+  storage_config.path = temp_dir.Path();
+  storage_config.installation_log_limit = 2;
+  SQLStorage storage(storage_config, false);
+
+  EcuSerials serials{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")},
+                     {Uptane::EcuSerial("secondary_1"), Uptane::HardwareIdentifier("secondary_hw")}};
+  storage.storeEcuSerials(serials);
+
+  Uptane::EcuMap primary_ecu{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")}};
+  Uptane::Target t1{"update1.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2561"}}, 1};
+  Uptane::Target t2{"update2.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2562"}}, 2};
+  Uptane::Target t3{"update3.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2563"}}, 3};
+  Uptane::Target t4{"update4.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2564"}}, 4};
+  Uptane::EcuMap secondary_ecu{{Uptane::EcuSerial("secondary_1"), Uptane::HardwareIdentifier("secondary_hw")}};
+  Uptane::Target tsec{"secondary.bin", secondary_ecu, {Hash{Hash::Type::kSha256, "256s"}}, 5};
+
+  storage.saveInstalledVersion("secondary_1", tsec, InstalledVersionUpdateMode::kCurrent);
+  storage.saveInstalledVersion("primary", t1, InstalledVersionUpdateMode::kCurrent);
+  storage.saveInstalledVersion("primary", t2, InstalledVersionUpdateMode::kCurrent);
+  storage.saveInstalledVersion("primary", t3, InstalledVersionUpdateMode::kCurrent);
+  {
+    std::vector<Uptane::Target> log;
+    storage.loadInstallationLog("primary", &log, false);
+    ASSERT_EQ(log.size(), 2);
+    EXPECT_EQ(log[0].filename(), "update2.bin");
+    EXPECT_EQ(log[1].filename(), "update3.bin");
+  }
+
+  // The current version is kept even if it is older than the limit.
+  storage.saveInstalledVersion("primary", t1, InstalledVersionUpdateMode::kCurrent);
+  storage.saveInstalledVersion("primary", t4, InstalledVersionUpdateMode::kPending);
+  storage.saveInstalledVersion("primary", t2, InstalledVersionUpdateMode::kPending);
+  {
+    std::vector<Uptane::Target> log;
+    storage.loadInstallationLog("primary", &log, false);
+    ASSERT_EQ(log.size(), 3);
+    EXPECT_EQ(log[0].filename(), "update1.bin");
+    EXPECT_EQ(log[1].filename(), "update4.bin");
+    EXPECT_EQ(log[2].filename(), "update2.bin");
+
+    boost::optional<Uptane::Target> current;
+    boost::optional<Uptane::Target> pending;
+    EXPECT_TRUE(storage.loadInstalledVersions("primary", &current, &pending));
+    ASSERT_TRUE(!!current);
+    EXPECT_EQ(current->filename(), "update1.bin");
+    ASSERT_TRUE(!!pending);
+    EXPECT_EQ(pending->filename(), "update2.bin");
+  }
+
+  // Other ECUs are not affected.
+  {
+    std::vector<Uptane::Target> log;
+    storage.loadInstallationLog("secondary_1", &log, false);
+    ASSERT_EQ(log.size(), 1);
+    EXPECT_EQ(log[0].filename(), "secondary.bin");
+  }
+}
+
+/* Group several storage operations in one transaction. */
+TEST(StorageCommon, RunInTransaction) {
+  TemporaryDirectory temp_dir;
+  std::unique_ptr<INvStorage> storage = Storage(temp_dir.Path());
+
+  EcuSerials serials{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")},
+                     {Uptane::EcuSerial("secondary_1"), Uptane::HardwareIdentifier("secondary_hw")}};
+  storage->storeEcuSerials(serials);
+
+  Uptane::EcuMap primary_ecu{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")}};
+  Uptane::Target t1{"update1.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2561"}}, 1};
+  Uptane::Target t2{"update2.bin", primary_ecu, {Hash{Hash::Type::kSha256, "2562"}}, 2};
+
+  storage->runInTransaction([&storage, &t1]() {
+    storage->saveInstalledVersion("primary", t1, InstalledVersionUpdateMode::kCurrent);
+    storage->saveEcuInstallationResult(Uptane::EcuSerial("primary"), data::InstallationResult());
+    // nested units of work join the enclosing one
+    storage->runInTransaction([&storage]() {
+      storage->saveEcuInstallationResult(Uptane::EcuSerial("secondary_1"), data::InstallationResult());
+    });
+    // reading back from within the transaction sees its own changes
+    boost::optional<Uptane::Target> current;
+    EXPECT_TRUE(storage->loadInstalledVersions("primary", &current, nullptr));
+    ASSERT_TRUE(!!current);
+    EXPECT_EQ(current->filename(), "update1.bin");
+  });
+
+  std::vector<std::pair<Uptane::EcuSerial, data::InstallationResult>> res;
+  EXPECT_TRUE(storage->loadEcuInstallationResults(&res));
+  EXPECT_EQ(res.size(), 2);
+
+  // Everything is rolled back if the unit of work fails.
+  EXPECT_THROW(storage->runInTransaction([&storage, &t2]() {
+    storage->saveInstalledVersion("primary", t2, InstalledVersionUpdateMode::kCurrent);
+    storage->clearInstallationResults();
+    throw std::runtime_error("failure");
+  }),
+               std::runtime_error);
+
+  boost::optional<Uptane::Target> current;
+  EXPECT_TRUE(storage->loadInstalledVersions("primary", &current, nullptr));
+  ASSERT_TRUE(!!current);
+  EXPECT_EQ(current->filename(), "update1.bin");
+  EXPECT_TRUE(storage->loadEcuInstallationResults(&res));
+  EXPECT_EQ(res.size(), 2);
+
+  // Other threads wait for the transaction to finish.
+  std::future<size_t> other;
+  storage->runInTransaction([&storage, &other]() {
+    storage->clearInstallationResults();
+    other = std::async(std::launch::async, [&storage]() {
+      std::vector<std::pair<Uptane::EcuSerial, data::InstallationResult>> r;
+      storage->loadEcuInstallationResults(&r);
+      return r.size();
+    });
+    EXPECT_EQ(other.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+    storage->saveEcuInstallationResult(Uptane::EcuSerial("secondary_1"), data::InstallationResult());
+  });
+  EXPECT_EQ(other.get(), 1);
+}
+
 /*
  * Load and store an ECU installation result in an SQL database.
  * Load and store a device installation result in an SQL database.
@@ -5,6 +5,7 @@ void StorageConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt
   CopyFromConfig(type, "type", pt);
   CopyFromConfig(path, "path", pt);
   CopyFromConfig(sqldb_path, "sqldb_path", pt);
+  CopyFromConfig(installation_log_limit, "installation_log_limit", pt);
   CopyFromConfig(uptane_metadata_path, "uptane_metadata_path", pt);
   CopyFromConfig(uptane_private_key_path, "uptane_private_key_path", pt);
   CopyFromConfig(uptane_public_key_path, "uptane_public_key_path", pt);
@@ -17,6 +18,7 @@ void StorageConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, type, "type");
   writeOption(out_stream, path, "path");
   writeOption(out_stream, sqldb_path.get(""), "sqldb_path");
+  writeOption(out_stream, installation_log_limit, "installation_log_limit");
   writeOption(out_stream, uptane_metadata_path.get(""), "uptane_metadata_path");
   writeOption(out_stream, uptane_private_key_path.get(""), "uptane_private_key_path");
   writeOption(out_stream, uptane_public_key_path.get(""), "uptane_public_key_path");
@@ -0,0 +1,212 @@
+#include "metrics.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+namespace metrics {
+
+const std::vector<double> Registry::kDurationBuckets{0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+                                                     1,     2.5,  5,     10,   30,  60};
+
+// Descriptions of the metrics libaktualizr exports itself.
+static const std::map<std::string, std::string> kHelp{
+    {"aktualizr_http_requests_total", "HTTP requests by endpoint and status code"},
+    {"aktualizr_http_request_duration_seconds", "Duration of HTTP requests by endpoint"},
+    {"aktualizr_storage_operations_total", "Storage operations, by database connection"},
+    {"aktualizr_storage_transaction_duration_seconds", "Duration of storage transaction commits"},
+    {"aktualizr_command_queue_depth", "Commands waiting in the API command queue"},
+    {"aktualizr_report_queue_depth", "Events waiting to be sent to the server"},
+    {"aktualizr_secondary_rpc_duration_seconds", "Duration of RPCs to IP Secondaries by method and result"},
+};
+
+Registry &Registry::get() {
+  static Registry registry;
+  return registry;
+}
+
+Registry::Series &Registry::series(const std::string &name, Type type, const Labels &labels) {
+  auto family_it = families_.find(name);
+  if (family_it == families_.end()) {
+    family_it = families_.emplace(name, Family{type, {}}).first;
+  }
+  Series &s = family_it->second.series[labels];
+  if (type == Type::kHistogram && s.buckets.empty()) {
+    s.buckets.resize(kDurationBuckets.size(), 0);
+  }
+  return s;
+}
+
+void Registry::increment(const std::string &name, const Labels &labels, double value) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_);
+  series(name, Type::kCounter, labels).value += value;
+}
+
+void Registry::setGauge(const std::string &name, const Labels &labels, double value) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_);
+  series(name, Type::kGauge, labels).value = value;
+}
+
+void Registry::addGauge(const std::string &name, const Labels &labels, double value) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_);
+  series(name, Type::kGauge, labels).value += value;
+}
+
+void Registry::observe(const std::string &name, const Labels &labels, double seconds) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_);
+  Series &s = series(name, Type::kHistogram, labels);
+  for (size_t i = 0; i < kDurationBuckets.size(); ++i) {
+    if (seconds <= kDurationBuckets[i]) {
+      ++s.buckets[i];
+    }
+  }
+  s.sum += seconds;
+  ++s.count;
+}
+
+void Registry::clear() {
+  std::lock_guard<std::mutex> guard(m_);
+  families_.clear();
+}
+
+static std::string formatValue(double value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.12g", value);
+  return buf;
+}
+
+static std::string escapeLabelValue(const std::string &value) {
+  std::string out;
+  out.reserve(value.size());
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+static void writeLabels(std::ostream &os, const Labels &labels) {
+  if (labels.empty()) {
+    return;
+  }
+  os << '{';
+  bool first = true;
+  for (const auto &label : labels) {
+    if (!first) {
+      os << ',';
+    }
+    first = false;
+    os << label.first << "=\"" << escapeLabelValue(label.second) << '"';
+  }
+  os << '}';
+}
+
+std::string Registry::renderPrometheus() const {
+  std::ostringstream os;
+  std::lock_guard<std::mutex> guard(m_);
+  for (const auto &family_it : families_) {
+    const std::string &name = family_it.first;
+    const Family &family = family_it.second;
+    const auto help = kHelp.find(name);
+    if (help != kHelp.end()) {
+      os << "# HELP " << name << " " << help->second << "\n";
+    }
+    switch (family.type) {
+      case Type::kCounter:
+        os << "# TYPE " << name << " counter\n";
+        break;
+      case Type::kGauge:
+        os << "# TYPE " << name << " gauge\n";
+        break;
+      case Type::kHistogram:
+      default:
+        os << "# TYPE " << name << " histogram\n";
+        break;
+    }
+
+    for (const auto &series_it : family.series) {
+      const Labels &labels = series_it.first;
+      const Series &s = series_it.second;
+      if (family.type != Type::kHistogram) {
+        os << name;
+        writeLabels(os, labels);
+        os << " " << formatValue(s.value) << "\n";
+        continue;
+      }
+      for (size_t i = 0; i <= kDurationBuckets.size(); ++i) {
+        Labels bucket_labels(labels);
+        const bool inf = i == kDurationBuckets.size();
+        bucket_labels["le"] = formatValue(inf ? std::numeric_limits<double>::infinity() : kDurationBuckets[i]);
+        os << name << "_bucket";
+        writeLabels(os, bucket_labels);
+        os << " " << (inf ? s.count : s.buckets[i]) << "\n";
+      }
+      os << name << "_sum";
+      writeLabels(os, labels);
+      os << " " << formatValue(s.sum) << "\n";
+      os << name << "_count";
+      writeLabels(os, labels);
+      os << " " << s.count << "\n";
+    }
+  }
+  return os.str();
+}
+
+ScopedTimer::~ScopedTimer() {
+  Registry &registry = Registry::get();
+  if (!registry.enabled()) {
+    return;
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+  registry.observe(name_, labels_, elapsed.count());
+}
+
+std::string httpEndpoint(const std::string &url) {
+  std::string path = url.substr(0, url.find_first_of("?#"));
+  const auto scheme_end = path.find("://");
+  if (scheme_end != std::string::npos) {
+    const auto path_start = path.find('/', scheme_end + 3);
+    path = (path_start == std::string::npos) ? "/" : path.substr(path_start);
+  }
+
+  // Image names are unbounded, keep only the repository they come from.
+  const auto targets = path.find("/targets/");
+  if (targets != std::string::npos) {
+    return path.substr(0, targets) + "/targets/*";
+  }
+
+  // 3.root.json -> root.json
+  const auto name_start = path.rfind('/') + 1;
+  size_t digits_end = name_start;
+  while (digits_end < path.size() && path[digits_end] >= '0' && path[digits_end] <= '9') {
+    ++digits_end;
+  }
+  if (digits_end > name_start && digits_end < path.size() && path[digits_end] == '.') {
+    path.erase(name_start, digits_end + 1 - name_start);
+  }
+  return path;
+}
+
+}  // namespace metrics
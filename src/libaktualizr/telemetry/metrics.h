@@ -0,0 +1,91 @@
+#ifndef TELEMETRY_METRICS_H_
+#define TELEMETRY_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace metrics {
+
+using Labels = std::map<std::string, std::string>;
+
+/**
+ * Process-wide registry of counters, gauges and histograms, rendered in the
+ * Prometheus text exposition format.
+ *
+ * The registry is disabled by default: until enable() is called, every update
+ * is a single atomic load, so instrumented code pays nothing for metrics
+ * nobody scrapes.
+ */
+class Registry {
+ public:
+  static Registry &get();
+
+  void enable(bool enabled = true) { enabled_ = enabled; }
+  bool enabled() const { return enabled_; }
+
+  void increment(const std::string &name, const Labels &labels = Labels(), double value = 1);
+  void setGauge(const std::string &name, const Labels &labels, double value);
+  void addGauge(const std::string &name, const Labels &labels, double value);
+  // Histogram buckets are in seconds, see kDurationBuckets.
+  void observe(const std::string &name, const Labels &labels, double seconds);
+
+  std::string renderPrometheus() const;
+  // Drops all the series, mainly for tests.
+  void clear();
+
+  static const std::vector<double> kDurationBuckets;
+
+ private:
+  enum class Type { kCounter, kGauge, kHistogram };
+
+  struct Series {
+    double value{0};
+    std::vector<uint64_t> buckets;
+    double sum{0};
+    uint64_t count{0};
+  };
+
+  struct Family {
+    Type type;
+    std::map<Labels, Series> series;
+  };
+
+  Registry() = default;
+  Series &series(const std::string &name, Type type, const Labels &labels);
+
+  std::atomic<bool> enabled_{false};
+  mutable std::mutex m_;
+  std::map<std::string, Family> families_;
+};
+
+// Measures the lifetime of the object into a histogram.
+class ScopedTimer {
+ public:
+  ScopedTimer(std::string name, Labels labels)
+      : name_(std::move(name)), labels_(std::move(labels)), start_(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer();
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  void setLabel(const std::string &key, const std::string &value) { labels_[key] = value; }
+
+ private:
+  std::string name_;
+  Labels labels_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Reduces a request URL to a label with a bounded set of values: the query
+// string and host are dropped, versioned metadata names lose their version
+// and image names are replaced by '*', e.g.
+//   https://tuf.example.com/repo/3.root.json -> /repo/root.json
+//   https://tuf.example.com/repo/targets/foo/bar.img -> /repo/targets/*
+std::string httpEndpoint(const std::string &url);
+
+}  // namespace metrics
+
+#endif  // TELEMETRY_METRICS_H_
@@ -0,0 +1,167 @@
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "logging/logging.h"
+#include "metrics.h"
+
+namespace metrics {
+
+static void closeFd(int &fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+static void writeAll(int fd, const std::string &data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t res = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if (res <= 0) {
+      LOG_DEBUG << "Metrics client went away: " << std::strerror(errno);
+      return;
+    }
+    written += static_cast<size_t>(res);
+  }
+}
+
+MetricsServer::MetricsServer(const boost::filesystem::path &socket_path, in_port_t port) : socket_path_(socket_path) {
+  try {
+    if (!socket_path_.empty()) {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
+      if (socket_path_.string().size() >= sizeof(addr.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::system_category(), "metrics socket " + socket_path_.string());
+      }
+      std::strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+      boost::filesystem::remove(socket_path_);
+
+      unix_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (unix_fd_ < 0 || bind(unix_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+          listen(unix_fd_, 4) < 0) {
+        throw std::system_error(errno, std::system_category(), "metrics socket " + socket_path_.string());
+      }
+    }
+
+    if (port != 0) {
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = htons(port);
+      const int reuseaddr = 1;
+
+      tcp_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (tcp_fd_ < 0 || setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &reuseaddr, sizeof(reuseaddr)) < 0 ||
+          bind(tcp_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(tcp_fd_, 4) < 0) {
+        throw std::system_error(errno, std::system_category(), "metrics port " + std::to_string(port));
+      }
+      socklen_t addr_len = sizeof(addr);
+      getsockname(tcp_fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+      port_ = ntohs(addr.sin_port);
+    }
+
+    int stop_fds[2];
+    if (pipe2(stop_fds, O_CLOEXEC) < 0) {
+      throw std::system_error(errno, std::system_category(), "metrics server pipe");
+    }
+    stop_read_fd_ = stop_fds[0];
+    stop_write_fd_ = stop_fds[1];
+  } catch (...) {
+    closeFd(unix_fd_);
+    closeFd(tcp_fd_);
+    throw;
+  }
+
+  Registry::get().enable();
+  thread_ = std::thread(&MetricsServer::run, this);
+}
+
+MetricsServer::~MetricsServer() {
+  const char stop = 0;
+  while (write(stop_write_fd_, &stop, 1) < 0 && errno == EINTR) {
+  }
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  closeFd(stop_read_fd_);
+  closeFd(stop_write_fd_);
+  closeFd(unix_fd_);
+  closeFd(tcp_fd_);
+  if (!socket_path_.empty()) {
+    boost::system::error_code ec;
+    boost::filesystem::remove(socket_path_, ec);
+  }
+}
+
+void MetricsServer::run() {
+  std::vector<pollfd> fds{pollfd{stop_read_fd_, POLLIN, 0}};
+  for (const int fd : {unix_fd_, tcp_fd_}) {
+    if (fd >= 0) {
+      fds.push_back(pollfd{fd, POLLIN, 0});
+    }
+  }
+
+  for (;;) {
+    if (poll(fds.data(), fds.size(), -1) <= 0) {
+      continue;
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+    for (auto &pfd : fds) {
+      if ((pfd.revents & POLLIN) == 0) {
+        continue;
+      }
+      int client = accept4(pfd.fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0) {
+        continue;
+      }
+      // a stalled client must not block the thread for long
+      timeval timeout{1, 0};
+      setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      if (pfd.fd == unix_fd_) {
+        serveUnix(client);
+      } else {
+        serveHttp(client);
+      }
+      closeFd(client);
+    }
+  }
+}
+
+void MetricsServer::serveUnix(int fd) const { writeAll(fd, Registry::get().renderPrometheus()); }
+
+void MetricsServer::serveHttp(int fd) const {
+  // Whatever the request is, the answer is the metrics; just consume the
+  // request head so that the client does not see a reset connection.
+  std::string request;
+  char buf[512];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+    const ssize_t res = recv(fd, buf, sizeof(buf), 0);
+    if (res <= 0) {
+      return;
+    }
+    request.append(buf, static_cast<size_t>(res));
+  }
+
+  const std::string body = Registry::get().renderPrometheus();
+  writeAll(fd,
+           "HTTP/1.0 200 OK\r\n"
+           "Content-Type: text/plain; version=0.0.4\r\n"
+           "Content-Length: " +
+               std::to_string(body.size()) + "\r\n\r\n" + body);
+}
+
+}  // namespace metrics
@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_METRICS_SERVER_H_
+#define TELEMETRY_METRICS_SERVER_H_
+
+#include <netinet/in.h>
+
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+namespace metrics {
+
+/**
+ * Serves the metrics of Registry::get() from a background thread:
+ * - on a Unix socket, where every connection receives the current metrics in
+ *   Prometheus text format and is closed,
+ * - over HTTP on 127.0.0.1, where every request gets them as the response.
+ *
+ * Throws std::system_error if a socket cannot be set up.
+ */
+class MetricsServer {
+ public:
+  // An empty socket path or a zero port disables the respective endpoint.
+  MetricsServer(const boost::filesystem::path &socket_path, in_port_t port);
+  ~MetricsServer();
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  // the loopback port the HTTP endpoint listens on, 0 if it is disabled
+  in_port_t port() const { return port_; }
+
+ private:
+  void run();
+  void serveUnix(int fd) const;
+  void serveHttp(int fd) const;
+
+  boost::filesystem::path socket_path_;
+  in_port_t port_{0};
+  int unix_fd_{-1};
+  int tcp_fd_{-1};
+  // written to by the destructor to wake up and stop the thread
+  int stop_read_fd_{-1};
+  int stop_write_fd_{-1};
+  std::thread thread_;
+};
+
+}  // namespace metrics
+
+#endif  // TELEMETRY_METRICS_SERVER_H_
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "telemetry/metrics.h"
+#include "telemetry/metrics_server.h"
+#include "test_utils.h"
+#include "utilities/utils.h"
+
+class MetricsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    metrics::Registry::get().clear();
+    metrics::Registry::get().enable();
+  }
+  void TearDown() override {
+    metrics::Registry::get().enable(false);
+    metrics::Registry::get().clear();
+  }
+};
+
+static std::string readAll(int fd) {
+  std::string out;
+  char buf[512];
+  ssize_t res;
+  while ((res = recv(fd, buf, sizeof(buf), 0)) > 0) {
+    out.append(buf, static_cast<size_t>(res));
+  }
+  close(fd);
+  return out;
+}
+
+/*
+ * Updates are ignored while the registry is disabled.
+ */
+TEST_F(MetricsTest, Disabled) {
+  metrics::Registry::get().enable(false);
+  metrics::Registry::get().increment("test_total");
+  EXPECT_EQ(metrics::Registry::get().renderPrometheus(), "");
+}
+
+/*
+ * Render counters and gauges with their labels in Prometheus text format.
+ */
+TEST_F(MetricsTest, CountersAndGauges) {
+  auto &registry = metrics::Registry::get();
+  registry.increment("test_total", {{"status", "200"}, {"endpoint", "/director/targets.json"}});
+  registry.increment("test_total", {{"status", "200"}, {"endpoint", "/director/targets.json"}});
+  registry.increment("test_total", {{"status", "404"}, {"endpoint", "/repo/\"quoted\""}}, 3);
+  registry.setGauge("test_depth", {}, 5);
+  registry.addGauge("test_depth", {}, -2);
+
+  EXPECT_EQ(registry.renderPrometheus(),
+            "# TYPE test_depth gauge\n"
+            "test_depth 3\n"
+            "# TYPE test_total counter\n"
+            "test_total{endpoint=\"/director/targets.json\",status=\"200\"} 2\n"
+            "test_total{endpoint=\"/repo/\\\"quoted\\\"\",status=\"404\"} 3\n");
+}
+
+/*
+ * Histogram buckets are cumulative and end with +Inf.
+ */
+TEST_F(MetricsTest, Histogram) {
+  auto &registry = metrics::Registry::get();
+  registry.observe("aktualizr_secondary_rpc_duration_seconds", {{"method", "getInfoReq"}}, 0.003);
+  registry.observe("aktualizr_secondary_rpc_duration_seconds", {{"method", "getInfoReq"}}, 0.2);
+  registry.observe("aktualizr_secondary_rpc_duration_seconds", {{"method", "getInfoReq"}}, 120);
+
+  const std::string text = registry.renderPrometheus();
+  EXPECT_NE(text.find("# HELP aktualizr_secondary_rpc_duration_seconds "), std::string::npos);
+  EXPECT_NE(text.find("# TYPE aktualizr_secondary_rpc_duration_seconds histogram\n"), std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_bucket{le=\"0.005\",method=\"getInfoReq\"} 1\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_bucket{le=\"0.25\",method=\"getInfoReq\"} 2\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_bucket{le=\"60\",method=\"getInfoReq\"} 2\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_bucket{le=\"+Inf\",method=\"getInfoReq\"} 3\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_sum{method=\"getInfoReq\"} 120.203\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("aktualizr_secondary_rpc_duration_seconds_count{method=\"getInfoReq\"} 3\n"),
+            std::string::npos);
+}
+
+/*
+ * Reduce request URLs to a bounded set of endpoint labels.
+ */
+TEST(Metrics, HttpEndpoint) {
+  EXPECT_EQ(metrics::httpEndpoint("https://example.com/director/targets.json"), "/director/targets.json");
+  EXPECT_EQ(metrics::httpEndpoint("https://example.com/repo/12.root.json"), "/repo/root.json");
+  EXPECT_EQ(metrics::httpEndpoint("https://example.com/repo/targets/dir/image-1.0.bin?x=1"), "/repo/targets/*");
+  EXPECT_EQ(metrics::httpEndpoint("https://example.com:8443/system_info/network?x=1"), "/system_info/network");
+  EXPECT_EQ(metrics::httpEndpoint("https://example.com"), "/");
+}
+
+/*
+ * Serve the metrics on a Unix socket.
+ */
+TEST_F(MetricsTest, UnixServer) {
+  TemporaryDirectory temp_dir;
+  const boost::filesystem::path socket_path = temp_dir / "metrics.sock";
+  metrics::MetricsServer server(socket_path, 0);
+  EXPECT_TRUE(metrics::Registry::get().enabled());
+  metrics::Registry::get().increment("test_total");
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un unix_addr{};
+  unix_addr.sun_family = AF_UNIX;
+  std::strncpy(unix_addr.sun_path, socket_path.c_str(), sizeof(unix_addr.sun_path) - 1);
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&unix_addr), sizeof(unix_addr)), 0);
+  EXPECT_EQ(readAll(fd), "# TYPE test_total counter\ntest_total 1\n");
+}
+
+/*
+ * Serve the metrics over HTTP on the loopback interface.
+ */
+TEST_F(MetricsTest, HttpServer) {
+  const in_port_t port = TestUtils::getFreePortAsInt();
+  metrics::MetricsServer server("", port);
+  EXPECT_EQ(server.port(), port);
+  metrics::Registry::get().increment("test_total");
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+  const std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  ASSERT_EQ(send(fd, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+  const std::string response = readAll(fd);
+  EXPECT_EQ(response.find("HTTP/1.0 200 OK\r\n"), 0);
+  EXPECT_NE(response.find("\r\n\r\n# TYPE test_total counter\ntest_total 1\n"), std::string::npos);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -5,9 +5,13 @@
 void TelemetryConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt) {
   CopyFromConfig(report_network, "report_network", pt);
   CopyFromConfig(report_config, "report_config", pt);
+  CopyFromConfig(metrics_socket, "metrics_socket", pt);
+  CopyFromConfig(metrics_port, "metrics_port", pt);
 }
 
 void TelemetryConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, report_network, "report_network");
   writeOption(out_stream, report_config, "report_config");
+  writeOption(out_stream, metrics_socket, "metrics_socket");
+  writeOption(out_stream, metrics_port, "metrics_port");
 }
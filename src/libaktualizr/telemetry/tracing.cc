@@ -0,0 +1,135 @@
+#include "tracing.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include "logging/logging.h"
+
+namespace tracing {
+
+constexpr size_t Recorder::kCapacity;
+
+Recorder &Recorder::get() {
+  static Recorder recorder;
+  return recorder;
+}
+
+uint32_t Recorder::threadIndex() {
+  // small, stable numbers make the trace viewer readable
+  static std::atomic<uint32_t> next_index{1};
+  thread_local const uint32_t index = next_index++;
+  return index;
+}
+
+void Recorder::record(const char *name, std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  const SpanRecord span{name, threadIndex(), duration_cast<microseconds>(start.time_since_epoch()).count(),
+                        duration_cast<microseconds>(end - start).count()};
+
+  std::lock_guard<std::mutex> guard(m_);
+  if (buffer_.size() < kCapacity) {
+    buffer_.push_back(span);
+  } else {
+    buffer_[next_] = span;
+    wrapped_ = true;
+  }
+  next_ = (next_ + 1) % kCapacity;
+}
+
+std::vector<SpanRecord> Recorder::snapshot() const {
+  std::lock_guard<std::mutex> guard(m_);
+  if (!wrapped_) {
+    return buffer_;
+  }
+  // oldest first
+  std::vector<SpanRecord> spans(buffer_.begin() + static_cast<std::ptrdiff_t>(next_), buffer_.end());
+  spans.insert(spans.end(), buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(next_));
+  return spans;
+}
+
+void Recorder::clear() {
+  std::lock_guard<std::mutex> guard(m_);
+  buffer_.clear();
+  next_ = 0;
+  wrapped_ = false;
+}
+
+void Recorder::writeChromeTrace(std::ostream &os) const {
+  const auto pid = getpid();
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto &span : snapshot()) {
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+    // span names are literals from our own sources, they need no escaping
+    os << "\n{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << span.thread
+       << ",\"ts\":" << span.start << ",\"dur\":" << span.duration << "}";
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Recorder::dump(const boost::filesystem::path &path) const {
+  const boost::filesystem::path tmp_path = path.string() + ".tmp";
+  {
+    std::ofstream file(tmp_path.string());
+    if (!file) {
+      throw std::runtime_error("Unable to open " + tmp_path.string());
+    }
+    writeChromeTrace(file);
+  }
+  boost::filesystem::rename(tmp_path, path);
+}
+
+static int signal_pipe[2] = {-1, -1};
+
+static void onDumpSignal(int sig) {
+  (void)sig;
+  const char byte = 0;
+  // write() is async-signal-safe, a full pipe only means a dump is pending
+  if (write(signal_pipe[1], &byte, 1) < 0) {
+    return;
+  }
+}
+
+void Recorder::dumpOnSignal(int sig, const boost::filesystem::path &path) {
+  if (signal_pipe[0] != -1) {
+    throw std::runtime_error("Trace dump on signal can only be set up once");
+  }
+  if (pipe(signal_pipe) != 0) {
+    throw std::runtime_error("Unable to set up the trace dump signal");
+  }
+
+  try {
+    std::thread([this, path]() {
+      char byte;
+      while (read(signal_pipe[0], &byte, 1) > 0) {
+        try {
+          dump(path);
+          LOG_INFO << "Trace written to " << path;
+        } catch (const std::exception &e) {
+          LOG_ERROR << "Unable to write trace: " << e.what();
+        }
+      }
+    }).detach();
+  } catch (...) {
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
+    signal_pipe[0] = signal_pipe[1] = -1;
+    throw;
+  }
+
+  if (::signal(sig, onDumpSignal) == SIG_ERR) {
+    throw std::runtime_error("Unable to set up the trace dump signal");
+  }
+}
+
+}  // namespace tracing
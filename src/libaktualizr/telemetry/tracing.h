@@ -0,0 +1,83 @@
+#ifndef TELEMETRY_TRACING_H_
+#define TELEMETRY_TRACING_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+/**
+ * Lightweight tracing of the update pipeline.
+ *
+ * TRACE_SPAN("name") records the time spent in the enclosing scope into an
+ * in-memory ring buffer, which can be written out as Chrome trace-event JSON
+ * (chrome://tracing, Perfetto) on demand or on a signal. Without
+ * -DENABLE_TRACING=ON the macro expands to nothing, so spans cost nothing in
+ * production builds.
+ *
+ * Span names must be string literals: only the pointer is stored.
+ */
+#ifdef AKTUALIZR_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) tracing::Span TRACE_CONCAT(trace_span_, __LINE__)(name)
+#else
+#define TRACE_SPAN(name) static_cast<void>(0)
+#endif
+
+namespace tracing {
+
+struct SpanRecord {
+  const char *name;
+  uint32_t thread;
+  // microseconds on the steady clock
+  int64_t start;
+  int64_t duration;
+};
+
+class Recorder {
+ public:
+  static Recorder &get();
+
+  // the oldest spans are dropped when the buffer is full
+  static constexpr size_t kCapacity = 1 << 16;
+
+  void record(const char *name, std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end);
+  std::vector<SpanRecord> snapshot() const;
+  void clear();
+
+  void writeChromeTrace(std::ostream &os) const;
+  void dump(const boost::filesystem::path &path) const;
+  // Dumps the buffer to `path` every time the process receives `sig`.
+  // Can only be set up once.
+  void dumpOnSignal(int sig, const boost::filesystem::path &path);
+
+ private:
+  Recorder() { buffer_.reserve(kCapacity); }
+  static uint32_t threadIndex();
+
+  mutable std::mutex m_;
+  std::vector<SpanRecord> buffer_;
+  size_t next_{0};
+  bool wrapped_{false};
+};
+
+class Span {
+ public:
+  explicit Span(const char *name) : name_(name), start_(std::chrono::steady_clock::now()) {}
+  ~Span() { Recorder::get().record(name_, start_, std::chrono::steady_clock::now()); }
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+ private:
+  const char *name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace tracing
+
+#endif  // TELEMETRY_TRACING_H_
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "telemetry/tracing.h"
+
+/*
+ * Record nested spans with their duration.
+ */
+TEST(Tracing, Spans) {
+  auto &recorder = tracing::Recorder::get();
+  recorder.clear();
+  {
+    tracing::Span outer("outer");
+    {
+      tracing::Span inner("inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  std::thread([]() { tracing::Span other("other"); }).join();
+
+  const auto spans = recorder.snapshot();
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_STREQ(spans[0].name, "inner");
+  EXPECT_STREQ(spans[1].name, "outer");
+  EXPECT_STREQ(spans[2].name, "other");
+  EXPECT_GE(spans[0].duration, 10000);
+  EXPECT_GE(spans[1].duration, spans[0].duration);
+  EXPECT_LE(spans[1].start, spans[0].start);
+  EXPECT_EQ(spans[0].thread, spans[1].thread);
+  EXPECT_NE(spans[0].thread, spans[2].thread);
+
+  std::stringstream trace;
+  recorder.writeChromeTrace(trace);
+  EXPECT_EQ(trace.str().find("{\"traceEvents\":["), 0);
+  EXPECT_NE(trace.str().find("\"name\":\"outer\",\"ph\":\"X\""), std::string::npos);
+}
+
+/*
+ * Drop the oldest spans once the buffer is full.
+ */
+TEST(Tracing, RingBuffer) {
+  auto &recorder = tracing::Recorder::get();
+  recorder.clear();
+  const auto now = std::chrono::steady_clock::now();
+  recorder.record("first", now, now);
+  for (size_t i = 0; i < tracing::Recorder::kCapacity; ++i) {
+    recorder.record("filler", now, now);
+  }
+  recorder.record("last", now, now);
+
+  const auto spans = recorder.snapshot();
+  ASSERT_EQ(spans.size(), tracing::Recorder::kCapacity);
+  EXPECT_STREQ(spans.front().name, "filler");
+  EXPECT_STREQ(spans.back().name, "last");
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -87,6 +87,13 @@ void DirectorRepository::checkMetaOffline(INvStorage& storage) {
   }
 }
 
+void DirectorRepository::checkMetaExpired() {
+  if (rootExpired()) {
+    throw Uptane::ExpiredMetadata(type.toString(), Role::ROOT);
+  }
+  checkTargetsExpired();
+}
+
 void DirectorRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fetcher) {
   // Uptane step 2 (download time) is not implemented yet.
   // Uptane step 3 (download metadata)
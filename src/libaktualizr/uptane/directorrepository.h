@@ -22,6 +22,8 @@ class DirectorRepository : public RepositoryCommon {
   }
   const std::string& getCorrelationId() const { return targets.correlation_id(); }
   void checkMetaOffline(INvStorage& storage);
+  // Throws if metadata that has already been verified has expired since.
+  void checkMetaExpired();
   void dropTargets(INvStorage& storage);
 
   void updateMeta(INvStorage& storage, const IMetadataFetcher& fetcher) override;
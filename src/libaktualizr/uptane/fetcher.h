@@ -1,8 +1,11 @@
 #ifndef UPTANE_FETCHER_H_
 #define UPTANE_FETCHER_H_
 
+#include <chrono>
+
 #include "http/httpinterface.h"
 #include "libaktualizr/config.h"
+#include "libaktualizr/results.h"
 #include "storage/invstorage.h"
 
 namespace Uptane {
@@ -53,6 +56,52 @@ class Fetcher : public IMetadataFetcher {
   std::string director_server;
 };
 
+/* Forwards to another fetcher and accounts for the time spent and the data
+ * received, so that fetching can be told apart from verifying. Not thread-safe. */
+class MeasuringFetcher : public IMetadataFetcher {
+ public:
+  explicit MeasuringFetcher(const IMetadataFetcher& fetcher) : fetcher_(fetcher) {}
+
+  void fetchRole(std::string* result, int64_t maxsize, RepositoryType repo, const Uptane::Role& role,
+                 Version version) const override {
+    measure(result, [&]() { fetcher_.fetchRole(result, maxsize, repo, role, version); });
+  }
+  void fetchLatestRole(std::string* result, int64_t maxsize, RepositoryType repo,
+                       const Uptane::Role& role) const override {
+    measure(result, [&]() { fetcher_.fetchLatestRole(result, maxsize, repo, role); });
+  }
+
+  // Splits the total time of an update into fetching and the rest.
+  result::MetadataMetrics metrics(std::chrono::steady_clock::duration total_time) const {
+    result::MetadataMetrics m;
+    m.fetch_time = std::chrono::duration_cast<std::chrono::milliseconds>(fetch_time_);
+    m.verify_time = std::chrono::duration_cast<std::chrono::milliseconds>(total_time - fetch_time_);
+    m.files = files_;
+    m.bytes = bytes_;
+    return m;
+  }
+
+ private:
+  template <typename Fetch>
+  void measure(const std::string* result, Fetch fetch) const {
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      fetch();
+    } catch (...) {
+      fetch_time_ += std::chrono::steady_clock::now() - start;
+      throw;
+    }
+    fetch_time_ += std::chrono::steady_clock::now() - start;
+    ++files_;
+    bytes_ += result->size();
+  }
+
+  const IMetadataFetcher& fetcher_;
+  mutable std::chrono::steady_clock::duration fetch_time_{0};
+  mutable unsigned int files_{0};
+  mutable uint64_t bytes_{0};
+};
+
 }  // namespace Uptane
 
 #endif
@@ -26,7 +26,7 @@ void ImageRepository::checkTimestampExpired() {
   }
 }
 
-void ImageRepository::fetchSnapshot(INvStorage& storage, const IMetadataFetcher& fetcher, const int local_version) {
+std::string ImageRepository::fetchSnapshot(const IMetadataFetcher& fetcher, const int local_version) {
   std::string image_snapshot;
   const int64_t snapshot_size = (snapshotSize() > 0) ? snapshotSize() : kMaxSnapshotSize;
   fetcher.fetchLatestRole(&image_snapshot, snapshot_size, RepositoryType::Image(), Role::Snapshot());
@@ -43,8 +43,9 @@ void ImageRepository::fetchSnapshot(INvStorage& storage, const IMetadataFetcher&
   if (local_version > remote_version) {
     throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
   } else if (local_version < remote_version) {
-    storage.storeNonRoot(image_snapshot, RepositoryType::Image(), Role::Snapshot());
+    return image_snapshot;
   }
+  return "";
 }
 
 void ImageRepository::verifySnapshot(const std::string& snapshot_raw, bool prefetch) {
@@ -99,7 +100,7 @@ void ImageRepository::checkSnapshotExpired() {
   }
 }
 
-void ImageRepository::fetchTargets(INvStorage& storage, const IMetadataFetcher& fetcher, const int local_version) {
+std::string ImageRepository::fetchTargets(const IMetadataFetcher& fetcher, const int local_version) {
   std::string image_targets;
   const Role targets_role = Role::Targets();
 
@@ -117,8 +118,9 @@ void ImageRepository::fetchTargets(INvStorage& storage, const IMetadataFetcher&
   if (local_version > remote_version) {
     throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
   } else if (local_version < remote_version) {
-    storage.storeNonRoot(image_targets, RepositoryType::Image(), targets_role);
+    return image_targets;
   }
+  return "";
 }
 
 void ImageRepository::verifyRoleHashes(const std::string& role_data, const Uptane::Role& role, bool prefetch) const {
@@ -202,6 +204,32 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
 
   updateRoot(storage, fetcher, RepositoryType::Image());
 
+  // New metadata is stored in one transaction once all roles have been
+  // updated, or once one of them fails, so that what has been verified is
+  // still kept.
+  std::vector<std::pair<Role, std::string>> new_meta;
+  auto store_new_meta = [&storage, &new_meta]() {
+    if (new_meta.empty()) {
+      return;
+    }
+    storage.runInTransaction([&storage, &new_meta]() {
+      for (const auto& meta : new_meta) {
+        storage.storeNonRoot(meta.second, RepositoryType::Image(), meta.first);
+      }
+    });
+  };
+
+  try {
+    updateNonRootMeta(storage, fetcher, &new_meta);
+  } catch (...) {
+    store_new_meta();
+    throw;
+  }
+  store_new_meta();
+}
+
+void ImageRepository::updateNonRootMeta(const INvStorage& storage, const IMetadataFetcher& fetcher,
+                                        std::vector<std::pair<Role, std::string>>* new_meta) {
   // Update Image repo Timestamp metadata
   {
     std::string image_timestamp;
@@ -222,7 +250,7 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
     if (local_version > remote_version) {
       throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
     } else if (local_version < remote_version) {
-      storage.storeNonRoot(image_timestamp, RepositoryType::Image(), Role::Timestamp());
+      new_meta->emplace_back(Role::Timestamp(), image_timestamp);
     }
 
     checkTimestampExpired();
@@ -250,7 +278,10 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
 
     // If we don't, attempt to fetch the latest.
     if (fetch_snapshot) {
-      fetchSnapshot(storage, fetcher, local_version);
+      std::string image_snapshot = fetchSnapshot(fetcher, local_version);
+      if (!image_snapshot.empty()) {
+        new_meta->emplace_back(Role::Snapshot(), std::move(image_snapshot));
+      }
     }
 
     checkSnapshotExpired();
@@ -278,13 +309,27 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
 
     // If we don't, attempt to fetch the latest.
     if (fetch_targets) {
-      fetchTargets(storage, fetcher, local_version);
+      std::string image_targets = fetchTargets(fetcher, local_version);
+      if (!image_targets.empty()) {
+        new_meta->emplace_back(Role::Targets(), std::move(image_targets));
+      }
     }
 
     checkTargetsExpired();
   }
 }
 
+void ImageRepository::checkMetaExpired() {
+  if (rootExpired()) {
+    throw Uptane::ExpiredMetadata(type.toString(), Role::ROOT);
+  }
+  checkTimestampExpired();
+  checkSnapshotExpired();
+  if (targets) {
+    checkTargetsExpired();
+  }
+}
+
 void ImageRepository::checkMetaOffline(INvStorage& storage) {
   resetMeta();
   // Load Image repo Root metadata
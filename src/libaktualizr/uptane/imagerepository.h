@@ -2,6 +2,8 @@
 #define IMAGE_REPOSITORY_H_
 
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "uptanerepository.h"
@@ -31,14 +33,20 @@ class ImageRepository : public RepositoryCommon {
   int64_t getRoleSize(const Uptane::Role& role) const;
 
   void checkMetaOffline(INvStorage& storage);
+  // Throws if metadata that has already been verified has expired since.
+  void checkMetaExpired();
   void updateMeta(INvStorage& storage, const IMetadataFetcher& fetcher) override;
 
  private:
+  void updateNonRootMeta(const INvStorage& storage, const IMetadataFetcher& fetcher,
+                         std::vector<std::pair<Role, std::string>>* new_meta);
   void checkTimestampExpired();
   void checkSnapshotExpired();
   int64_t snapshotSize() const { return timestamp.snapshot_size(); }
-  void fetchSnapshot(INvStorage& storage, const IMetadataFetcher& fetcher, int local_version);
-  void fetchTargets(INvStorage& storage, const IMetadataFetcher& fetcher, int local_version);
+  // Return the new metadata to store, or an empty string if the stored
+  // metadata is up to date.
+  std::string fetchSnapshot(const IMetadataFetcher& fetcher, int local_version);
+  std::string fetchTargets(const IMetadataFetcher& fetcher, int local_version);
   void checkTargetsExpired();
 
   std::shared_ptr<Uptane::Targets> targets;
@@ -4,10 +4,16 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -666,6 +672,196 @@ TEST(Uptane, SendMetadataToSecondary) {
   EXPECT_TRUE(EcuInstallationStartedReportGot);
 }
 
+/*
+ * Send metadata to several Secondary ECUs in parallel.
+ */
+TEST(Uptane, SendMetadataToSecondariesInParallel) {
+  Config conf("tests/config/basic.toml");
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "multisec");
+  conf.provision.primary_ecu_serial = "CA:FE:A6:D2:84:9D";
+  conf.provision.primary_ecu_hardware_id = "primary_hw";
+  conf.uptane.director_server = http->tls_server + "/director";
+  conf.uptane.repo_server = http->tls_server + "/repo";
+  conf.uptane.secondary_metadata_concurrency = 2;
+  conf.pacman.images_path = temp_dir.Path() / "images";
+  conf.storage.path = temp_dir.Path();
+  conf.tls.server = http->tls_server;
+
+  std::vector<std::shared_ptr<SecondaryInterfaceMock>> secs;
+  for (int k = 1; k <= 2; ++k) {
+    Primary::VirtualSecondaryConfig ecu_config;
+    ecu_config.partial_verifying = false;
+    ecu_config.full_client_dir = temp_dir.Path();
+    ecu_config.ecu_serial = "sec_serial" + std::to_string(k);
+    ecu_config.ecu_hardware_id = "sec_hw" + std::to_string(k);
+    ecu_config.ecu_private_key = "sec.priv";
+    ecu_config.ecu_public_key = "sec.pub";
+    secs.push_back(std::make_shared<SecondaryInterfaceMock>(ecu_config));
+  }
+
+  // Each send waits until all of them have started, which only happens if they
+  // overlap.
+  std::mutex m;
+  std::condition_variable cv;
+  size_t started = 0;
+  size_t overlapped = 0;
+  auto barrier = [&](const Uptane::MetaBundle &) {
+    std::unique_lock<std::mutex> lock(m);
+    ++started;
+    cv.notify_all();
+    if (cv.wait_for(lock, std::chrono::seconds(30), [&]() { return started == secs.size(); })) {
+      ++overlapped;
+    }
+    return true;
+  };
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  auto up = std_::make_unique<UptaneTestCommon::TestUptaneClient>(conf, storage, http);
+  for (const auto &sec : secs) {
+    up->addSecondary(sec);
+    EXPECT_CALL(*sec, getRootVersionMock(testing::_)).WillRepeatedly(testing::Return(1));
+    EXPECT_CALL(*sec, putMetadataMock(testing::_)).WillOnce(testing::Invoke(barrier));
+  }
+  EXPECT_NO_THROW(up->initialize());
+  result::UpdateCheck update_result = up->fetchMeta();
+  EXPECT_EQ(update_result.status, result::UpdateStatus::kUpdatesAvailable);
+  EXPECT_EQ(update_result.ecus_count, 2);
+
+  result::Download download_result = up->downloadImages(update_result.updates);
+  EXPECT_EQ(download_result.status, result::DownloadStatus::kSuccess);
+  result::Install install_result = up->uptaneInstall(download_result.updates);
+  EXPECT_TRUE(install_result.dev_report.isSuccess());
+  EXPECT_EQ(install_result.ecu_reports.size(), 2);
+  EXPECT_EQ(overlapped, secs.size());
+}
+
+class LateSecondaryMock : public SecondaryInterfaceMock {
+ public:
+  LateSecondaryMock(Primary::VirtualSecondaryConfig &sconfig_in, int failed_pings)
+      : SecondaryInterfaceMock(sconfig_in), failed_pings_(failed_pings) {}
+  bool ping() const override {
+    std::lock_guard<std::mutex> guard(m_);
+    ping_times_.push_back(std::chrono::steady_clock::now());
+    return pings_++ >= failed_pings_;
+  }
+  void resetPings() {
+    std::lock_guard<std::mutex> guard(m_);
+    ping_times_.clear();
+    pings_ = 0;
+  }
+  std::chrono::steady_clock::duration pingSpan() const {
+    std::lock_guard<std::mutex> guard(m_);
+    return ping_times_.empty() ? std::chrono::steady_clock::duration::zero() : ping_times_.back() - ping_times_.front();
+  }
+
+  mutable std::atomic<int> pings_{0};
+  const int failed_pings_;
+
+ private:
+  mutable std::mutex m_;
+  mutable std::vector<std::chrono::steady_clock::time_point> ping_times_;
+};
+
+static Primary::VirtualSecondaryConfig late_secondary_config() {
+  Primary::VirtualSecondaryConfig ecu_config;
+  ecu_config.partial_verifying = false;
+  ecu_config.ecu_serial = "secondary_ecu_serial";
+  ecu_config.ecu_hardware_id = "secondary_hw";
+  ecu_config.ecu_private_key = "sec.priv";
+  ecu_config.ecu_public_key = "sec.pub";
+  return ecu_config;
+}
+
+/* Download an update for the given Secondary and time how long it takes to install it. */
+static result::Install install_with_late_secondary(const std::shared_ptr<LateSecondaryMock> &sec,
+                                                   uint64_t wait_sec, std::chrono::steady_clock::duration *install_time) {
+  Config conf("tests/config/basic.toml");
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "hasupdates");
+  conf.provision.primary_ecu_serial = "CA:FE:A6:D2:84:9D";
+  conf.provision.primary_ecu_hardware_id = "primary_hw";
+  conf.uptane.director_server = http->tls_server + "/director";
+  conf.uptane.repo_server = http->tls_server + "/repo";
+  conf.uptane.secondary_preinstall_wait_sec = wait_sec;
+  conf.pacman.images_path = temp_dir.Path() / "images";
+  conf.storage.path = temp_dir.Path();
+  conf.tls.server = http->tls_server;
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  auto up = std_::make_unique<UptaneTestCommon::TestUptaneClient>(conf, storage, http);
+  up->addSecondary(sec);
+  EXPECT_NO_THROW(up->initialize());
+  result::UpdateCheck update_result = up->fetchMeta();
+  EXPECT_EQ(update_result.status, result::UpdateStatus::kUpdatesAvailable);
+  result::Download download_result = up->downloadImages(update_result.updates);
+  EXPECT_EQ(download_result.status, result::DownloadStatus::kSuccess);
+
+  sec->resetPings();
+  const auto start = std::chrono::steady_clock::now();
+  result::Install install_result = up->uptaneInstall(download_result.updates);
+  *install_time = std::chrono::steady_clock::now() - start;
+  return install_result;
+}
+
+/*
+ * Start the installation as soon as a Secondary that was not yet reachable
+ * comes up, instead of polling it once per second.
+ */
+TEST(Uptane, WaitForLateSecondary) {
+  auto ecu_config = late_secondary_config();
+  auto sec = std::make_shared<LateSecondaryMock>(ecu_config, 3);
+  EXPECT_CALL(*sec, getRootVersionMock(testing::_)).WillRepeatedly(testing::Return(1));
+  EXPECT_CALL(*sec, putMetadataMock(testing::_)).Times(1);
+
+  std::chrono::steady_clock::duration install_time{};
+  result::Install install_result = install_with_late_secondary(sec, 600, &install_time);
+  EXPECT_TRUE(install_result.dev_report.isSuccess());
+  EXPECT_EQ(sec->pings_, 4);
+  // The first retry comes after 0.1 s and the next ones once per second, so
+  // the last ping is 2.1 s after the first. Polling once per second would have
+  // taken at least three seconds.
+  EXPECT_LT(sec->pingSpan(), std::chrono::seconds(3));
+}
+
+/*
+ * Give up on a Secondary that never comes up once the wait is over, and stop
+ * pinging it.
+ */
+TEST(Uptane, WaitForUnreachableSecondary) {
+  auto ecu_config = late_secondary_config();
+  auto sec = std::make_shared<LateSecondaryMock>(ecu_config, std::numeric_limits<int>::max());
+  EXPECT_CALL(*sec, getRootVersionMock(testing::_)).WillRepeatedly(testing::Return(1));
+  EXPECT_CALL(*sec, putMetadataMock(testing::_)).Times(0);
+
+  std::chrono::steady_clock::duration install_time{};
+  result::Install install_result = install_with_late_secondary(sec, 2, &install_time);
+  EXPECT_FALSE(install_result.dev_report.isSuccess());
+  EXPECT_EQ(install_result.dev_report.result_code, data::ResultCode::Numeric::kInternalError);
+  EXPECT_GE(install_time, std::chrono::seconds(2));
+  EXPECT_LT(install_time, std::chrono::milliseconds(3500));
+
+  const int pings = sec->pings_;
+  EXPECT_GE(pings, 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  EXPECT_EQ(sec->pings_, pings);
+}
+
+/*
+ * Ping every Secondary once even if there is no time to wait for them.
+ */
+TEST(Uptane, WaitForSecondaryNoDelay) {
+  auto ecu_config = late_secondary_config();
+  auto sec = std::make_shared<LateSecondaryMock>(ecu_config, 0);
+  EXPECT_CALL(*sec, getRootVersionMock(testing::_)).WillRepeatedly(testing::Return(1));
+  EXPECT_CALL(*sec, putMetadataMock(testing::_)).Times(1);
+
+  std::chrono::steady_clock::duration install_time{};
+  result::Install install_result = install_with_late_secondary(sec, 0, &install_time);
+  EXPECT_TRUE(install_result.dev_report.isSuccess());
+  EXPECT_EQ(sec->pings_, 1);
+}
+
 /* Register Secondary ECUs with Director. */
 TEST(Uptane, UptaneSecondaryAdd) {
   TemporaryDirectory temp_dir;
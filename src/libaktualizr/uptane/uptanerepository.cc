@@ -85,8 +85,10 @@ void RepositoryCommon::updateRoot(INvStorage& storage, const IMetadataFetcher& f
 
     // 5.4.4.3.2.5. Set the latest Root metadata file to the new Root metadata
     // file.
-    storage.storeRoot(root_raw, repo_type, Version(version));
-    storage.clearNonRootMeta(repo_type);
+    storage.runInTransaction([&storage, &root_raw, repo_type, version]() {
+      storage.storeRoot(root_raw, repo_type, Version(version));
+      storage.clearNonRootMeta(repo_type);
+    });
   }
 
   // 5.4.4.3.3. Check that the current (or latest securely attested) time is
@@ -1,5 +1,6 @@
 #include "apiqueue.h"
 #include "logging/logging.h"
+#include "telemetry/metrics.h"
 
 namespace api {
 
@@ -65,6 +66,7 @@ void CommandQueue::run() {
         }
         auto task = std::move(queue_.front());
         queue_.pop();
+        updateDepthMetric();
         lock.unlock();
         task();
         lock.lock();
@@ -102,6 +104,7 @@ void CommandQueue::abort(bool restart_thread) {
       // Flush the queue and reset to initial state
       std::lock_guard<std::mutex> g(m_);
       std::queue<std::packaged_task<void()>>().swap(queue_);
+      updateDepthMetric();
       token_.reset();
       shutdown_ = false;
     }
@@ -110,4 +113,7 @@ void CommandQueue::abort(bool restart_thread) {
     run();
   }
 }
+void CommandQueue::updateDepthMetric() const {
+  metrics::Registry::get().setGauge("aktualizr_command_queue_depth", {}, static_cast<double>(queue_.size()));
+}
 }  // namespace api
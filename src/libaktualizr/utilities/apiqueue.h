@@ -74,6 +74,7 @@ class CommandQueue {
     {
       std::lock_guard<std::mutex> lock(m_);
       queue_.push(std::packaged_task<void()>(std::move(task)));
+      updateDepthMetric();
     }
     cv_.notify_all();
     return r;
@@ -86,12 +87,16 @@ class CommandQueue {
     {
       std::lock_guard<std::mutex> lock(m_);
       queue_.push(std::packaged_task<void()>(std::move(task)));
+      updateDepthMetric();
     }
     cv_.notify_all();
     return r;
   }
 
  private:
+  // must be called with m_ held
+  void updateDepthMetric() const;
+
   std::atomic_bool shutdown_{false};
   std::atomic_bool paused_{false};
 
@@ -0,0 +1,148 @@
+#include "shared_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+constexpr size_t SharedFile::kChunkSize;
+constexpr size_t SharedFile::kWindowChunks;
+
+namespace {
+// The instances of SharedFile::open(), by path. Expired ones are removed on
+// the next call.
+std::mutex registry_mutex;
+std::map<boost::filesystem::path, std::weak_ptr<SharedFile>> registry;
+}  // namespace
+
+std::shared_ptr<SharedFile> SharedFile::open(const boost::filesystem::path &path) {
+  std::lock_guard<std::mutex> guard(registry_mutex);
+  for (auto it = registry.begin(); it != registry.end();) {
+    it = it->second.expired() ? registry.erase(it) : std::next(it);
+  }
+  auto file = registry[path].lock();
+  if (!file) {
+    file = std::make_shared<SharedFile>(path);
+    registry[path] = file;
+  }
+  return file;
+}
+
+SharedFile::SharedFile(const boost::filesystem::path &path) {
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    throw std::runtime_error("Unable to open " + path.string() + ": " + std::strerror(errno));
+  }
+  struct stat st {};
+  if (fstat(fd_, &st) != 0) {
+    const int err = errno;
+    ::close(fd_);
+    throw std::runtime_error("Unable to stat " + path.string() + ": " + std::strerror(err));
+  }
+  size_ = static_cast<uint64_t>(st.st_size);
+  // lets the kernel read further ahead of us; only a hint
+  static_cast<void>(posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL));
+}
+
+SharedFile::~SharedFile() { ::close(fd_); }
+
+size_t SharedFile::readFile(uint64_t offset, uint8_t *buf, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const ssize_t res = pread(fd_, buf + total, size - total, static_cast<off_t>(offset + total));
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("Unable to read file: ") + std::strerror(errno));
+    }
+    if (res == 0) {
+      break;
+    }
+    total += static_cast<size_t>(res);
+  }
+  bytes_read_ += total;
+  return total;
+}
+
+size_t SharedFile::read(uint64_t offset, uint8_t *buf, size_t size) {
+  if (size == 0 || offset >= size_) {
+    return 0;
+  }
+
+  const uint64_t index = offset / kChunkSize;
+  std::shared_ptr<const std::vector<uint8_t>> chunk;
+  {
+    std::unique_lock<std::mutex> lock(m_);
+    for (;;) {
+      const uint64_t end = first_chunk_ + chunks_.size();
+      if (index >= first_chunk_ && index < end) {
+        chunk = chunks_[static_cast<size_t>(index - first_chunk_)];
+        break;
+      }
+      if (index < first_chunk_ || index > end) {
+        // outside of the window, don't disturb the other readers
+        lock.unlock();
+        return readFile(offset, buf, static_cast<size_t>(std::min<uint64_t>(size, size_ - offset)));
+      }
+      if (!reading_) {
+        break;
+      }
+      cv_.wait(lock);
+    }
+
+    if (!chunk) {
+      reading_ = true;
+      lock.unlock();
+      auto data = std::make_shared<std::vector<uint8_t>>(
+          static_cast<size_t>(std::min<uint64_t>(kChunkSize, size_ - index * kChunkSize)));
+      try {
+        data->resize(readFile(index * kChunkSize, data->data(), data->size()));
+      } catch (...) {
+        lock.lock();
+        reading_ = false;
+        cv_.notify_all();
+        throw;
+      }
+      lock.lock();
+      reading_ = false;
+      chunks_.push_back(data);
+      if (chunks_.size() > kWindowChunks) {
+        chunks_.pop_front();
+        ++first_chunk_;
+      }
+      cv_.notify_all();
+      chunk = data;
+    }
+  }
+
+  const auto chunk_offset = static_cast<size_t>(offset - index * kChunkSize);
+  if (chunk_offset >= chunk->size()) {
+    // the file has been truncated
+    return 0;
+  }
+  const size_t read_size = std::min(size, chunk->size() - chunk_offset);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  std::memcpy(buf, chunk->data() + chunk_offset, read_size);
+  return read_size;
+}
+
+size_t SharedFileReader::read(uint8_t *buf, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const size_t read_size = file_->read(offset_, buf + total, size - total);
+    if (read_size == 0) {
+      break;
+    }
+    total += read_size;
+    offset_ += read_size;
+  }
+  return total;
+}
@@ -0,0 +1,78 @@
+#ifndef UTILITIES_SHARED_FILE_H_
+#define UTILITIES_SHARED_FILE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+/**
+ * A file read once on behalf of several readers that stream it at about the
+ * same pace, such as an image sent to several identical Secondaries at once.
+ *
+ * The file is read in large chunks into a window shared by all readers. The
+ * first reader that needs a chunk reads it from disk while the others wait for
+ * it. A reader that falls more than the window behind the leading one reads
+ * from the file on its own, so a slow Secondary neither holds back the others
+ * nor makes the window grow.
+ *
+ * SharedFile::open() hands out the same instance for a path for as long as it
+ * is in use anywhere in the process.
+ */
+class SharedFile {
+ public:
+  static constexpr size_t kChunkSize = 1 << 20;
+  static constexpr size_t kWindowChunks = 16;
+
+  explicit SharedFile(const boost::filesystem::path &path);
+  ~SharedFile();
+  SharedFile(const SharedFile &) = delete;
+  SharedFile &operator=(const SharedFile &) = delete;
+
+  // The instance of `path` that is in use, or a new one.
+  static std::shared_ptr<SharedFile> open(const boost::filesystem::path &path);
+
+  uint64_t size() const { return size_; }
+  // Number of bytes read from disk so far, by all readers together.
+  uint64_t bytesRead() const { return bytes_read_; }
+  // Copies up to `size` bytes at `offset` into `buf`, stopping at the end of a
+  // chunk. Returns 0 at the end of the file.
+  size_t read(uint64_t offset, uint8_t *buf, size_t size);
+
+ private:
+  size_t readFile(uint64_t offset, uint8_t *buf, size_t size);
+
+  int fd_{-1};
+  uint64_t size_{0};
+  std::atomic<uint64_t> bytes_read_{0};
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<const std::vector<uint8_t>>> chunks_;
+  // index of the front of chunks_ in the file
+  uint64_t first_chunk_{0};
+  // a reader is reading the chunk after the back of chunks_
+  bool reading_{false};
+};
+
+/**
+ * One reader's position in a SharedFile.
+ */
+class SharedFileReader {
+ public:
+  explicit SharedFileReader(std::shared_ptr<SharedFile> file) : file_(std::move(file)) {}
+
+  // Fills `buf` with `size` bytes, or less at the end of the file.
+  size_t read(uint8_t *buf, size_t size);
+
+ private:
+  std::shared_ptr<SharedFile> file_;
+  uint64_t offset_{0};
+};
+
+#endif  // UTILITIES_SHARED_FILE_H_
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "utilities/shared_file.h"
+#include "utilities/utils.h"
+
+static std::string writeTestFile(const boost::filesystem::path &path, size_t size) {
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    content[i] = static_cast<char>(i * 7 + i / SharedFile::kChunkSize);
+  }
+  Utils::writeFile(path, content);
+  return content;
+}
+
+static std::string readAll(SharedFileReader &reader, size_t buf_size) {
+  std::string result;
+  std::vector<uint8_t> buf(buf_size);
+  size_t read_size;
+  while ((read_size = reader.read(buf.data(), buf.size())) > 0) {
+    result.append(reinterpret_cast<const char *>(buf.data()), read_size);
+  }
+  return result;
+}
+
+/*
+ * Read the same file from several threads at once with different buffer
+ * sizes.
+ */
+TEST(SharedFile, ConcurrentReaders) {
+  TemporaryDirectory temp_dir;
+  const std::string content = writeTestFile(temp_dir / "image", 3 * SharedFile::kChunkSize + 123);
+  auto file = std::make_shared<SharedFile>(temp_dir / "image");
+  EXPECT_EQ(file->size(), content.size());
+
+  const std::vector<size_t> buf_sizes{1000, 64 * 1024, SharedFile::kChunkSize, 5 * SharedFile::kChunkSize};
+  std::vector<std::string> results(buf_sizes.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < buf_sizes.size(); ++i) {
+    threads.emplace_back([&file, &buf_sizes, &results, i]() {
+      SharedFileReader reader(file);
+      results[i] = readAll(reader, buf_sizes[i]);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &result : results) {
+    EXPECT_TRUE(result == content);
+  }
+}
+
+/*
+ * A reader that is behind the shared window reads from the file on its own.
+ */
+TEST(SharedFile, ReaderBehindWindow) {
+  TemporaryDirectory temp_dir;
+  const std::string content =
+      writeTestFile(temp_dir / "image", (SharedFile::kWindowChunks + 2) * SharedFile::kChunkSize + 1);
+  auto file = std::make_shared<SharedFile>(temp_dir / "image");
+
+  SharedFileReader leader(file);
+  SharedFileReader follower(file);
+  std::vector<uint8_t> buf(1000);
+  ASSERT_EQ(follower.read(buf.data(), buf.size()), buf.size());
+  EXPECT_TRUE(readAll(leader, 64 * 1024) == content);
+  EXPECT_TRUE(content.substr(0, 1000) + readAll(follower, 64 * 1024) == content);
+  EXPECT_GT(file->bytesRead(), content.size());
+}
+
+/*
+ * Readers of the same path share one instance, which reads the file from disk
+ * only once for all of them while they keep pace with each other.
+ */
+TEST(SharedFile, SharedReads) {
+  TemporaryDirectory temp_dir;
+  const std::string content = writeTestFile(temp_dir / "image", 3 * SharedFile::kChunkSize + 123);
+
+  auto file = SharedFile::open(temp_dir / "image");
+  ASSERT_EQ(SharedFile::open(temp_dir / "image"), file);
+  std::vector<SharedFileReader> readers;
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back(SharedFile::open(temp_dir / "image"));
+  }
+  std::vector<std::string> results(readers.size());
+  std::vector<uint8_t> buf(64 * 1024);
+  for (bool done = false; !done;) {
+    done = true;
+    for (size_t i = 0; i < readers.size(); ++i) {
+      const size_t read_size = readers[i].read(buf.data(), buf.size());
+      results[i].append(reinterpret_cast<const char *>(buf.data()), read_size);
+      done = done && read_size == 0;
+    }
+  }
+  for (const auto &result : results) {
+    EXPECT_TRUE(result == content);
+  }
+  EXPECT_EQ(file->bytesRead(), content.size());
+
+  // a new instance once the file is no longer in use
+  readers.clear();
+  file.reset();
+  file = SharedFile::open(temp_dir / "image");
+  EXPECT_EQ(file->bytesRead(), 0U);
+}
+
+TEST(SharedFile, EmptyFile) {
+  TemporaryDirectory temp_dir;
+  Utils::writeFile(temp_dir / "empty", std::string());
+  auto file = std::make_shared<SharedFile>(temp_dir / "empty");
+  SharedFileReader reader(file);
+  std::vector<uint8_t> buf(10);
+  EXPECT_EQ(reader.read(buf.data(), buf.size()), 0U);
+
+  EXPECT_THROW(SharedFile(temp_dir / "missing"), std::runtime_error);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
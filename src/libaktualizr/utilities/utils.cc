@@ -2,8 +2,11 @@
 
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -19,8 +22,14 @@
 #include <glob.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/archive/iterators/base64_from_binary.hpp>
@@ -360,7 +369,8 @@ std::string Utils::jsonToCanonicalStr(const Json::Value &json) {
 
 Json::Value Utils::getHardwareInfo() {
   std::string result;
-  const int exit_code = shell("lshw -json", &result);
+  // lshw can take several seconds and print hundreds of KB on larger systems
+  const int exit_code = execute({"lshw", "-json"}, &result, false, std::chrono::minutes(2));
 
   if (exit_code != 0) {
     LOG_WARNING << "Could not execute lshw (is it installed?).";
@@ -722,24 +732,118 @@ int Utils::ipPort(const sockaddr_storage &saddr) {
   return ntohs(p);  // NOLINT(readability-isolate-declaration)
 }
 
-int Utils::shell(const std::string &command, std::string *output, bool include_stderr) {
-  std::array<char, 128> buffer{};
-  std::string full_command(command);
+// Returns false if the program could not be started or waited for, or did not
+// finish within `timeout`. Otherwise `status` is its wait status.
+static bool runProgram(const std::vector<std::string> &argv, std::string *output, bool include_stderr,
+                       std::chrono::milliseconds timeout, int *status) {
+  if (argv.empty()) {
+    throw std::invalid_argument("No program to execute");
+  }
+  std::vector<char *> c_argv;
+  c_argv.reserve(argv.size() + 1);
+  for (const auto &arg : argv) {
+    c_argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  c_argv.push_back(nullptr);
+
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+    LOG_ERROR << "Unable to create pipe for " << argv[0] << ": " << std::strerror(errno);
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
   if (include_stderr) {
-    full_command += " 2>&1";
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDERR_FILENO);
   }
-  FILE *pipe = popen(full_command.c_str(), "r");
-  if (pipe == nullptr) {
-    *output = "popen() failed!";
-    return -1;
+
+  pid_t pid;
+  const int spawn_result = posix_spawnp(&pid, c_argv[0], &actions, nullptr, c_argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(pipe_fds[1]);
+  if (spawn_result != 0) {
+    close(pipe_fds[0]);
+    LOG_DEBUG << "Unable to execute " << argv[0] << ": " << std::strerror(spawn_result);
+    return false;
   }
-  while (feof(pipe) == 0) {
-    if (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-      *output += buffer.data();
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  bool timed_out = false;
+  std::vector<char> buffer(64 * 1024);
+  while (true) {
+    int poll_timeout = -1;
+    if (timeout != std::chrono::milliseconds::zero()) {
+      const auto remaining =
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        timed_out = true;
+        break;
+      }
+      poll_timeout = static_cast<int>(remaining.count());
+    }
+    pollfd pfd{pipe_fds[0], POLLIN, 0};
+    const int ready = poll(&pfd, 1, poll_timeout);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready < 0) {
+      break;
     }
+    if (ready == 0) {
+      continue;
+    }
+    const ssize_t count = read(pipe_fds[0], buffer.data(), buffer.size());
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    output->append(buffer.data(), static_cast<size_t>(count));
+  }
+  close(pipe_fds[0]);
+
+  if (timed_out) {
+    LOG_WARNING << argv[0] << " did not finish within " << timeout.count() << " ms, killing it";
+    kill(pid, SIGKILL);
   }
-  int exitcode = pclose(pipe);
-  return WEXITSTATUS(exitcode);
+  while (waitpid(pid, status, 0) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return !timed_out;
+}
+
+int Utils::shell(const std::string &command, std::string *output, bool include_stderr) {
+  int status = 0;
+  if (!runProgram({"/bin/sh", "-c", command}, output, include_stderr, std::chrono::milliseconds::zero(), &status)) {
+    return -1;
+  }
+  // same as the exit code of pclose() before, which is 0 if the shell was
+  // killed by a signal
+  return WEXITSTATUS(status);
+}
+
+int Utils::execute(const std::vector<std::string> &argv, std::string *output, bool include_stderr,
+                   std::chrono::milliseconds timeout) {
+  int status = 0;
+  if (!runProgram(argv, output, include_stderr, timeout, &status) || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+std::future<std::pair<int, std::string>> Utils::executeAsync(std::vector<std::string> argv, bool include_stderr,
+                                                             std::chrono::milliseconds timeout) {
+  return std::async(std::launch::async, [argv, include_stderr, timeout]() {
+    std::string output;
+    const int exit_code = execute(argv, &output, include_stderr, timeout);
+    return std::make_pair(exit_code, std::move(output));
+  });
 }
 
 boost::filesystem::path Utils::absolutePath(const boost::filesystem::path &root, const boost::filesystem::path &file) {
@@ -777,6 +881,21 @@ void Utils::createDirectories(const boost::filesystem::path &path, mode_t mode)
   std::cout << "created: " << path.native() << "\n";
 }
 
+int Utils::reserveFileSpace(int fd, uint64_t size) {
+  if (size == 0 || fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0) {
+    return 0;
+  }
+  const int err = errno;
+  if (err != EOPNOTSUPP && err != ENOSYS) {
+    return err;
+  }
+  struct statvfs fs {};
+  if (fstatvfs(fd, &fs) == 0 && static_cast<uint64_t>(fs.f_bavail) * fs.f_frsize < size) {
+    return ENOSPC;
+  }
+  return 0;
+}
+
 bool Utils::createSecureDirectory(const boost::filesystem::path &path) {
   if (mkdir(path.c_str(), S_IRWXU) == 0) {
     // directory created successfully
@@ -924,6 +1043,59 @@ boost::filesystem::path TemporaryDirectory::operator/(const boost::filesystem::p
 
 std::string TemporaryDirectory::PathString() const { return Path().string(); }
 
+MappedFile::MappedFile(const boost::filesystem::path &path) : path_(path) {
+  fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not open " + path_.string() + ": " + std::strerror(errno));
+  }
+  struct stat st {};
+  if (fstat(fd_, &st) != 0) {
+    close(fd_);
+    throw std::runtime_error("Could not stat " + path_.string() + ": " + std::strerror(errno));
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  map(PROT_READ);
+}
+
+MappedFile::MappedFile(const boost::filesystem::path &path, uint64_t size) : path_(path) {
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not create " + path_.string() + ": " + std::strerror(errno));
+  }
+  if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    close(fd_);
+    throw std::runtime_error("Could not resize " + path_.string() + ": " + std::strerror(errno));
+  }
+  size_ = static_cast<size_t>(size);
+  map(PROT_READ | PROT_WRITE);
+}
+
+void MappedFile::map(int prot) {
+  // an empty file cannot be mapped, but there is nothing to access either
+  if (size_ == 0) {
+    return;
+  }
+  addr_ = mmap(nullptr, size_, prot, MAP_SHARED, fd_, 0);
+  if (addr_ == MAP_FAILED) {
+    addr_ = nullptr;
+    close(fd_);
+    throw std::runtime_error("Could not map " + path_.string() + ": " + std::strerror(errno));
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (addr_ != nullptr) {
+    munmap(addr_, size_);
+  }
+  close(fd_);
+}
+
+void MappedFile::sync() const {
+  if ((addr_ != nullptr && msync(addr_, size_, MS_SYNC) != 0) || fsync(fd_) != 0) {
+    throw std::runtime_error("Could not write " + path_.string() + ": " + std::strerror(errno));
+  }
+}
+
 Socket::Socket() {
   socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
   if (-1 == socket_fd_) {
@@ -2,8 +2,12 @@
 #define UTILS_H_
 
 #include <boost/filesystem.hpp>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <curl/curl.h>
 #include <netinet/in.h>
@@ -39,9 +43,27 @@ struct Utils {
   static sockaddr_storage ipGetSockaddr(int fd);
   static std::string ipDisplayName(const sockaddr_storage &saddr);
   static int ipPort(const sockaddr_storage &saddr);
+  // Runs `command` with /bin/sh. Returns the exit code of the shell, which is 0
+  // if the shell itself was killed by a signal, or -1 if it could not be
+  // started.
   static int shell(const std::string &command, std::string *output, bool include_stderr = false);
+  // Runs argv[0] (looked up in PATH) with the given arguments, without a shell.
+  // Returns its exit code, or -1 if it could not be started, was killed by a
+  // signal or did not finish within `timeout` (zero means no timeout), in which
+  // case it is killed.
+  static int execute(const std::vector<std::string> &argv, std::string *output, bool include_stderr = false,
+                     std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+  static std::future<std::pair<int, std::string>> executeAsync(
+      std::vector<std::string> argv, bool include_stderr = false,
+      std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
   static boost::filesystem::path absolutePath(const boost::filesystem::path &root, const boost::filesystem::path &file);
   static void createDirectories(const boost::filesystem::path &path, mode_t mode);
+  // Reserves the first `size` bytes of an open file with fallocate(). Where
+  // that is not supported, as on ubifs or jffs2, only checks that they are
+  // free: writing the file in advance, as posix_fallocate() does, would double
+  // the writes to flash. Returns 0 or an errno value; ENOSPC and EFBIG mean
+  // that they do not fit.
+  static int reserveFileSpace(int fd, uint64_t size);
   static bool createSecureDirectory(const boost::filesystem::path &path);
   static std::string urlEncode(const std::string &input);
   static CURL *curlDupHandleWrapper(CURL *curl_in, bool using_pkcs11);
@@ -93,6 +115,33 @@ class TemporaryDirectory {
   boost::filesystem::path tmp_name_;
 };
 
+/**
+ * RAII memory mapping of a whole file. Existing files are mapped read-only; a
+ * file created with a size is mapped writable.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const boost::filesystem::path &path);
+  // Creates or truncates the file to `size` bytes.
+  MappedFile(const boost::filesystem::path &path, uint64_t size);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  uint8_t *data() const { return static_cast<uint8_t *>(addr_); }
+  size_t size() const { return size_; }
+  // Writes a writable mapping out to disk.
+  void sync() const;
+
+ private:
+  void map(int prot);
+
+  boost::filesystem::path path_;
+  int fd_{-1};
+  void *addr_{nullptr};
+  size_t size_{0};
+};
+
 // helper template for C (mostly openssl) data structured
 //   user should still take care about the order of destruction
 //   by instantiating StructGuard<> in a right order.
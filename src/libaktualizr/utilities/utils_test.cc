@@ -4,7 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <random>
@@ -263,6 +267,38 @@ TEST(Utils, TemporaryFilePutContents) {
   EXPECT_EQ(b, "thecontents");
 }
 
+/* Map a file for reading, and create a file through a writable mapping. */
+TEST(Utils, MappedFile) {
+  TemporaryDirectory temp_dir;
+  Utils::writeFile(temp_dir / "in", std::string("mapped contents"));
+  {
+    MappedFile in(temp_dir / "in");
+    ASSERT_EQ(in.size(), 15U);
+    EXPECT_EQ(std::string(reinterpret_cast<const char *>(in.data()), in.size()), "mapped contents");
+
+    MappedFile out(temp_dir / "out", in.size());
+    std::copy(in.data(), in.data() + in.size(), out.data());  // NOLINT
+    out.sync();
+  }
+  EXPECT_EQ(Utils::readFile(temp_dir / "out"), "mapped contents");
+
+  Utils::writeFile(temp_dir / "empty", std::string());
+  EXPECT_EQ(MappedFile(temp_dir / "empty").size(), 0U);
+  EXPECT_THROW(MappedFile(temp_dir / "missing"), std::runtime_error);
+}
+
+TEST(Utils, reserveFileSpace) {
+  TemporaryDirectory temp_dir;
+  const boost::filesystem::path path = temp_dir / "file";
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(Utils::reserveFileSpace(fd, 0), 0);
+  EXPECT_EQ(Utils::reserveFileSpace(fd, 4096), 0);
+  const int err = Utils::reserveFileSpace(fd, uint64_t(1) << 60);
+  EXPECT_TRUE(err == ENOSPC || err == EFBIG) << std::strerror(err);
+  close(fd);
+}
+
 TEST(Utils, copyDir) {
   TemporaryDirectory temp_dir;
 
@@ -341,6 +377,54 @@ TEST(Utils, shell) {
 
   statuscode = Utils::shell("ls /nonexistentdir123", &out);
   EXPECT_NE(statuscode, 0);
+
+  // a shell killed by a signal yields 0, as it did with popen()
+  statuscode = Utils::shell("kill -9 $$", &out);
+  EXPECT_EQ(statuscode, 0);
+}
+
+/*
+ * Report a program killed by a signal as a failure.
+ */
+TEST(Utils, executeKilled) {
+  std::string out;
+  EXPECT_EQ(Utils::execute({"sh", "-c", "kill -9 $$"}, &out), -1);
+}
+
+TEST(Utils, execute) {
+  std::string out;
+  EXPECT_EQ(Utils::execute({"echo", "a b", "$HOME"}, &out), 0);
+  EXPECT_EQ(out, "a b $HOME\n");
+
+  out.clear();
+  EXPECT_EQ(Utils::execute({"sh", "-c", "echo out; echo err >&2; exit 3"}, &out), 3);
+  EXPECT_EQ(out, "out\n");
+
+  out.clear();
+  EXPECT_EQ(Utils::execute({"sh", "-c", "echo out; echo err >&2"}, &out, true), 0);
+  EXPECT_EQ(out, "out\nerr\n");
+
+  out.clear();
+  EXPECT_NE(Utils::execute({"nonexistentprogram123"}, &out), 0);
+
+  // larger than the pipe buffer
+  out.clear();
+  EXPECT_EQ(Utils::execute({"head", "-c", "1000000", "/dev/zero"}, &out), 0);
+  EXPECT_EQ(out.size(), 1000000);
+}
+
+TEST(Utils, executeTimeout) {
+  std::string out;
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(Utils::execute({"sleep", "10"}, &out, false, std::chrono::milliseconds(100)), -1);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(Utils, executeAsync) {
+  auto result = Utils::executeAsync({"echo", "async"});
+  const auto exit_and_output = result.get();
+  EXPECT_EQ(exit_and_output.first, 0);
+  EXPECT_EQ(exit_and_output.second, "async\n");
 }
 
 TEST(Utils, createSecureDirectory) {
@@ -0,0 +1,207 @@
+#include "load_test.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "logging/logging.h"
+#include "primary/sotauptaneclient.h"
+#include "storage/invstorage.h"
+
+void PhaseStats::addSample(std::chrono::microseconds latency, bool success) {
+  latencies_.push_back(latency);
+  if (success) {
+    ++succeeded_;
+  } else {
+    ++failed_;
+  }
+}
+
+std::chrono::microseconds PhaseStats::percentile(double p) const {
+  if (latencies_.empty()) {
+    return std::chrono::microseconds(0);
+  }
+  std::vector<std::chrono::microseconds> sorted(latencies_);
+  std::sort(sorted.begin(), sorted.end());
+  auto rank = static_cast<size_t>(std::ceil(p / 100. * static_cast<double>(sorted.size())));
+  rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+  return sorted[rank - 1];
+}
+
+void PhaseStats::printHeader(std::ostream &os) {
+  os << std::left << std::setw(10) << "phase" << std::right << std::setw(8) << "ok" << std::setw(8) << "failed"
+     << std::setw(8) << "skipped" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10)
+     << "p99 ms" << std::setw(10) << "max ms" << std::setw(10) << "wall s" << std::setw(10) << "cpu s" << std::setw(12)
+     << "max rss MB"
+     << "\n";
+}
+
+void PhaseStats::print(std::ostream &os) const {
+  auto ms = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+  os << std::left << std::setw(10) << name_ << std::right << std::setw(8) << succeeded_ << std::setw(8) << failed_
+     << std::setw(8) << skipped_ << std::fixed << std::setprecision(1) << std::setw(10) << ms(percentile(50))
+     << std::setw(10) << ms(percentile(90)) << std::setw(10) << ms(percentile(99)) << std::setw(10)
+     << ms(percentile(100)) << std::setw(10) << ms(wall_time_) / 1000. << std::setw(10) << cpu_seconds_
+     << std::setw(12) << static_cast<double>(max_rss_kb_) / 1024. << "\n";
+}
+
+namespace {
+
+struct Device {
+  Config config;
+  std::shared_ptr<INvStorage> storage;
+  std::unique_ptr<SotaUptaneClient> client;
+  std::vector<Uptane::Target> updates;
+};
+
+enum class TaskResult { kSuccess, kFailure, kSkipped };
+
+}  // namespace
+
+class ProvisionDeviceTask {
+ public:
+  TaskResult operator()(Device &device) const {
+    device.storage = INvStorage::newStorage(device.config.storage);
+    device.client = std_::make_unique<SotaUptaneClient>(device.config, device.storage);
+    device.client->initialize();
+    return TaskResult::kSuccess;
+  }
+};
+
+class CheckForUpdate {
+ public:
+  TaskResult operator()(Device &device) const {
+    if (!device.client) {
+      return TaskResult::kSkipped;
+    }
+    result::UpdateCheck check = device.client->checkUpdates();
+    if (check.status == result::UpdateStatus::kError) {
+      return TaskResult::kFailure;
+    }
+    device.updates = check.updates;
+    return TaskResult::kSuccess;
+  }
+};
+
+class DownloadTask {
+ public:
+  TaskResult operator()(Device &device) const {
+    if (!device.client || device.updates.empty()) {
+      return TaskResult::kSkipped;
+    }
+    result::Download download = device.client->downloadImages(device.updates);
+    if (download.status != result::DownloadStatus::kSuccess) {
+      device.updates.clear();
+      return TaskResult::kFailure;
+    }
+    device.updates = download.updates;
+    return TaskResult::kSuccess;
+  }
+};
+
+class InstallTask {
+ public:
+  TaskResult operator()(Device &device) const {
+    if (!device.client || device.updates.empty()) {
+      return TaskResult::kSkipped;
+    }
+    result::Install install = device.client->uptaneInstall(device.updates);
+    const auto &res = install.dev_report;
+    return (res.isSuccess() || res.needCompletion()) ? TaskResult::kSuccess : TaskResult::kFailure;
+  }
+};
+
+static double cpuSeconds(const struct rusage &usage) {
+  auto seconds = [](const struct timeval &tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+/* Run one phase on every device, with at most `parallel` devices at once and
+ * the k-th device starting no earlier than k / `rate` seconds into the phase. */
+template <typename Task>
+static PhaseStats runPhase(const std::string &name, std::vector<std::unique_ptr<Device>> &devices,
+                           const LoadTestOptions &options, Task task) {
+  PhaseStats stats(name);
+  std::mutex stats_mutex;
+  std::atomic<size_t> next{0};
+
+  struct rusage usage_before {};
+  getrusage(RUSAGE_SELF, &usage_before);
+  const auto phase_start = std::chrono::steady_clock::now();
+
+  auto worker = [&]() {
+    for (size_t k = next++; k < devices.size(); k = next++) {
+      if (options.rate > 0) {
+        std::this_thread::sleep_until(phase_start + std::chrono::microseconds(static_cast<int64_t>(
+                                                        static_cast<double>(k) * 1e6 / options.rate)));
+      }
+      const auto start = std::chrono::steady_clock::now();
+      TaskResult result;
+      try {
+        result = task(*devices[k]);
+      } catch (const std::exception &ex) {
+        LOG_WARNING << "Device " << k << " failed in phase " << name << ": " << ex.what();
+        result = TaskResult::kFailure;
+      }
+      const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+      std::lock_guard<std::mutex> guard(stats_mutex);
+      if (result == TaskResult::kSkipped) {
+        stats.addSkipped();
+      } else {
+        stats.addSample(latency, result == TaskResult::kSuccess);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const size_t width = std::max<size_t>(1, std::min(options.parallel, devices.size()));
+  for (size_t i = 0; i < width; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  stats.setWallTime(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - phase_start));
+  struct rusage usage_after {};
+  getrusage(RUSAGE_SELF, &usage_after);
+  stats.setResourceUse(cpuSeconds(usage_after) - cpuSeconds(usage_before), usage_after.ru_maxrss);
+  return stats;
+}
+
+std::vector<PhaseStats> runLoadTest(const Config &base_config, const LoadTestOptions &options) {
+  std::vector<std::unique_ptr<Device>> devices;
+  devices.reserve(options.devices);
+  for (size_t k = 0; k < options.devices; ++k) {
+    auto device = std_::make_unique<Device>();
+    device->config = base_config;
+    device->config.storage.path = options.base_dir / ("device-" + std::to_string(k));
+    device->config.pacman.images_path = device->config.storage.path / "images";
+    if (!base_config.provision.device_id.empty()) {
+      device->config.provision.device_id = base_config.provision.device_id + "-" + std::to_string(k);
+    }
+    if (!base_config.provision.primary_ecu_serial.empty()) {
+      device->config.provision.primary_ecu_serial = base_config.provision.primary_ecu_serial + "-" + std::to_string(k);
+    }
+    devices.push_back(std::move(device));
+  }
+
+  std::vector<PhaseStats> stats;
+  stats.push_back(runPhase("provision", devices, options, ProvisionDeviceTask()));
+  stats.push_back(runPhase("check", devices, options, CheckForUpdate()));
+  if (options.install) {
+    stats.push_back(runPhase("download", devices, options, DownloadTask()));
+    stats.push_back(runPhase("install", devices, options, InstallTask()));
+  }
+  return stats;
+}
@@ -0,0 +1,61 @@
+#ifndef LOAD_TEST_H_
+#define LOAD_TEST_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "libaktualizr/config.h"
+
+struct LoadTestOptions {
+  // number of simulated Primaries
+  size_t devices{100};
+  // devices started per second in each phase, 0 to start them as fast as possible
+  double rate{0};
+  // maximum number of devices running a phase at the same time
+  size_t parallel{16};
+  // each device gets its own storage in a subdirectory of this one
+  boost::filesystem::path base_dir;
+  // run the download and install phases as well as provisioning and checking
+  bool install{true};
+};
+
+class PhaseStats {
+ public:
+  explicit PhaseStats(std::string name) : name_(std::move(name)) {}
+
+  void addSample(std::chrono::microseconds latency, bool success);
+  void addSkipped() { ++skipped_; }
+  void setWallTime(std::chrono::microseconds wall_time) { wall_time_ = wall_time; }
+  void setResourceUse(double cpu_seconds, int64_t max_rss_kb) {
+    cpu_seconds_ = cpu_seconds;
+    max_rss_kb_ = max_rss_kb;
+  }
+
+  // nearest-rank percentile, p in [0, 100]
+  std::chrono::microseconds percentile(double p) const;
+  size_t succeeded() const { return succeeded_; }
+  size_t failed() const { return failed_; }
+
+  static void printHeader(std::ostream &os);
+  void print(std::ostream &os) const;
+
+ private:
+  std::string name_;
+  std::vector<std::chrono::microseconds> latencies_;
+  size_t succeeded_{0};
+  size_t failed_{0};
+  size_t skipped_{0};
+  std::chrono::microseconds wall_time_{0};
+  double cpu_seconds_{0};
+  int64_t max_rss_kb_{0};
+};
+
+// Runs the load test and returns the statistics of each phase, in order.
+std::vector<PhaseStats> runLoadTest(const Config &base_config, const LoadTestOptions &options);
+
+#endif  // LOAD_TEST_H_
@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "load_test.h"
+
+/*
+ * Compute nearest-rank percentiles over the recorded latencies.
+ */
+TEST(LoadTest, PhaseStatsPercentile) {
+  PhaseStats stats("check");
+  EXPECT_EQ(stats.percentile(50), std::chrono::microseconds(0));
+
+  for (int i = 10; i >= 1; --i) {
+    stats.addSample(std::chrono::microseconds(i * 100), i != 3);
+  }
+  stats.addSkipped();
+
+  EXPECT_EQ(stats.succeeded(), 9);
+  EXPECT_EQ(stats.failed(), 1);
+  EXPECT_EQ(stats.percentile(0), std::chrono::microseconds(100));
+  EXPECT_EQ(stats.percentile(50), std::chrono::microseconds(500));
+  EXPECT_EQ(stats.percentile(90), std::chrono::microseconds(900));
+  EXPECT_EQ(stats.percentile(99), std::chrono::microseconds(1000));
+  EXPECT_EQ(stats.percentile(100), std::chrono::microseconds(1000));
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -0,0 +1,95 @@
+#include <unistd.h>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "libaktualizr/config.h"
+#include "load_test.h"
+#include "logging/logging.h"
+#include "utilities/aktualizr_version.h"
+#include "utilities/utils.h"
+
+namespace bpo = boost::program_options;
+
+void check_info_options(const bpo::options_description &description, const bpo::variables_map &vm) {
+  if (vm.count("help") != 0) {
+    std::cout << description << '\n';
+    exit(EXIT_SUCCESS);
+  }
+  if (vm.count("version") != 0) {
+    std::cout << "Current aktualizr-load-test version is: " << aktualizr_version() << "\n";
+    exit(EXIT_SUCCESS);
+  }
+}
+
+bpo::variables_map parse_options(int argc, char **argv) {
+  bpo::options_description description(
+      "Simulate a fleet of Primaries in one process to load a backend and measure client-side latencies.\n"
+      "Every device uses the given configuration with its own storage directory.");
+  // clang-format off
+  description.add_options()
+      ("help,h", "print usage")
+      ("version,v", "Current aktualizr-load-test version")
+      ("config,c", bpo::value<std::vector<boost::filesystem::path> >()->composing(), "configuration file or directory shared by all devices")
+      ("loglevel", bpo::value<int>()->default_value(3), "set log level 0-5 (trace, debug, info, warning, error, fatal)")
+      ("devices,n", bpo::value<size_t>()->default_value(100), "number of simulated devices")
+      ("rate,r", bpo::value<double>()->default_value(0), "devices started per second in each phase, 0 for no limit")
+      ("parallel,p", bpo::value<size_t>()->default_value(16), "maximum number of devices running a phase at the same time")
+      ("dir,d", bpo::value<boost::filesystem::path>(), "directory for the devices' storage, a temporary one by default")
+      ("no-install", "only provision the devices and check for updates");
+  // clang-format on
+
+  bpo::variables_map vm;
+  try {
+    bpo::basic_parsed_options<char> parsed_options = bpo::command_line_parser(argc, argv).options(description).run();
+    bpo::store(parsed_options, vm);
+    check_info_options(description, vm);
+    bpo::notify(vm);
+  } catch (const bpo::error &ex) {
+    std::cout << ex.what() << std::endl;
+    std::cout << description;
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
+
+int main(int argc, char *argv[]) {
+  logger_init(isatty(1) == 1);
+  logger_set_threshold(boost::log::trivial::warning);
+
+  bpo::variables_map commandline_map = parse_options(argc, argv);
+
+  int r = EXIT_FAILURE;
+  try {
+    Config config(commandline_map);
+
+    LoadTestOptions options;
+    options.devices = commandline_map["devices"].as<size_t>();
+    options.rate = commandline_map["rate"].as<double>();
+    options.parallel = commandline_map["parallel"].as<size_t>();
+    options.install = commandline_map.count("no-install") == 0;
+
+    std::unique_ptr<TemporaryDirectory> temp_dir;
+    if (commandline_map.count("dir") != 0) {
+      options.base_dir = commandline_map["dir"].as<boost::filesystem::path>();
+    } else {
+      temp_dir = std_::make_unique<TemporaryDirectory>("load-test");
+      options.base_dir = temp_dir->Path();
+    }
+
+    std::vector<PhaseStats> stats = runLoadTest(config, options);
+
+    PhaseStats::printHeader(std::cout);
+    bool all_ok = true;
+    for (const auto &s : stats) {
+      s.print(std::cout);
+      all_ok = all_ok && s.failed() == 0;
+    }
+    r = all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception &ex) {
+    LOG_ERROR << ex.what();
+  }
+  return r;
+}